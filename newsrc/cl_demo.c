@@ -245,27 +245,18 @@ void CL_Record_f(void) {
 
 /*
 ====================
-CL_PlayDemo_f
+CL_StartDemo
 
-play [demoname]
+Returns false if the demo couldn't be opened
 ====================
 */
-void CL_PlayDemo_f(void) {
-	if (cmd_source != src_command) {
-		return;
-	}
-
-	if (Cmd_Argc() != 2) {
-		Con_Printf("play <demoname> : plays a demo\n");
-		return;
-	}
-
+static qboolean CL_StartDemo(char *demoname) {
 	// disconnect from server
 	CL_Disconnect ();
 
 	// open the demo file
 	char name[256];
-	strcpy(name, Cmd_Argv(1));
+	strcpy(name, demoname);
 	COM_DefaultExtension(name, ".dem");
 
 	Con_Printf("Playing demo from %s.\n", name);
@@ -274,7 +265,7 @@ void CL_PlayDemo_f(void) {
 	if (!cls.demofile) {
 		Con_Printf("ERROR: couldn't open.\n");
 		cls.demonum = -1;  // stop demo loop
-		return;
+		return false;
 	}
 
 	cls.demoplayback = true;
@@ -283,6 +274,28 @@ void CL_PlayDemo_f(void) {
 
 	// CD audio removed, but this is still necessary to read old demo files
 	while ((getc(cls.demofile)) != '\n') { /* do nothing */ }
+
+	return true;
+}
+
+/*
+====================
+CL_PlayDemo_f
+
+play [demoname]
+====================
+*/
+void CL_PlayDemo_f(void) {
+	if (cmd_source != src_command) {
+		return;
+	}
+
+	if (Cmd_Argc() != 2) {
+		Con_Printf("play <demoname> : plays a demo\n");
+		return;
+	}
+
+	CL_StartDemo(Cmd_Argv(1));
 }
 
 /*
@@ -298,6 +311,13 @@ void CL_FinishTimeDemo (void)
 
 	cls.timedemo = false;
 
+// only stop a recording this timedemo started, not one from "timerecord"
+	if (cls.td_timing)
+	{
+		cls.td_timing = false;
+		Timing_Stop ();
+	}
+
 // the first frame didn't count
 	frames = (host_framecount - cls.td_startframe) - 1;
 	time = realtime - cls.td_starttime;
@@ -310,7 +330,10 @@ void CL_FinishTimeDemo (void)
 ====================
 CL_TimeDemo_f
 
-timedemo [demoname]
+timedemo [demoname] [timefile]
+
+With a timefile the demo's frame times are recorded and written to it,
+see "timerecord"
 ====================
 */
 void CL_TimeDemo_f (void)
@@ -318,13 +341,21 @@ void CL_TimeDemo_f (void)
 	if (cmd_source != src_command)
 		return;
 
-	if (Cmd_Argc() != 2)
+	if (Cmd_Argc() != 2 && Cmd_Argc() != 3)
 	{
-		Con_Printf ("timedemo <demoname> : gets demo speeds\n");
+		Con_Printf ("timedemo <demoname> [timefile] : gets demo speeds\n");
 		return;
 	}
 
-	CL_PlayDemo_f ();
+	if (!CL_StartDemo (Cmd_Argv(1)))
+		return;
+
+	cls.td_timing = false;
+	if (Cmd_Argc() == 3)
+	{
+		Timing_Start (Cmd_Argv(2));
+		cls.td_timing = true;
+	}
 
 // cls.td_starttime will be grabbed at the second frame of the demo, so
 // all the loading time doesn't get counted
@@ -754,4 +754,6 @@ void CL_Init(void) {
 	Cmd_AddCommand("stop", CL_Stop_f);
 	Cmd_AddCommand("playdemo", CL_PlayDemo_f);
 	Cmd_AddCommand("timedemo", CL_TimeDemo_f);
+	Cmd_AddCommand("protostats", CL_ProtoStats_f);
+	Cmd_AddCommand("loadtimes", CL_LoadTimes_f);
 }
@@ -196,6 +196,116 @@ void CL_KeepaliveMessage (void)
 	SZ_Clear (&cls.message);
 }
 
+/*
+==================
+CL_ProtoStats_f
+
+Compares the size of the entity updates received since the last
+serverinfo with what the other protocol would have needed.  Run it after
+a timedemo to size up PROTOCOL_BITPACKED on a recorded demo.
+==================
+*/
+struct
+{
+	int		updates;
+	int		bytes[2];		// classic, bitpacked
+} protostats;
+
+void CL_ProtoStats_f (void)
+{
+	if (!protostats.updates)
+	{
+		Con_Printf ("no entity updates received\n");
+		return;
+	}
+
+	Con_Printf ("protocol %i, %i entity updates\n", cl.protocol, protostats.updates);
+	Con_Printf ("protocol %i: %7i bytes\n", PROTOCOL_VERSION, protostats.bytes[0]);
+	Con_Printf ("protocol %i: %7i bytes (%.1f%%)\n", PROTOCOL_BITPACKED, protostats.bytes[1],
+		100.0 * protostats.bytes[1] / protostats.bytes[0]);
+}
+
+/*
+==================
+CL_CountUpdate
+
+Adds the size of an update in both protocols to protostats
+==================
+*/
+void CL_CountUpdate (int bits, entity_t *ent)
+{
+	int		size;
+	int		fields, coords, coordbits;
+	int		i;
+
+	size = 2;
+	if (bits & U_MOREBITS)
+		size++;
+	if (bits & U_LONGENTITY)
+		size++;
+
+// model, frame, colormap, skin, effects and angles are a byte either way
+	fields = 0;
+	for (i=0 ; i<16 ; i++)
+		if (bits & (1<<i) & (U_MODEL|U_FRAME|U_COLORMAP|U_SKIN|U_EFFECTS|U_ANGLE1|U_ANGLE2|U_ANGLE3))
+			fields++;
+
+	coords = 0;
+	coordbits = 0;
+	for (i=0 ; i<3 ; i++)
+	{
+		if (bits & (U_ORIGIN1<<i))
+		{
+			coords++;
+			coordbits += MSG_DeltaCoordBits (ent->msg_origins[0][i], ent->baseline.origin[i]);
+		}
+	}
+
+	protostats.updates++;
+	protostats.bytes[0] += size + fields + coords*2;
+	protostats.bytes[1] += size + (fields*8 + coordbits + 7) / 8;
+}
+
+/*
+==================
+CL_LoadTimes_f
+
+Where the last level load went
+==================
+*/
+loadtimes_t cl_loadtimes;
+
+void CL_LoadTimes_f (void)
+{
+	if (sv.active)
+	{
+		Con_Printf ("server spawn:   %6.1f ms\n", sv_spawntimes.total * 1000);
+		Con_Printf ("  progs         %6.1f ms\n", sv_spawntimes.progs * 1000);
+		Con_Printf ("  world         %6.1f ms\n", sv_spawntimes.world * 1000);
+		Con_Printf ("  entities      %6.1f ms\n", sv_spawntimes.entities * 1000);
+		Con_Printf ("  settle        %6.1f ms\n", sv_spawntimes.settle * 1000);
+	}
+
+	if (!cl_loadtimes.total)
+	{
+		Con_Printf ("no level loaded\n");
+		return;
+	}
+
+	Con_Printf ("client load:    %6.1f ms\n", cl_loadtimes.total * 1000);
+	Con_Printf ("  prefetch      %6.1f ms\n", cl_loadtimes.prefetch * 1000);
+	Con_Printf ("  models        %6.1f ms\n", cl_loadtimes.models * 1000);
+	Con_Printf ("  sounds        %6.1f ms\n", cl_loadtimes.sounds * 1000);
+	Con_Printf ("  R_NewMap      %6.1f ms\n", cl_loadtimes.newmap * 1000);
+	Con_Printf ("%i files read ahead, %i bytes, %i used, %.1f ms waiting\n",
+		com_prefetchstats.files, com_prefetchstats.bytes,
+		com_prefetchstats.used, com_prefetchstats.wait * 1000);
+	Con_Printf ("%i sounds decoded ahead, %.1f ms on workers, %.1f ms waiting\n",
+		s_prefetchstats.sounds, s_prefetchstats.decode * 1000,
+		s_prefetchstats.wait * 1000);
+	Con_Printf ("%i worker threads\n", Jobs_Workers ());
+}
+
 /*
 ==================
 CL_ParseServerInfo
@@ -208,6 +318,8 @@ void CL_ParseServerInfo (void)
 	int		nummodels, numsounds;
 	char	model_precache[MAX_MODELS][MAX_QPATH];
 	char	sound_precache[MAX_SOUNDS][MAX_QPATH];
+	char	mapname[MAX_QPATH];
+	double	start, mark;
 
 	Con_DPrintf ("Serverinfo packet received.\n");
 //
@@ -217,11 +329,14 @@ void CL_ParseServerInfo (void)
 
 // parse protocol version number
 	i = MSG_ReadLong ();
-	if (i != PROTOCOL_VERSION)
+	if (i != PROTOCOL_VERSION && i != PROTOCOL_BITPACKED)
 	{
-		Con_Printf ("Server returned version %i, not %i", i, PROTOCOL_VERSION);
+		Con_Printf ("Server returned version %i, not %i or %i", i, PROTOCOL_VERSION, PROTOCOL_BITPACKED);
 		return;
 	}
+	cl.protocol = i;
+
+	memset (&protostats, 0, sizeof(protostats));
 
 // parse maxclients
 	cl.maxclients = MSG_ReadByte ();
@@ -281,6 +396,23 @@ void CL_ParseServerInfo (void)
 		S_TouchSound (str);
 	}
 
+//
+// start reading and decoding everything that isn't already loaded on
+// the worker threads, the loads below take them in order as they finish
+//
+	start = Sys_FloatTime ();
+	memset (&cl_loadtimes, 0, sizeof(cl_loadtimes));
+	memset (&com_prefetchstats, 0, sizeof(com_prefetchstats));
+	memset (&s_prefetchstats, 0, sizeof(s_prefetchstats));
+
+	for (i=1 ; i<nummodels ; i++)
+		Mod_Prefetch (model_precache[i]);
+	for (i=1 ; i<numsounds ; i++)
+		S_PrefetchSound (sound_precache[i]);
+
+	mark = Sys_FloatTime ();
+	cl_loadtimes.prefetch = mark - start;
+
 //
 // now we try to load everything else until a cache allocation fails
 //
@@ -292,10 +424,16 @@ void CL_ParseServerInfo (void)
 		if (cl.model_precache[i] == NULL)
 		{
 			Con_Printf("Model %s not found\n", model_precache[i]);
+			COM_FlushPrefetch ();
+			S_FlushPrefetch ();
 			return;
 		}
 		CL_KeepaliveMessage ();
 	}
+	COM_FlushPrefetch ();
+
+	cl_loadtimes.models = Sys_FloatTime () - mark;
+	mark = Sys_FloatTime ();
 
 	S_BeginPrecaching ();
 	for (i=1 ; i<numsounds ; i++)
@@ -305,6 +443,8 @@ void CL_ParseServerInfo (void)
 	}
 	S_EndPrecaching ();
 
+	cl_loadtimes.sounds = Sys_FloatTime () - mark;
+	mark = Sys_FloatTime ();
 
 // local state
 	cl_entities[0].model = cl.worldmodel = cl.model_precache[1];
@@ -313,10 +453,47 @@ void CL_ParseServerInfo (void)
 
 	Hunk_Check ();		// make sure nothing is hurt
 
+	cl_loadtimes.newmap = Sys_FloatTime () - mark;
+	cl_loadtimes.total = Sys_FloatTime () - start;
+	Con_DPrintf ("Loaded in %.1f ms\n", cl_loadtimes.total * 1000);
+
+	COM_FileBase (model_precache[1], mapname);
+	Memory_SetMap (mapname);
+
 	noclip_anglehack = false;		// noclip is turned off at start
 }
 
 
+/*
+==================
+CL_ReadUpdateByte, CL_ReadUpdateCoord, CL_ReadUpdateAngle
+
+Read one field of an entity update in the server's protocol
+==================
+*/
+bitreader_t	updatebits;
+
+int CL_ReadUpdateByte (void)
+{
+	if (cl.protocol == PROTOCOL_BITPACKED)
+		return MSG_ReadBits (&updatebits, 8);
+	return MSG_ReadByte ();
+}
+
+float CL_ReadUpdateCoord (float base)
+{
+	if (cl.protocol == PROTOCOL_BITPACKED)
+		return MSG_ReadDeltaCoord (&updatebits, base);
+	return MSG_ReadCoord ();
+}
+
+float CL_ReadUpdateAngle (void)
+{
+	if (cl.protocol == PROTOCOL_BITPACKED)
+		return (signed char)MSG_ReadBits (&updatebits, 8) * (360.0/256);
+	return MSG_ReadAngle ();
+}
+
 /*
 ==================
 CL_ParseUpdate
@@ -357,6 +534,8 @@ void CL_ParseUpdate (int bits)
 
 	ent = CL_EntityNum (num);
 
+	MSG_BeginReadingBits (&updatebits);
+
 for (i=0 ; i<16 ; i++)
 if (bits&(1<<i))
 	bitcounts[i]++;
@@ -370,7 +549,7 @@ if (bits&(1<<i))
 
 	if (bits & U_MODEL)
 	{
-		modnum = MSG_ReadByte ();
+		modnum = CL_ReadUpdateByte ();
 		if (modnum >= MAX_MODELS)
 			Host_Error ("CL_ParseModel: bad modnum");
 	}
@@ -399,12 +578,12 @@ if (bits&(1<<i))
 	}
 
 	if (bits & U_FRAME)
-		ent->frame = MSG_ReadByte ();
+		ent->frame = CL_ReadUpdateByte ();
 	else
 		ent->frame = ent->baseline.frame;
 
 	if (bits & U_COLORMAP)
-		i = MSG_ReadByte();
+		i = CL_ReadUpdateByte ();
 	else
 		i = ent->baseline.colormap;
 	if (!i)
@@ -418,7 +597,7 @@ if (bits&(1<<i))
 
 #ifdef GLQUAKE
 	if (bits & U_SKIN)
-		skin = MSG_ReadByte();
+		skin = CL_ReadUpdateByte ();
 	else
 		skin = ent->baseline.skin;
 	if (skin != ent->skinnum) {
@@ -430,13 +609,13 @@ if (bits&(1<<i))
 #else
 
 	if (bits & U_SKIN)
-		ent->skinnum = MSG_ReadByte();
+		ent->skinnum = CL_ReadUpdateByte ();
 	else
 		ent->skinnum = ent->baseline.skin;
 #endif
 
 	if (bits & U_EFFECTS)
-		ent->effects = MSG_ReadByte();
+		ent->effects = CL_ReadUpdateByte ();
 	else
 		ent->effects = ent->baseline.effects;
 
@@ -445,32 +624,34 @@ if (bits&(1<<i))
 	VectorCopy (ent->msg_angles[0], ent->msg_angles[1]);
 
 	if (bits & U_ORIGIN1)
-		ent->msg_origins[0][0] = MSG_ReadCoord ();
+		ent->msg_origins[0][0] = CL_ReadUpdateCoord (ent->baseline.origin[0]);
 	else
 		ent->msg_origins[0][0] = ent->baseline.origin[0];
 	if (bits & U_ANGLE1)
-		ent->msg_angles[0][0] = MSG_ReadAngle();
+		ent->msg_angles[0][0] = CL_ReadUpdateAngle ();
 	else
 		ent->msg_angles[0][0] = ent->baseline.angles[0];
 
 	if (bits & U_ORIGIN2)
-		ent->msg_origins[0][1] = MSG_ReadCoord ();
+		ent->msg_origins[0][1] = CL_ReadUpdateCoord (ent->baseline.origin[1]);
 	else
 		ent->msg_origins[0][1] = ent->baseline.origin[1];
 	if (bits & U_ANGLE2)
-		ent->msg_angles[0][1] = MSG_ReadAngle();
+		ent->msg_angles[0][1] = CL_ReadUpdateAngle ();
 	else
 		ent->msg_angles[0][1] = ent->baseline.angles[1];
 
 	if (bits & U_ORIGIN3)
-		ent->msg_origins[0][2] = MSG_ReadCoord ();
+		ent->msg_origins[0][2] = CL_ReadUpdateCoord (ent->baseline.origin[2]);
 	else
 		ent->msg_origins[0][2] = ent->baseline.origin[2];
 	if (bits & U_ANGLE3)
-		ent->msg_angles[0][2] = MSG_ReadAngle();
+		ent->msg_angles[0][2] = CL_ReadUpdateAngle ();
 	else
 		ent->msg_angles[0][2] = ent->baseline.angles[2];
 
+	CL_CountUpdate (bits, ent);
+
 	if ( bits & U_NOLERP )
 		ent->forcelink = true;
 
@@ -121,6 +121,7 @@ typedef struct {
 	int td_lastframe;  // to meter out one message a frame
 	int td_startframe;  // host_framecount at start
 	float td_starttime;  // realtime at second frame of timedemo
+	qboolean td_timing;  // the timedemo started a frame time recording
 
 	// connection information
 	int signon;  // 0 to SIGNONS
@@ -193,6 +194,7 @@ typedef struct {
 	int viewentity;  // cl_entitites[cl.viewentity] = player
 	int maxclients;
 	int gametype;
+	int protocol;  // PROTOCOL_VERSION or PROTOCOL_BITPACKED
 
 	// refresh related state
 	struct model_s *worldmodel;  // cl_entitites[0].model
@@ -327,6 +329,20 @@ void CL_TimeDemo_f(void);
 // cl_parse.c
 void CL_ParseServerMessage(void);
 void CL_NewTranslation(int slot);
+void CL_ProtoStats_f(void);
+
+// where the last CL_ParseServerInfo spent its time
+typedef struct {
+	double prefetch;  // queueing reads and decodes
+	double models;
+	double sounds;
+	double newmap;
+	double total;
+} loadtimes_t;
+
+extern loadtimes_t cl_loadtimes;
+
+void CL_LoadTimes_f(void);
 
 // view
 void V_StartPitchDrift(void);
@@ -744,6 +744,210 @@ float MSG_ReadAngle(void) {
 	return MSG_ReadChar() * (360.0 / 256);
 }
 
+//
+// bit level functions
+//
+// Bits are packed low bit first.  Coordinates use the same 1/8 unit
+// quantization as MSG_WriteCoord, but are sent as the difference from a
+// base value (the entity baseline) with a two bit size class in front, so
+// small moves take 8 bits instead of 16.
+//
+
+static int coordclassbits[4] = {6, 10, 14, 17};
+
+void MSG_BeginWritingBits(bitwriter_t* bw, sizebuf_t* sb) {
+	bw->sb = sb;
+	bw->bitbuf = 0;
+	bw->numbits = 0;
+}
+
+// numbits can be up to 24
+void MSG_WriteBits(bitwriter_t* bw, int value, int numbits) {
+	bw->bitbuf |= (value & ((1 << numbits) - 1)) << bw->numbits;
+	bw->numbits += numbits;
+
+	while (bw->numbits >= 8) {
+		MSG_WriteByte(bw->sb, bw->bitbuf & 255);
+		bw->bitbuf >>= 8;
+		bw->numbits -= 8;
+	}
+}
+
+void MSG_EndWritingBits(bitwriter_t* bw) {
+	if (bw->numbits) {
+		MSG_WriteByte(bw->sb, bw->bitbuf & 255);
+	}
+
+	bw->bitbuf = 0;
+	bw->numbits = 0;
+}
+
+static int DeltaCoordValue(float f, float base) {
+	int delta;
+
+	delta = (int)(f * 8) - (int)(base * 8);
+
+	// the largest class holds 17 bits of zigzag
+	if (delta > 65535) {
+		delta = 65535;
+	} else if (delta < -65536) {
+		delta = -65536;
+	}
+
+	// zigzag so small negative moves are small too
+	return ((unsigned int)delta << 1) ^ (delta >> 31);
+}
+
+static int DeltaCoordClass(int zigzag) {
+	int c;
+
+	for (c = 0; c < 3; c++) {
+		if (zigzag < (1 << coordclassbits[c])) {
+			break;
+		}
+	}
+
+	return c;
+}
+
+void MSG_WriteDeltaCoord(bitwriter_t* bw, float f, float base) {
+	int zigzag;
+	int c;
+
+	zigzag = DeltaCoordValue(f, base);
+	c = DeltaCoordClass(zigzag);
+
+	MSG_WriteBits(bw, c, 2);
+	MSG_WriteBits(bw, zigzag, coordclassbits[c]);
+}
+
+int MSG_DeltaCoordBits(float f, float base) {
+	return 2 + coordclassbits[DeltaCoordClass(DeltaCoordValue(f, base))];
+}
+
+void MSG_BeginReadingBits(bitreader_t* br) {
+	br->bitbuf = 0;
+	br->numbits = 0;
+}
+
+// numbits can be up to 24.  reads past the end give zero bits and set
+// msg_badread
+int MSG_ReadBits(bitreader_t* br, int numbits) {
+	int c;
+	int value;
+
+	while (br->numbits < numbits) {
+		c = MSG_ReadByte();
+
+		if (c == -1) {
+			c = 0;
+		}
+
+		br->bitbuf |= c << br->numbits;
+		br->numbits += 8;
+	}
+
+	value = br->bitbuf & ((1 << numbits) - 1);
+	br->bitbuf >>= numbits;
+	br->numbits -= numbits;
+
+	return value;
+}
+
+float MSG_ReadDeltaCoord(bitreader_t* br, float base) {
+	int zigzag;
+	int c;
+
+	c = MSG_ReadBits(br, 2);
+	zigzag = MSG_ReadBits(br, coordclassbits[c]);
+
+	return ((int)(base * 8) + ((zigzag >> 1) ^ -(zigzag & 1))) * (1.0 / 8);
+}
+
+/*
+==================
+MSG_BitTest_f
+
+Round trips random bit fields and delta coords through a scratch buffer
+==================
+*/
+void MSG_BitTest_f(void) {
+	sizebuf_t old;
+	sizebuf_t sb;
+	byte data[2048];
+	int values[256];
+	int sizes[256];
+	float coords[256];
+	float bases[256];
+	bitwriter_t bw;
+	bitreader_t br;
+	int passes;
+	int pass;
+	int count;
+	int errors;
+	int bits;
+	int i;
+	float f;
+
+	passes = Cmd_Argc() > 1 ? Q_atoi(Cmd_Argv(1)) : 1000;
+	errors = 0;
+	bits = 0;
+
+	old = net_message;
+
+	for (pass = 0; pass < passes; pass++) {
+		sb.data = data;
+		sb.maxsize = sizeof(data);
+		sb.cursize = 0;
+		sb.allowoverflow = false;
+		sb.overflowed = false;
+
+		count = rand() % 256;
+
+		// alternate plain fields and coords, with a byte aligned marker in
+		// the middle to make sure the end of a bit run lines up
+		MSG_BeginWritingBits(&bw, &sb);
+
+		for (i = 0; i < count; i++) {
+			sizes[i] = 1 + rand() % 24;
+			values[i] = rand() & ((1 << sizes[i]) - 1);
+			MSG_WriteBits(&bw, values[i], sizes[i]);
+
+			bases[i] = (rand() % 65536 - 32768) * (1.0 / 8);
+			coords[i] = bases[i] + (rand() % (1 << (rand() % 17))) * ((rand() & 1) ? 0.125 : -0.125);
+			MSG_WriteDeltaCoord(&bw, coords[i], bases[i]);
+		}
+
+		MSG_EndWritingBits(&bw);
+		MSG_WriteByte(&sb, 0xa5);
+		bits += sb.cursize * 8;
+
+		net_message = sb;
+		MSG_BeginReading();
+		MSG_BeginReadingBits(&br);
+
+		for (i = 0; i < count; i++) {
+			if (MSG_ReadBits(&br, sizes[i]) != values[i]) {
+				errors++;
+			}
+
+			f = MSG_ReadDeltaCoord(&br, bases[i]);
+
+			if (f != (int)(coords[i] * 8) * (1.0 / 8)) {
+				errors++;
+			}
+		}
+
+		if (MSG_ReadByte() != 0xa5 || msg_badread || msg_readcount != sb.cursize) {
+			errors++;
+		}
+	}
+
+	net_message = old;
+
+	Con_Printf("%i passes, %i bytes, %i errors\n", passes, bits / 8, errors);
+}
+
 
 
 /*
@@ -1165,6 +1369,8 @@ COM_Init
 */
 
 void COM_Path_f(void);
+void COM_AccessLog_f(void);
+void MSG_BitTest_f(void);
 
 void COM_Init() {
 	byte swaptest[2] = {1,0};
@@ -1191,6 +1397,8 @@ void COM_Init() {
 	Cvar_RegisterVariable(&registered);
 	Cvar_RegisterVariable(&cmdline);
 	Cmd_AddCommand("path", COM_Path_f);
+	Cmd_AddCommand("accesslog", COM_AccessLog_f);
+	Cmd_AddCommand("bittest", MSG_BitTest_f);
 
 	COM_InitFilesystem();
 	COM_CheckRegistered();
@@ -1253,6 +1461,8 @@ typedef struct pack_s {
 	int handle; // file descriptor
 	int numfiles;
 	packfile_t *files;
+	byte *mapped;  // the whole pak, read only, or NULL
+	int size;
 } pack_t;
 
 // on disk
@@ -1270,6 +1480,8 @@ typedef struct {
 
 #define MAX_FILES_IN_PACK 2048
 
+#define QPAK_MANIFEST_VERSION 1  // tools/qpak.c writes these
+
 char com_cachedir[MAX_OSPATH];
 char com_gamedir[MAX_OSPATH];
 
@@ -1281,6 +1493,235 @@ typedef struct searchpath_s {
 
 searchpath_t* com_searchpaths;
 
+/*
+=============================================================================
+
+FILE INDEX
+
+Every file in every pak on the search path goes in one hash table, so
+finding out whether a pak has a file is a hash lookup instead of a walk
+over its directory.  COM_FindFile still goes down the search path in
+order and asks each element in turn, which keeps the precedence of paks
+and directories exactly as it was.
+
+Loose files in directories can't be listed ahead of time, so what stat
+found for a directory and file name is remembered in a small table.  It
+is thrown away whenever a file is written, the search path changes or a
+new map is loaded.
+
+=============================================================================
+*/
+
+#define FILEINDEX_HASH 4096  // power of two
+#define LOOSECACHE_SIZE 1024  // power of two
+
+typedef struct fileindex_s {
+	packfile_t* file;
+	searchpath_t* search;
+	struct fileindex_s* next;
+} fileindex_t;
+
+typedef struct {
+	char name[MAX_QPATH];
+	searchpath_t* search;
+	int generation;  // matches com_filegeneration when valid
+	int filetime;  // -1 if not there
+} loosefile_t;
+
+fileindex_t* com_fileindex[FILEINDEX_HASH];
+loosefile_t com_loosefiles[LOOSECACHE_SIZE];
+int com_filegeneration = 1;
+
+struct {
+	int lookups;
+	double time;
+	int packhits;
+	int loosehits;
+	int misses;
+	int loosecached;  // loose lookups answered without a stat
+	int loosestats;
+	int mappedfiles;  // handed out by COM_MapFile
+	int mappedbytes;
+} com_findstats;
+
+byte* com_filemapped;  // set by COM_FindFile when the file is in a mapped pak
+int com_fileoffset;  // where COM_FindFile's handle is positioned
+
+unsigned COM_HashFileName(char* name) {
+	unsigned hash = 0;
+
+	while (*name) {
+		hash = hash * 31 + (unsigned char)*name++;
+	}
+
+	return hash;
+}
+
+/*
+============
+COM_IndexPack
+
+Adds the files of a pak that was just put on the search path
+============
+*/
+void COM_IndexPack(searchpath_t* search) {
+	pack_t* pak = search->pack;
+	fileindex_t* entries = Hunk_AllocName(pak->numfiles * sizeof(fileindex_t), "fileidx");
+
+	for (int i = 0; i < pak->numfiles; i++) {
+		unsigned hash = COM_HashFileName(pak->files[i].name) & (FILEINDEX_HASH - 1);
+
+		entries[i].file = &pak->files[i];
+		entries[i].search = search;
+		entries[i].next = com_fileindex[hash];
+		com_fileindex[hash] = &entries[i];
+	}
+
+	COM_FlushFileCache();
+}
+
+/*
+============
+COM_ClearFileIndex
+============
+*/
+void COM_ClearFileIndex(void) {
+	memset(com_fileindex, 0, sizeof(com_fileindex));
+	COM_FlushFileCache();
+}
+
+/*
+============
+COM_FindInPack
+
+The entry for filename in the pak at search, or NULL
+============
+*/
+packfile_t* COM_FindInPack(searchpath_t* search, char* filename) {
+	unsigned hash = COM_HashFileName(filename) & (FILEINDEX_HASH - 1);
+
+	for (fileindex_t* entry = com_fileindex[hash]; entry; entry = entry->next) {
+		if (entry->search == search && !strcmp(entry->file->name, filename)) {
+			return entry->file;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+============
+COM_FlushFileCache
+============
+*/
+void COM_FlushFileCache(void) {
+	com_filegeneration++;
+}
+
+/*
+============
+COM_LooseFileTime
+
+Sys_FileTime for a file in a search path directory, remembered until the
+cache is flushed
+============
+*/
+int COM_LooseFileTime(searchpath_t* search, char* filename, char* netpath) {
+	if (strlen(filename) >= MAX_QPATH) {
+		com_findstats.loosestats++;
+		return Sys_FileTime(netpath);
+	}
+
+	unsigned hash = (COM_HashFileName(filename) ^ (unsigned)(size_t)search) & (LOOSECACHE_SIZE - 1);
+	loosefile_t* loose = &com_loosefiles[hash];
+
+	if (loose->generation == com_filegeneration &&
+			loose->search == search &&
+			!strcmp(loose->name, filename)) {
+		com_findstats.loosecached++;
+		return loose->filetime;
+	}
+
+	com_findstats.loosestats++;
+
+	strcpy(loose->name, filename);
+	loose->search = search;
+	loose->generation = com_filegeneration;
+	loose->filetime = Sys_FileTime(netpath);
+
+	return loose->filetime;
+}
+
+/*
+==============================================================================
+
+ACCESS LOG
+
+"accesslog <file>" records every file that is found, in the order they
+are first asked for, until "accesslog" is given again.  qpak -order lays
+a pak out in that order, so a map load reads it front to back.
+
+==============================================================================
+*/
+
+#define MAX_ACCESSLOG 4096  // MAX_FILES_IN_PACK * 2
+
+static FILE* com_accesslog;
+static int com_numaccessed;
+static unsigned com_accesshash[MAX_ACCESSLOG];
+static char com_accessed[MAX_ACCESSLOG][MAX_QPATH];
+
+void COM_LogAccess(char* filename) {
+	unsigned hash = COM_HashFileName(filename);
+
+	for (int i = 0; i < com_numaccessed; i++) {
+		if (com_accesshash[i] == hash && !strcmp(com_accessed[i], filename)) {
+			return;
+		}
+	}
+
+	if (com_numaccessed < MAX_ACCESSLOG && strlen(filename) < MAX_QPATH) {
+		com_accesshash[com_numaccessed] = hash;
+		strcpy(com_accessed[com_numaccessed], filename);
+		com_numaccessed++;
+	}
+
+	fprintf(com_accesslog, "%s\n", filename);
+}
+
+void COM_AccessLog_f(void) {
+	if (com_accesslog) {
+		fclose(com_accesslog);
+		com_accesslog = NULL;
+		Con_Printf("%i files logged\n", com_numaccessed);
+	}
+
+	if (Cmd_Argc() != 2) {
+		return;
+	}
+
+	char name[MAX_OSPATH];
+
+	// leave room for the extension
+	if (snprintf(name, sizeof(name) - 4, "%s/%s", com_gamedir, Cmd_Argv(1)) >= sizeof(name) - 4) {
+		Con_Printf("File name is too long\n");
+		return;
+	}
+
+	COM_DefaultExtension(name, ".txt");
+
+	com_accesslog = fopen(name, "w");
+
+	if (!com_accesslog) {
+		Con_Printf("Couldn't open %s\n", name);
+		return;
+	}
+
+	com_numaccessed = 0;
+	Con_Printf("logging file accesses to %s\n", name);
+}
+
+
 /*
 ============
 COM_Path_f
@@ -1296,6 +1737,29 @@ void COM_Path_f(void) {
 			Con_Printf("%s\n", s->filename);
 		}
 	}
+
+	Con_Printf(
+			"%i lookups, %.3f ms total",
+			com_findstats.lookups,
+			com_findstats.time * 1000);
+
+	if (com_findstats.lookups) {
+		Con_Printf(", %.1f usec each", com_findstats.time * 1000000 / com_findstats.lookups);
+	}
+
+	Con_Printf(
+			"\n%i in paks, %i loose, %i not found\n",
+			com_findstats.packhits,
+			com_findstats.loosehits,
+			com_findstats.misses);
+	Con_Printf(
+			"loose file checks: %i cached, %i stat\n",
+			com_findstats.loosecached,
+			com_findstats.loosestats);
+	Con_Printf(
+			"%i files used in place from mapped paks, %i bytes not copied\n",
+			com_findstats.mappedfiles,
+			com_findstats.mappedbytes);
 }
 
 /*
@@ -1309,6 +1773,8 @@ void COM_WriteFile(char* filename, void* data, int len) {
 	char name[MAX_OSPATH];
 	sprintf(name, "%s/%s", com_gamedir, filename);
 
+	COM_FlushFileCache();
+
 	int handle = Sys_FileOpenWrite(name);
 
 	if (handle == -1) {
@@ -1354,6 +1820,7 @@ void COM_CopyFile(char* netpath, char* cachepath) {
 	int remaining = Sys_FileOpenRead(netpath, &in);
 
 	COM_CreatePath(cachepath);  // create directories up to the cache file
+	COM_FlushFileCache();
 
 	int out = Sys_FileOpenWrite(cachepath);
 
@@ -1379,10 +1846,31 @@ Finds the file in the search path.
 Sets com_filesize and one of handle or file
 ===========
 */
+int COM_FindFileUntimed(char* filename, int* handle, FILE** file);
+
 int COM_FindFile(char* filename, int* handle, FILE** file) {
+	double start = Sys_FloatTime();
+	int size = COM_FindFileUntimed(filename, handle, file);
+
+	com_findstats.time += Sys_FloatTime() - start;
+	com_findstats.lookups++;
+
+	if (size == -1) {
+		com_findstats.misses++;
+	} else if (com_accesslog) {
+		COM_LogAccess(filename);
+	}
+
+	return size;
+}
+
+int COM_FindFileUntimed(char* filename, int* handle, FILE** file) {
 	char netpath[MAX_OSPATH];
 	char cachepath[MAX_OSPATH];
 
+	com_filemapped = NULL;
+	com_fileoffset = 0;
+
 	if (file && handle) {
 		Sys_Error("COM_FindFile: both handle and file set");
 	}
@@ -1404,29 +1892,34 @@ int COM_FindFile(char* filename, int* handle, FILE** file) {
 	for (; search; search = search->next) {
 		// is the element a pak file?
 		if (search->pack) {
-			// look through all the pak file elements
 			pack_t* pak = search->pack;
+			packfile_t* packfile = COM_FindInPack(search, filename);
+
+			if (packfile) {
+				// found it!
+				Con_DPrintf("COM_FindFile - PackFile: %s : %s\n", pak->filename, filename);
 
-			for (int i = 0; i < pak->numfiles; i++) {
-				if (!strcmp(pak->files[i].name, filename)) {
-					// found it!
-					Con_DPrintf("COM_FindFile - PackFile: %s : %s\n", pak->filename, filename);
-
-					if (handle) {
-						*handle = pak->handle;
-						Sys_FileSeek(pak->handle, pak->files[i].filepos);
-					} else {
-						// open a new file on the pakfile
-						*file = fopen(pak->filename, "rb");
-
-						if (*file) {
-							fseek(*file, pak->files[i].filepos, SEEK_SET);
-						}
+				if (handle) {
+					*handle = pak->handle;
+					Sys_FileSeek(pak->handle, packfile->filepos);
+				} else {
+					// open a new file on the pakfile
+					*file = fopen(pak->filename, "rb");
+
+					if (*file) {
+						fseek(*file, packfile->filepos, SEEK_SET);
 					}
+				}
 
-					com_filesize = pak->files[i].filelen;
-					return com_filesize;
+				if (pak->mapped) {
+					com_filemapped = pak->mapped + packfile->filepos;
 				}
+
+				com_fileoffset = packfile->filepos;
+
+				com_findstats.packhits++;
+				com_filesize = packfile->filelen;
+				return com_filesize;
 			}
 		} else {
 			// check a file in the directory tree
@@ -1439,7 +1932,7 @@ int COM_FindFile(char* filename, int* handle, FILE** file) {
 
 			sprintf(netpath, "%s/%s", search->filename, filename);
 
-			int findtime = Sys_FileTime(netpath);
+			int findtime = COM_LooseFileTime(search, filename, netpath);
 
 			if (findtime == -1) {
 				continue;
@@ -1473,6 +1966,14 @@ int COM_FindFile(char* filename, int* handle, FILE** file) {
 			int netfile_handle;
 			com_filesize = Sys_FileOpenRead(netpath, &netfile_handle);
 
+			if (com_filesize == -1) {
+				// gone since it was last looked for
+				COM_FlushFileCache();
+				continue;
+			}
+
+			com_findstats.loosehits++;
+
 			if (handle) {
 				*handle = netfile_handle;
 			} else {
@@ -1552,13 +2053,23 @@ cache_user_t* loadcache;
 byte* loadbuf;
 int loadsize;
 
+struct prefetch_s* COM_FindPrefetch(char* path);
+byte* COM_TakePrefetch(struct prefetch_s* pf);
+
 byte* COM_LoadFile(char* path, int usehunk) {
 	// look for it in the filesystem or pack files
-	int h;
-	int len = COM_OpenFile(path, &h);
+	int h = -1;
+	int len;
+	struct prefetch_s* pf = COM_FindPrefetch(path);
 
-	if (h == -1) {
-		return NULL;
+	if (pf) {
+		len = com_filesize;
+	} else {
+		len = COM_OpenFile(path, &h);
+
+		if (h == -1) {
+			return NULL;
+		}
 	}
 
 	// extract the filename base name for hunk tag
@@ -1591,6 +2102,13 @@ byte* COM_LoadFile(char* path, int usehunk) {
 
 	((byte*)buf)[len] = 0;
 
+	if (pf) {
+		byte* data = COM_TakePrefetch(pf);
+		memcpy(buf, data, len);
+		free(data);
+		return buf;
+	}
+
 	Draw_BeginDisc();
 	Sys_FileRead(h, buf, len);
 	COM_CloseFile(h);
@@ -1615,6 +2133,231 @@ void COM_LoadCacheFile(char* path, struct cache_user_s* cu) {
 	COM_LoadFile(path, 3);
 }
 
+/*
+============
+COM_MapFile
+
+For loaders that only read the file, there's no need to load it at all
+when it is in a mapped pak.  Every process using the pak shares the
+same pages.
+============
+*/
+byte* COM_MapFile(char* path) {
+	int h;
+
+	COM_OpenFile(path, &h);
+
+	if (h == -1) {
+		return NULL;
+	}
+
+	COM_CloseFile(h);
+
+	if (com_filemapped) {
+		com_findstats.mappedfiles++;
+		com_findstats.mappedbytes += com_filesize;
+	}
+
+	return com_filemapped;
+}
+
+/*
+============
+COM_LocateFile
+============
+*/
+qboolean COM_LocateFile(char* path, filelocation_t* loc) {
+	int h;
+
+	loc->length = COM_OpenFile(path, &h);
+
+	if (h == -1) {
+		return false;
+	}
+
+	loc->handle = h;
+	loc->offset = com_fileoffset;
+	loc->mapped = com_filemapped;
+
+	return true;
+}
+
+/*
+============
+COM_ReadLocation
+
+Pak handles are shared, so this reads at an offset rather than seeking
+============
+*/
+qboolean COM_ReadLocation(filelocation_t* loc, byte* dest) {
+	if (loc->mapped) {
+		memcpy(dest, loc->mapped, loc->length);
+		return true;
+	}
+
+	for (int done = 0; done < loc->length; ) {
+		int count = Sys_FileReadAt(
+				loc->handle,
+				dest + done,
+				loc->length - done,
+				loc->offset + done);
+
+		if (count <= 0) {
+			return false;
+		}
+
+		done += count;
+	}
+
+	return true;
+}
+
+void COM_ReleaseLocation(filelocation_t* loc) {
+	COM_CloseFile(loc->handle);
+}
+
+
+/*
+==============================================================================
+
+FILE PREFETCH
+
+A level's precache list is known before any of it is loaded, so the
+reads can all be started at once on the worker threads.  The loaders
+still run in order on the main thread; COM_LoadFile just copies the
+bytes that are already there instead of waiting on the disk for each
+file in turn.
+
+Files in mapped paks aren't read at all, the job only touches their
+pages so the loader doesn't fault them in one at a time.
+
+==============================================================================
+*/
+
+#define MAX_PREFETCH 256  // MAX_MODELS
+
+typedef struct prefetch_s {
+	char name[MAX_QPATH];
+	filelocation_t loc;
+	byte* data;  // malloced, NULL for mapped files
+	qboolean failed;
+	qboolean used;
+	job_t job;
+} prefetch_t;
+
+static prefetch_t com_prefetch[MAX_PREFETCH];
+static int com_numprefetch;
+
+prefetchstats_t com_prefetchstats;
+
+static void COM_PrefetchJob(void* data) {
+	prefetch_t* pf = data;
+
+	if (pf->data) {
+		pf->failed = !COM_ReadLocation(&pf->loc, pf->data);
+		return;
+	}
+
+	volatile byte sum = 0;
+
+	for (int i = 0; i < pf->loc.length; i += 4096) {
+		sum += pf->loc.mapped[i];
+	}
+}
+
+void COM_PrefetchFile(char* path) {
+	if (com_numprefetch == MAX_PREFETCH || strlen(path) >= MAX_QPATH) {
+		return;
+	}
+
+	for (int i = 0; i < com_numprefetch; i++) {
+		if (!strcmp(com_prefetch[i].name, path)) {
+			return;
+		}
+	}
+
+	prefetch_t* pf = &com_prefetch[com_numprefetch];
+
+	if (!COM_LocateFile(path, &pf->loc)) {
+		return;
+	}
+
+	strcpy(pf->name, path);
+	pf->failed = false;
+	pf->used = false;
+	pf->data = NULL;
+
+	if (!pf->loc.mapped) {
+		pf->data = malloc(pf->loc.length + 1);
+
+		if (!pf->data) {
+			COM_ReleaseLocation(&pf->loc);
+			return;
+		}
+	}
+
+	com_numprefetch++;
+	com_prefetchstats.files++;
+	com_prefetchstats.bytes += pf->loc.length;
+
+	Job_Submit(&pf->job, COM_PrefetchJob, pf);
+}
+
+/*
+============
+COM_FindPrefetch
+
+Returns a finished read of path and sets com_filesize, or NULL if the
+file should be loaded the usual way
+============
+*/
+prefetch_t* COM_FindPrefetch(char* path) {
+	for (int i = 0; i < com_numprefetch; i++) {
+		prefetch_t* pf = &com_prefetch[i];
+
+		if (pf->used || !pf->data || strcmp(pf->name, path)) {
+			continue;
+		}
+
+		double start = Sys_FloatTime();
+		Job_Wait(&pf->job);
+		com_prefetchstats.wait += Sys_FloatTime() - start;
+
+		if (pf->failed) {
+			return NULL;
+		}
+
+		com_filemapped = NULL;
+		com_filesize = pf->loc.length;
+		return pf;
+	}
+
+	return NULL;
+}
+
+// the caller frees the returned bytes
+byte* COM_TakePrefetch(prefetch_t* pf) {
+	byte* data = pf->data;
+
+	pf->data = NULL;
+	pf->used = true;
+	com_prefetchstats.used++;
+	return data;
+}
+
+void COM_FlushPrefetch(void) {
+	for (int i = 0; i < com_numprefetch; i++) {
+		prefetch_t* pf = &com_prefetch[i];
+
+		Job_Wait(&pf->job);
+		COM_ReleaseLocation(&pf->loc);
+		free(pf->data);
+	}
+
+	com_numprefetch = 0;
+}
+
+
 // uses temp hunk if larger than bufsize
 byte* COM_LoadStackFile(char* path, void* buffer, int bufsize) {
 	Con_DPrintf("COM_LoadStackFile: ");
@@ -1627,6 +2370,84 @@ byte* COM_LoadStackFile(char* path, void* buffer, int bufsize) {
 	return buf;
 }
 
+/*
+=================
+COM_CheckManifest
+
+Paks built by qpak come with a <pak>.manifest listing the directory crc
+and the crc of every file.  The directory check is free, since the crc
+was already taken; -checkpaks also reads and checks every file.
+=================
+*/
+void COM_CheckManifest(pack_t* pack, unsigned short dircrc) {
+	char name[sizeof(pack->filename) + 9];
+	snprintf(name, sizeof(name), "%s.manifest", pack->filename);
+
+	FILE* f = fopen(name, "r");
+
+	if (!f) {
+		return;
+	}
+
+	int version, numfiles, size;
+	unsigned short crc;
+
+	if (fscanf(f, "QPAK %i", &version) != 1 ||
+			version != QPAK_MANIFEST_VERSION ||
+			fscanf(f, "%i %hu %i", &numfiles, &crc, &size) != 3) {
+		Con_Printf("%s is not a manifest\n", name);
+		fclose(f);
+		return;
+	}
+
+	if (numfiles != pack->numfiles || crc != dircrc || size != pack->size) {
+		Con_Printf("WARNING: %s doesn't match its manifest\n", pack->filename);
+		fclose(f);
+		return;
+	}
+
+	if (!COM_CheckParm("-checkpaks")) {
+		fclose(f);
+		return;
+	}
+
+	int bad = 0;
+	char filename[MAX_QPATH];
+	int filepos, filelen;
+
+	while (fscanf(f, "%hu %i %i %63s", &crc, &filepos, &filelen, filename) == 4) {
+		if (filepos < 0 || filelen < 0 || filepos > pack->size - filelen) {
+			bad++;
+			continue;
+		}
+
+		byte* data = pack->mapped ? pack->mapped + filepos : malloc(filelen);
+
+		if (!data) {
+			Con_Printf("%s: no memory to check %s\n", pack->filename, filename);
+			bad++;
+			continue;
+		}
+
+		// the handle is shared with COM_FindFile, so leave its position alone
+		if ((!pack->mapped && Sys_FileReadAt(pack->handle, data, filelen, filepos) != filelen)
+				|| CRC_Block(data, filelen) != crc) {
+			Con_Printf("%s: %s is damaged\n", pack->filename, filename);
+			bad++;
+		}
+
+		if (!pack->mapped) {
+			free(data);
+		}
+	}
+
+	fclose(f);
+
+	if (!bad) {
+		Con_Printf("%s checked against its manifest\n", pack->filename);
+	}
+}
+
 /*
 =================
 COM_LoadPackFile
@@ -1641,8 +2462,9 @@ only called in COM_AddGameDirectory and COM_InitFilesystem
 */
 pack_t* COM_LoadPackFile(char* packfile) {
 	int packhandle;
+	int packsize = Sys_FileOpenRead(packfile, &packhandle);
 
-	if (Sys_FileOpenRead(packfile, &packhandle) == -1) {
+	if (packsize == -1) {
 		// Con_Printf ("Couldn't open %s\n", packfile);
 		return NULL;
 	}
@@ -1729,6 +2551,24 @@ pack_t* COM_LoadPackFile(char* packfile) {
 	pack->handle = packhandle;
 	pack->numfiles = numpackfiles;
 	pack->files = newfiles;
+	pack->size = packsize;
+
+	// files are checked against the pak size so a bad directory can't
+	// point anything outside the mapping
+	if (!COM_CheckParm("-nomappak")) {
+		pack->mapped = Sys_MapFile(packhandle, packsize);
+
+		for (int i = 0; pack->mapped && i < numpackfiles; i++) {
+			if (newfiles[i].filepos < 0 ||
+					newfiles[i].filelen < 0 ||
+					newfiles[i].filepos > packsize - newfiles[i].filelen) {
+				Sys_UnmapFile(pack->mapped, packsize);
+				pack->mapped = NULL;  // just read it the old way
+			}
+		}
+	}
+
+	COM_CheckManifest(pack, crc);
 
 	Con_Printf("Added packfile %s (%i files)\n", packfile, numpackfiles);
 	return pack;
@@ -1769,8 +2609,12 @@ void COM_AddGameDirectory(char* dir) {
 		search->pack = pak;
 		search->next = com_searchpaths;
 		com_searchpaths = search;
+
+		COM_IndexPack(search);
 	}
 
+	COM_FlushFileCache();
+
 	// add the contents of the parms.txt file to the end of the command line
 }
 
@@ -1846,6 +2690,7 @@ void COM_InitFilesystem() {
 	if (path_parm) {
 		com_modified = true;
 		com_searchpaths = NULL;
+		COM_ClearFileIndex();
 
 		while (++path_parm < com_argc) {
 			if (!com_argv[path_parm] ||
@@ -1868,6 +2713,10 @@ void COM_InitFilesystem() {
 
 			search->next = com_searchpaths;
 			com_searchpaths = search;
+
+			if (search->pack) {
+				COM_IndexPack(search);
+			}
 		}
 	}
 
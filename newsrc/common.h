@@ -84,7 +84,7 @@ void InsertLinkAfter(link_t* link, link_t* after);
 
 //============================================================================
 
-extern qboolean bigendien;
+extern qboolean bigendian;
 
 extern short (*BigShort) (short l);
 extern short (*LittleShort) (short l);
@@ -118,6 +118,30 @@ char *MSG_ReadString(void);
 float MSG_ReadCoord(void);
 float MSG_ReadAngle(void);
 
+// bit level access, used for PROTOCOL_BITPACKED entity updates.  a run of
+// bit fields always ends on a byte boundary, so it can sit between normal
+// byte aligned fields
+typedef struct {
+	sizebuf_t* sb;
+	unsigned int bitbuf;
+	int numbits;
+} bitwriter_t;
+
+typedef struct {
+	unsigned int bitbuf;
+	int numbits;
+} bitreader_t;
+
+void MSG_BeginWritingBits(bitwriter_t* bw, sizebuf_t* sb);
+void MSG_WriteBits(bitwriter_t* bw, int value, int numbits);
+void MSG_EndWritingBits(bitwriter_t* bw);
+void MSG_WriteDeltaCoord(bitwriter_t* bw, float f, float base);
+int MSG_DeltaCoordBits(float f, float base);
+
+void MSG_BeginReadingBits(bitreader_t* br);
+int MSG_ReadBits(bitreader_t* br, int numbits);
+float MSG_ReadDeltaCoord(bitreader_t* br, float base);
+
 //============================================================================
 
 void Q_memset(void* dest, int fill, int count);
@@ -167,10 +191,48 @@ struct cache_user_s;
 extern char com_gamedir[MAX_OSPATH];
 
 void COM_WriteFile(char* filename, void* data, int len);
+// makes the directories leading up to path
+void COM_CreatePath(char* path);
 int COM_OpenFile(char* filename, int* hndl);
 int COM_FOpenFile(char* filename, FILE** file);
 void COM_CloseFile(int h);
 
+// forget what is known about loose files, so they are looked for again
+void COM_FlushFileCache(void);
+
+// a read only pointer straight into a mapped pak, or NULL if the file
+// isn't in one; sets com_filesize.  There is no 0 byte on the end.
+byte* COM_MapFile(char* path);
+
+// where a file's bytes are, so another thread can read them
+typedef struct {
+	int handle;
+	int offset;
+	int length;
+	byte* mapped;  // in a mapped pak, no read needed
+} filelocation_t;
+
+// COM_LocateFile and COM_ReleaseLocation are main thread only,
+// COM_ReadLocation can be called from any thread in between
+qboolean COM_LocateFile(char* path, filelocation_t* loc);
+qboolean COM_ReadLocation(filelocation_t* loc, byte* dest);
+void COM_ReleaseLocation(filelocation_t* loc);
+
+// starts reading a file on a worker thread; the next COM_LoadFile of
+// the same path takes the bytes instead of reading them itself
+void COM_PrefetchFile(char* path);
+// waits for and frees whatever wasn't used
+void COM_FlushPrefetch(void);
+
+typedef struct {
+	int files;
+	int bytes;
+	int used;
+	double wait;  // main thread time spent waiting for reads to finish
+} prefetchstats_t;
+
+extern prefetchstats_t com_prefetchstats;
+
 byte* COM_LoadStackFile(char* path, void* buffer, int bufsize);
 byte* COM_LoadTempFile(char* path);
 byte* COM_LoadHunkFile(char* path);
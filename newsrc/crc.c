@@ -72,6 +72,44 @@ void CRC_ProcessByte(unsigned short* crcvalue, byte data) {
 	*crcvalue = (*crcvalue << 8) ^ crctable[(*crcvalue >> 8) ^ data];
 }
 
+unsigned short CRC_Block(byte* start, int count) {
+	unsigned short crc;
+
+	CRC_Init(&crc);
+
+	while (count--) {
+		crc = (crc << 8) ^ crctable[(crc >> 8) ^ *start++];
+	}
+
+	return crc;
+}
+
+// the 32 bit CRC zip uses, for telling files apart by their contents
+unsigned CRC32_Block(byte* start, int count) {
+	static unsigned table[256];
+	unsigned crc;
+
+	if (!table[1]) {
+		for (int i = 0; i < 256; i++) {
+			crc = i;
+
+			for (int j = 0; j < 8; j++) {
+				crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+			}
+
+			table[i] = crc;
+		}
+	}
+
+	crc = 0xffffffff;
+
+	while (count--) {
+		crc = (crc >> 8) ^ table[(crc ^ *start++) & 0xff];
+	}
+
+	return crc ^ 0xffffffff;
+}
+
 // unused
 unsigned short CRC_Value(unsigned short crcvalue) {
 	return crcvalue ^ CRC_XOR_VALUE;
@@ -120,6 +120,8 @@ void Cvar_Set(char *var_name, char *value) {
 	var->value = Q_atof(var->string);
 
 	if (var->server && changed) {
+		net_serverstatechanged = true;
+
 		if (sv.active) {
 			SV_BroadcastPrintf("\"%s\" changed to \"%s\"\n", var->name, var->string);
 		}
@@ -35,6 +35,36 @@ extern void			R_TransformFrustum (void);
 
 vec3_t		transformed_modelorg;
 
+/*
+Lightmapped surfaces make up nearly all of the span drawing.  Instead of
+drawing them as they come, D_DrawSurfaces records their spans and
+gradients here, and at the end of the pass the screen is cut into bands
+of rows that the job workers draw independently.  Every pixel belongs to
+exactly one span in a pass, so the order spans are drawn in doesn't
+matter and the result is identical to drawing them in order.
+
+The only thing the queued spans share with the rest of the frame is the
+surface cache, so anything about to write into a block a queued surface
+is reading from has to flush the queue first (D_SpanCacheWrite).
+*/
+
+#define	MAX_SPANJOBS		1024
+#define	SPANJOB_BANDROWS	8		// don't cut bands thinner than this
+#define	MAX_SPANBANDS		((MAX_WORKERS + 1) * 4)
+
+static spanstate_t	d_spanjobs_queue[MAX_SPANJOBS];
+static int			d_numspanjobs;
+
+// the queued spans sorted by band, each band's run in queue order
+typedef struct
+{
+	spanstate_t	*st;
+	espan_t		*span;
+} bandspan_t;
+
+static bandspan_t	d_bandspans[MAXSPANS];
+static int			d_bandstart[MAX_SPANBANDS + 1];
+
 /*
 ==============
 D_DrawPoly
@@ -166,6 +196,147 @@ void D_CalcGradients (msurface_t *pface)
 }
 
 
+/*
+==============
+D_DrawSpanBand
+==============
+*/
+static void D_DrawSpanBand (void *data, int band)
+{
+	bandspan_t	*bs, *end;
+
+	end = &d_bandspans[d_bandstart[band+1]];
+	for (bs = &d_bandspans[d_bandstart[band]] ; bs < end ; bs++)
+	{
+		D_DrawSpan8 (bs->st, bs->span);
+		D_DrawZSpan (bs->st, bs->span);
+	}
+}
+
+
+/*
+==============
+D_FlushSpanJobs
+
+Draws everything queued, split into bands over the workers.  The spans
+are sorted into their bands here, in two passes over the queue, so no
+band has to look at the spans of the others.
+==============
+*/
+void D_FlushSpanJobs (void)
+{
+	int			i, band, numbands, bandrows, total, count;
+	espan_t		*pspan;
+	spanstate_t	*st;
+
+	if (!d_numspanjobs)
+		return;
+
+// a few bands per thread, so a band full of detail doesn't hold up the rest
+	numbands = (Jobs_Workers () + 1) * 4;
+	bandrows = (r_refdef.vrect.height + numbands - 1) / numbands;
+	if (bandrows < SPANJOB_BANDROWS)
+		bandrows = SPANJOB_BANDROWS;
+	numbands = (r_refdef.vrect.height + bandrows - 1) / bandrows;
+
+// count the spans in each band, then turn the counts into starts
+	memset (d_bandstart, 0, sizeof(d_bandstart));
+	for (i=0, st=d_spanjobs_queue ; i<d_numspanjobs ; i++, st++)
+		for (pspan = st->spans ; pspan ; pspan = pspan->pnext)
+			d_bandstart[(pspan->v - r_refdef.vrect.y) / bandrows + 1]++;
+
+	total = 0;
+	for (band=0 ; band<=numbands ; band++)
+	{
+		count = d_bandstart[band];
+		d_bandstart[band] = total;
+		total += count;
+	}
+
+	if (total > MAXSPANS)
+		Sys_Error ("D_FlushSpanJobs: %i spans", total);
+
+// d_bandstart[band+1] is the next free slot of band while filling, and
+// ends up where band+1 starts
+	for (i=0, st=d_spanjobs_queue ; i<d_numspanjobs ; i++, st++)
+	{
+		for (pspan = st->spans ; pspan ; pspan = pspan->pnext)
+		{
+			band = (pspan->v - r_refdef.vrect.y) / bandrows;
+			d_bandspans[d_bandstart[band+1]].st = st;
+			d_bandspans[d_bandstart[band+1]].span = pspan;
+			d_bandstart[band+1]++;
+		}
+	}
+
+	Job_Parallel (D_DrawSpanBand, NULL, numbands);
+
+	d_numspanjobs = 0;
+}
+
+
+/*
+==============
+D_SpanCacheWrite
+
+Called before anything is written to [start, start+size) of the surface
+cache
+==============
+*/
+void D_SpanCacheWrite (void *start, int size)
+{
+	int		i;
+	byte	*block;
+
+	for (i=0 ; i<d_numspanjobs ; i++)
+	{
+		block = (byte *)d_spanjobs_queue[i].cacheblock;
+		if (block >= (byte *)start && block < (byte *)start + size)
+		{
+			D_FlushSpanJobs ();
+			return;
+		}
+	}
+}
+
+
+/*
+==============
+D_PrebuildSurfaces
+
+Walks the pass the way D_DrawSurfaces will, queueing the lightmapped
+surfaces whose cache entries are stale, then builds them all at once
+==============
+*/
+static void D_PrebuildSurfaces (void)
+{
+	surf_t			*s;
+	msurface_t		*pface;
+
+	for (s = &surfaces[1] ; s<surface_p ; s++)
+	{
+		if (!s->spans)
+			continue;
+
+		if (s->flags & (SURF_DRAWSKY | SURF_DRAWBACKGROUND | SURF_DRAWTURB))
+			continue;
+
+	// R_TextureAnimation looks at the entity's frame
+		currententity = s->insubmodel ? s->entity : &cl_entities[0];
+
+		pface = s->data;
+		miplevel = D_MipLevelForScale (s->nearzi * scale_for_mip
+		* pface->texinfo->mipadjust);
+
+		D_PrebuildSurface (pface, miplevel);
+	}
+
+	currententity = &cl_entities[0];
+
+	D_FlushSurfaceBuilds ();
+}
+
+
 /*
 ==============
 D_DrawSurfaces
@@ -178,11 +349,21 @@ void D_DrawSurfaces (void)
 	surfcache_t		*pcurrentcache;
 	vec3_t			world_transformed_modelorg;
 	vec3_t			local_modelorg;
+	qboolean		spanjobs;
 
 	currententity = &cl_entities[0];
 	TransformVector (modelorg, transformed_modelorg);
 	VectorCopy (transformed_modelorg, world_transformed_modelorg);
 
+// queue the textured spans for the workers, unless there is nobody to
+// share them with or the span drawer isn't the C one
+	spanjobs = d_spanjobs.value && Jobs_Workers () && d_drawspans == D_DrawSpans8;
+
+// build every surface cache entry this pass needs on the workers before
+// drawing anything
+	if (!r_drawflat.value && d_surfjobs.value && Jobs_Workers ())
+		D_PrebuildSurfaces ();
+
 // TODO: could preset a lot of this at mode set time
 	if (r_drawflat.value)
 	{
@@ -304,9 +485,18 @@ void D_DrawSurfaces (void)
 
 				D_CalcGradients (pface);
 
-				(*d_drawspans) (s->spans);
+				if (spanjobs)
+				{
+					if (d_numspanjobs == MAX_SPANJOBS)
+						D_FlushSpanJobs ();
+					D_SpanState (&d_spanjobs_queue[d_numspanjobs++], s->spans);
+				}
+				else
+				{
+					(*d_drawspans) (s->spans);
 
-				D_DrawZSpans (s->spans);
+					D_DrawZSpans (s->spans);
+				}
 
 				if (s->insubmodel)
 				{
@@ -327,4 +517,7 @@ void D_DrawSurfaces (void)
 			}
 		}
 	}
+
+// the spans live in R_ScanEdges' buffer, which is reused after this
+	D_FlushSpanJobs ();
 }
@@ -201,7 +201,7 @@ typedef struct
 	int			surfheight;	// in mipmapped texels
 } drawsurf_t;
 
-extern drawsurf_t	r_drawsurf;
+extern THREADLOCAL drawsurf_t	r_drawsurf;
 
 void R_DrawSurface (void);
 void R_GenTile (msurface_t *psurf, void *pdest);
@@ -223,6 +223,28 @@ extern float	skyspeed, skyspeed2;
 extern float	skytime;
 
 extern int		c_surf;
+
+// surface cache traffic for r_speeds, reset when printed
+extern int		d_cachehits;		// reused as is
+extern int		d_cachenew;			// built into a newly allocated block
+extern int		d_cacherelit;		// rebuilt in place for lights or animation
+extern int		d_cacheprebuilt;	// of those built, how many on the job workers
+
+// surface cache activity for the current frame, printed by r_dspeeds
+typedef struct
+{
+	int		allocs;
+	int		wraps;			// times the rover went back to the start
+	int		evictions;
+	int		reused;			// evictions of surfaces drawn earlier this frame
+	int		builds;
+	int		bytesbuilt;
+	int		workingset;		// bytes of cache the frame's surfaces use
+} dcachestats_t;
+
+extern dcachestats_t	d_cachestats;
+extern int				sc_size;			// bytes in the surface cache
+extern int				d_surfcachewanted;
 extern vrect_t	scr_vrect;
 
 extern byte		*r_warpbuffer;
@@ -27,6 +27,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 cvar_t	d_subdiv16 = {"d_subdiv16", "1"};
 cvar_t	d_mipcap = {"d_mipcap", "0"};
 cvar_t	d_mipscale = {"d_mipscale", "1"};
+cvar_t	d_spanjobs = {"d_spanjobs", "1"};
+cvar_t	d_surfjobs = {"d_surfjobs", "1"};
+cvar_t	d_cacheadapt = {"d_cacheadapt", "1"};
 
 surfcache_t		*d_initial_rover;
 qboolean		d_roverwrapped;
@@ -53,6 +56,9 @@ void D_Init (void)
 	Cvar_RegisterVariable (&d_subdiv16);
 	Cvar_RegisterVariable (&d_mipcap);
 	Cvar_RegisterVariable (&d_mipscale);
+	Cvar_RegisterVariable (&d_spanjobs);
+	Cvar_RegisterVariable (&d_surfjobs);
+	Cvar_RegisterVariable (&d_cacheadapt);
 
 	r_drawpolys = false;
 	r_worldpolysbacktofront = false;
@@ -136,6 +142,8 @@ void D_SetupFrame (void)
 	d_roverwrapped = false;
 	d_initial_rover = sc_rover;
 
+	D_CacheFrame ();
+
 	d_minmip = d_mipcap.value;
 	if (d_minmip > 3)
 		d_minmip = 3;
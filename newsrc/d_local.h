@@ -45,6 +45,8 @@ typedef struct surfcache_s
 	unsigned			height;		// DEBUG only needed for debug
 	float				mipscale;
 	struct texture_s	*texture;	// checked for animating textures
+	qboolean			prebuilt;	// built by D_FlushSurfaceBuilds, not drawn yet
+	int					usedframe;	// r_framecount when last drawn
 	byte				data[4];	// width*height elements
 } surfcache_t;
 
@@ -70,6 +72,34 @@ fixed16_t	sadjust, tadjust;
 fixed16_t	bbextents, bbextentt;
 
 
+// everything the span drawers read besides the frame and z buffers, so
+// a surface's spans can be drawn after the globals have moved on
+typedef struct
+{
+	espan_t		*spans;
+	pixel_t		*cacheblock;
+	int			cachewidth;
+	float		sdivzstepu, tdivzstepu, zistepu;
+	float		sdivzstepv, tdivzstepv, zistepv;
+	float		sdivzorigin, tdivzorigin, ziorigin;
+	fixed16_t	sadjust, tadjust;
+	fixed16_t	bbextents, bbextentt;
+} spanstate_t;
+
+extern cvar_t	d_spanjobs;
+extern cvar_t	d_surfjobs;
+extern cvar_t	d_cacheadapt;
+
+// frames in a row the surface cache has to be too small before it grows
+#define	CACHE_THRASHFRAMES	8
+
+void D_CacheFrame (void);
+
+void D_SpanState (spanstate_t *st, espan_t *pspan);
+void D_DrawSpan8 (spanstate_t *st, espan_t *pspan);
+void D_DrawZSpan (spanstate_t *st, espan_t *pspan);
+void D_SpanCacheWrite (void *start, int size);
+
 void D_DrawSpans8 (espan_t *pspans);
 void D_DrawSpans16 (espan_t *pspans);
 void D_DrawZSpans (espan_t *pspans);
@@ -82,6 +112,8 @@ void D_DrawSkyScans16 (espan_t *pspan);
 void R_ShowSubDiv (void);
 void (*prealspandrawer)(void);
 surfcache_t	*D_CacheSurface (msurface_t *surface, int miplevel);
+void D_PrebuildSurface (msurface_t *surface, int miplevel);
+void D_FlushSurfaceBuilds (void);
 
 extern int D_MipLevelForScale (float scale);
 
@@ -24,6 +24,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "r_local.h"
 #include "d_local.h"
 
+#if !id386 && (defined(__x86_64__) || defined(__i386__))
+#define D_AVX2
+#include <immintrin.h>
+#endif
+
 // TODO: put in span spilling to shrink list size
 // !!! if this is changed, it must be changed in d_polysa.s too !!!
 #define DPS_MAXSPANS			MAXHEIGHT+1
@@ -606,6 +611,96 @@ void InitGel (byte *palette)
 
 #if	!id386
 
+#ifdef D_AVX2
+/*
+================
+D_PolysetDrawSpan8_AVX2
+
+Eight pixels at a time.  The C loop carries the s and t fractions from
+pixel to pixel; the same texel offsets come out of stepping both
+fractions from the span start, since whatever carried is just the high
+16 bits of the sum.  The skin and the colormap are gathered a dword
+ending on the wanted byte, the same as the surface block drawers do.
+Returns the pixels done, the rest are left to the C loop.
+================
+*/
+__attribute__((target("avx2")))
+static int D_PolysetDrawSpan8_AVX2 (byte *lpdest, short *lpz, byte *lptex,
+	int lsfrac, int ltfrac, int llight, int lzi, int lcount)
+{
+	__m256i	lane, sfrac, tfrac, light, zi, texoffs, whole, tex, pix, z, zbuf, draw;
+	__m256i	sstep, tstep, lstep, zistep, lightmask;
+	__m128i	pix16, z16, draw16, draw8, zpick;
+	int		i;
+
+	lane = _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7);
+
+	sfrac = _mm256_add_epi32 (_mm256_set1_epi32 (lsfrac),
+			_mm256_mullo_epi32 (lane, _mm256_set1_epi32 (a_sstepxfrac)));
+	tfrac = _mm256_add_epi32 (_mm256_set1_epi32 (ltfrac),
+			_mm256_mullo_epi32 (lane, _mm256_set1_epi32 (a_tstepxfrac)));
+	light = _mm256_add_epi32 (_mm256_set1_epi32 (llight),
+			_mm256_mullo_epi32 (lane, _mm256_set1_epi32 (r_lstepx)));
+	zi = _mm256_add_epi32 (_mm256_set1_epi32 (lzi),
+			_mm256_mullo_epi32 (lane, _mm256_set1_epi32 (r_zistepx)));
+	whole = _mm256_mullo_epi32 (lane, _mm256_set1_epi32 (a_ststepxwhole));
+
+	sstep = _mm256_set1_epi32 (a_sstepxfrac * 8);
+	tstep = _mm256_set1_epi32 (a_tstepxfrac * 8);
+	lstep = _mm256_set1_epi32 (r_lstepx * 8);
+	zistep = _mm256_set1_epi32 (r_zistepx * 8);
+	lightmask = _mm256_set1_epi32 (0xFF00);
+
+// low halves of eight dwords
+	zpick = _mm_setr_epi8 (0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	for (i=0 ; i+8<=lcount ; i+=8)
+	{
+		texoffs = _mm256_add_epi32 (_mm256_add_epi32 (whole,
+				_mm256_srai_epi32 (sfrac, 16)),
+				_mm256_mullo_epi32 (_mm256_srai_epi32 (tfrac, 16),
+				_mm256_set1_epi32 (r_affinetridesc.skinwidth)));
+
+		tex = _mm256_srli_epi32 (_mm256_i32gather_epi32 (
+				(int *)(lptex - 3), texoffs, 1), 24);
+		pix = _mm256_srli_epi32 (_mm256_i32gather_epi32 (
+				(int *)((byte *)acolormap - 3),
+				_mm256_add_epi32 (tex, _mm256_and_si256 (light, lightmask)), 1), 24);
+
+	// z test against the sign extended buffer, the same compare as C
+		z = _mm256_srai_epi32 (zi, 16);
+		zbuf = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((__m128i *)(lpz + i)));
+		draw = _mm256_xor_si256 (_mm256_cmpgt_epi32 (zbuf, z),
+				_mm256_set1_epi32 (-1));
+
+		draw16 = _mm_packs_epi32 (_mm256_castsi256_si128 (draw),
+				_mm256_extracti128_si256 (draw, 1));
+		draw8 = _mm_packs_epi16 (draw16, draw16);
+
+		pix16 = _mm_packus_epi32 (_mm256_castsi256_si128 (pix),
+				_mm256_extracti128_si256 (pix, 1));
+		pix16 = _mm_packus_epi16 (pix16, pix16);
+		_mm_storel_epi64 ((__m128i *)(lpdest + i), _mm_blendv_epi8 (
+				_mm_loadl_epi64 ((__m128i *)(lpdest + i)), pix16, draw8));
+
+	// the buffer keeps the low 16 bits, as the C store does
+		z16 = _mm_unpacklo_epi64 (
+				_mm_shuffle_epi8 (_mm256_castsi256_si128 (z), zpick),
+				_mm_shuffle_epi8 (_mm256_extracti128_si256 (z, 1), zpick));
+		_mm_storeu_si128 ((__m128i *)(lpz + i), _mm_blendv_epi8 (
+				_mm_loadu_si128 ((__m128i *)(lpz + i)), z16, draw16));
+
+		sfrac = _mm256_add_epi32 (sfrac, sstep);
+		tfrac = _mm256_add_epi32 (tfrac, tstep);
+		light = _mm256_add_epi32 (light, lstep);
+		zi = _mm256_add_epi32 (zi, zistep);
+		whole = _mm256_add_epi32 (whole, _mm256_set1_epi32 (a_ststepxwhole * 8));
+	}
+
+	return i;
+}
+#endif
+
 /*
 ================
 D_PolysetDrawSpans8
@@ -620,6 +715,7 @@ void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 	int		llight;
 	int		lzi;
 	short	*lpz;
+	int		done;
 
 	do
 	{
@@ -646,6 +742,27 @@ void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 			llight = pspanpackage->light;
 			lzi = pspanpackage->zi;
 
+#ifdef D_AVX2
+			if (r_simd.value && r_haveavx2 && lcount >= 8)
+			{
+				done = D_PolysetDrawSpan8_AVX2 (lpdest, lpz, lptex, lsfrac,
+						ltfrac, llight, lzi, lcount);
+
+			// pick the C loop up where the vector one stopped
+				lpdest += done;
+				lpz += done;
+				lptex += done * a_ststepxwhole +
+						((lsfrac + done * a_sstepxfrac) >> 16) +
+						((ltfrac + done * a_tstepxfrac) >> 16) *
+						r_affinetridesc.skinwidth;
+				lsfrac = (lsfrac + done * a_sstepxfrac) & 0xFFFF;
+				ltfrac = (ltfrac + done * a_tstepxfrac) & 0xFFFF;
+				llight += done * r_lstepx;
+				lzi += done * r_zistepx;
+				lcount -= done;
+			}
+			if (lcount)
+#endif
 			do
 			{
 				if ((lzi >> 16) >= *lpz)
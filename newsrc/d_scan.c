@@ -247,6 +247,34 @@ void Turbulent8 (espan_t *pspan)
 }
 
 
+/*
+=============
+D_SpanState
+
+Captures the gradients and texture D_DrawSpans8 and D_DrawZSpans read
+=============
+*/
+void D_SpanState (spanstate_t *st, espan_t *pspan)
+{
+	st->spans = pspan;
+	st->cacheblock = cacheblock;
+	st->cachewidth = cachewidth;
+	st->sdivzstepu = d_sdivzstepu;
+	st->tdivzstepu = d_tdivzstepu;
+	st->zistepu = d_zistepu;
+	st->sdivzstepv = d_sdivzstepv;
+	st->tdivzstepv = d_tdivzstepv;
+	st->zistepv = d_zistepv;
+	st->sdivzorigin = d_sdivzorigin;
+	st->tdivzorigin = d_tdivzorigin;
+	st->ziorigin = d_ziorigin;
+	st->sadjust = sadjust;
+	st->tadjust = tadjust;
+	st->bbextents = bbextents;
+	st->bbextentt = bbextentt;
+}
+
+
 #if	!id386
 
 /*
@@ -255,131 +283,154 @@ D_DrawSpans8
 =============
 */
 void D_DrawSpans8 (espan_t *pspan)
+{
+	spanstate_t		st;
+
+	D_SpanState (&st, pspan);
+	do
+	{
+		D_DrawSpan8 (&st, pspan);
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+
+/*
+=============
+D_DrawSpan8
+
+One span, everything else comes from the state, so spans of a surface
+can be drawn on different threads
+=============
+*/
+void D_DrawSpan8 (spanstate_t *st, espan_t *pspan)
 {
 	int				count, spancount;
 	unsigned char	*pbase, *pdest;
 	fixed16_t		s, t, snext, tnext, sstep, tstep;
 	float			sdivz, tdivz, zi, z, du, dv, spancountminus1;
 	float			sdivz8stepu, tdivz8stepu, zi8stepu;
+	int				cachewidth;
+	fixed16_t		sadjust, tadjust, bbextents, bbextentt;
 
 	sstep = 0;	// keep compiler happy
 	tstep = 0;	// ditto
 
-	pbase = (unsigned char *)cacheblock;
-
-	sdivz8stepu = d_sdivzstepu * 8;
-	tdivz8stepu = d_tdivzstepu * 8;
-	zi8stepu = d_zistepu * 8;
+	pbase = (unsigned char *)st->cacheblock;
+	cachewidth = st->cachewidth;
+	sadjust = st->sadjust;
+	tadjust = st->tadjust;
+	bbextents = st->bbextents;
+	bbextentt = st->bbextentt;
 
-	do
-	{
-		pdest = (unsigned char *)((byte *)d_viewbuffer +
-				(screenwidth * pspan->v) + pspan->u);
-
-		count = pspan->count;
-
-	// calculate the initial s/z, t/z, 1/z, s, and t and clamp
-		du = (float)pspan->u;
-		dv = (float)pspan->v;
+	sdivz8stepu = st->sdivzstepu * 8;
+	tdivz8stepu = st->tdivzstepu * 8;
+	zi8stepu = st->zistepu * 8;
 
-		sdivz = d_sdivzorigin + dv*d_sdivzstepv + du*d_sdivzstepu;
-		tdivz = d_tdivzorigin + dv*d_tdivzstepv + du*d_tdivzstepu;
-		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
-		z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+	pdest = (unsigned char *)((byte *)d_viewbuffer +
+			(screenwidth * pspan->v) + pspan->u);
 
-		s = (int)(sdivz * z) + sadjust;
-		if (s > bbextents)
-			s = bbextents;
-		else if (s < 0)
-			s = 0;
+	count = pspan->count;
 
-		t = (int)(tdivz * z) + tadjust;
-		if (t > bbextentt)
-			t = bbextentt;
-		else if (t < 0)
-			t = 0;
+// calculate the initial s/z, t/z, 1/z, s, and t and clamp
+	du = (float)pspan->u;
+	dv = (float)pspan->v;
 
-		do
-		{
-		// calculate s and t at the far end of the span
-			if (count >= 8)
-				spancount = 8;
-			else
-				spancount = count;
+	sdivz = st->sdivzorigin + dv*st->sdivzstepv + du*st->sdivzstepu;
+	tdivz = st->tdivzorigin + dv*st->tdivzstepv + du*st->tdivzstepu;
+	zi = st->ziorigin + dv*st->zistepv + du*st->zistepu;
+	z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
 
-			count -= spancount;
+	s = (int)(sdivz * z) + sadjust;
+	if (s > bbextents)
+		s = bbextents;
+	else if (s < 0)
+		s = 0;
 
-			if (count)
-			{
-			// calculate s/z, t/z, zi->fixed s and t at far end of span,
-			// calculate s and t steps across span by shifting
-				sdivz += sdivz8stepu;
-				tdivz += tdivz8stepu;
-				zi += zi8stepu;
-				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+	t = (int)(tdivz * z) + tadjust;
+	if (t > bbextentt)
+		t = bbextentt;
+	else if (t < 0)
+		t = 0;
 
-				snext = (int)(sdivz * z) + sadjust;
-				if (snext > bbextents)
-					snext = bbextents;
-				else if (snext < 8)
-					snext = 8;	// prevent round-off error on <0 steps from
-								//  from causing overstepping & running off the
-								//  edge of the texture
+	do
+	{
+	// calculate s and t at the far end of the span
+		if (count >= 8)
+			spancount = 8;
+		else
+			spancount = count;
 
-				tnext = (int)(tdivz * z) + tadjust;
-				if (tnext > bbextentt)
-					tnext = bbextentt;
-				else if (tnext < 8)
-					tnext = 8;	// guard against round-off error on <0 steps
+		count -= spancount;
 
-				sstep = (snext - s) >> 3;
-				tstep = (tnext - t) >> 3;
-			}
-			else
+		if (count)
+		{
+		// calculate s/z, t/z, zi->fixed s and t at far end of span,
+		// calculate s and t steps across span by shifting
+			sdivz += sdivz8stepu;
+			tdivz += tdivz8stepu;
+			zi += zi8stepu;
+			z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+
+			snext = (int)(sdivz * z) + sadjust;
+			if (snext > bbextents)
+				snext = bbextents;
+			else if (snext < 8)
+				snext = 8;	// prevent round-off error on <0 steps from
+							//  from causing overstepping & running off the
+							//  edge of the texture
+
+			tnext = (int)(tdivz * z) + tadjust;
+			if (tnext > bbextentt)
+				tnext = bbextentt;
+			else if (tnext < 8)
+				tnext = 8;	// guard against round-off error on <0 steps
+
+			sstep = (snext - s) >> 3;
+			tstep = (tnext - t) >> 3;
+		}
+		else
+		{
+		// calculate s/z, t/z, zi->fixed s and t at last pixel in span (so
+		// can't step off polygon), clamp, calculate s and t steps across
+		// span by division, biasing steps low so we don't run off the
+		// texture
+			spancountminus1 = (float)(spancount - 1);
+			sdivz += st->sdivzstepu * spancountminus1;
+			tdivz += st->tdivzstepu * spancountminus1;
+			zi += st->zistepu * spancountminus1;
+			z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
+			snext = (int)(sdivz * z) + sadjust;
+			if (snext > bbextents)
+				snext = bbextents;
+			else if (snext < 8)
+				snext = 8;	// prevent round-off error on <0 steps from
+							//  from causing overstepping & running off the
+							//  edge of the texture
+
+			tnext = (int)(tdivz * z) + tadjust;
+			if (tnext > bbextentt)
+				tnext = bbextentt;
+			else if (tnext < 8)
+				tnext = 8;	// guard against round-off error on <0 steps
+
+			if (spancount > 1)
 			{
-			// calculate s/z, t/z, zi->fixed s and t at last pixel in span (so
-			// can't step off polygon), clamp, calculate s and t steps across
-			// span by division, biasing steps low so we don't run off the
-			// texture
-				spancountminus1 = (float)(spancount - 1);
-				sdivz += d_sdivzstepu * spancountminus1;
-				tdivz += d_tdivzstepu * spancountminus1;
-				zi += d_zistepu * spancountminus1;
-				z = (float)0x10000 / zi;	// prescale to 16.16 fixed-point
-				snext = (int)(sdivz * z) + sadjust;
-				if (snext > bbextents)
-					snext = bbextents;
-				else if (snext < 8)
-					snext = 8;	// prevent round-off error on <0 steps from
-								//  from causing overstepping & running off the
-								//  edge of the texture
-
-				tnext = (int)(tdivz * z) + tadjust;
-				if (tnext > bbextentt)
-					tnext = bbextentt;
-				else if (tnext < 8)
-					tnext = 8;	// guard against round-off error on <0 steps
-
-				if (spancount > 1)
-				{
-					sstep = (snext - s) / (spancount - 1);
-					tstep = (tnext - t) / (spancount - 1);
-				}
+				sstep = (snext - s) / (spancount - 1);
+				tstep = (tnext - t) / (spancount - 1);
 			}
+		}
 
-			do
-			{
-				*pdest++ = *(pbase + (s >> 16) + (t >> 16) * cachewidth);
-				s += sstep;
-				t += tstep;
-			} while (--spancount > 0);
-
-			s = snext;
-			t = tnext;
+		do
+		{
+			*pdest++ = *(pbase + (s >> 16) + (t >> 16) * cachewidth);
+			s += sstep;
+			t += tstep;
+		} while (--spancount > 0);
 
-		} while (count > 0);
+		s = snext;
+		t = tnext;
 
-	} while ((pspan = pspan->pnext) != NULL);
+	} while (count > 0);
 }
 
 #endif
@@ -393,6 +444,23 @@ D_DrawZSpans
 =============
 */
 void D_DrawZSpans (espan_t *pspan)
+{
+	spanstate_t		st;
+
+	D_SpanState (&st, pspan);
+	do
+	{
+		D_DrawZSpan (&st, pspan);
+	} while ((pspan = pspan->pnext) != NULL);
+}
+
+
+/*
+=============
+D_DrawZSpan
+=============
+*/
+void D_DrawZSpan (spanstate_t *st, espan_t *pspan)
 {
 	int				count, doublecount, izistep;
 	int				izi;
@@ -403,46 +471,42 @@ void D_DrawZSpans (espan_t *pspan)
 
 // FIXME: check for clamping/range problems
 // we count on FP exceptions being turned off to avoid range problems
-	izistep = (int)(d_zistepu * 0x8000 * 0x10000);
+	izistep = (int)(st->zistepu * 0x8000 * 0x10000);
 
-	do
-	{
-		pdest = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
+	pdest = d_pzbuffer + (d_zwidth * pspan->v) + pspan->u;
 
-		count = pspan->count;
+	count = pspan->count;
 
-	// calculate the initial 1/z
-		du = (float)pspan->u;
-		dv = (float)pspan->v;
+// calculate the initial 1/z
+	du = (float)pspan->u;
+	dv = (float)pspan->v;
 
-		zi = d_ziorigin + dv*d_zistepv + du*d_zistepu;
-	// we count on FP exceptions being turned off to avoid range problems
-		izi = (int)(zi * 0x8000 * 0x10000);
+	zi = st->ziorigin + dv*st->zistepv + du*st->zistepu;
+// we count on FP exceptions being turned off to avoid range problems
+	izi = (int)(zi * 0x8000 * 0x10000);
 
-		if ((long)pdest & 0x02)
-		{
-			*pdest++ = (short)(izi >> 16);
-			izi += izistep;
-			count--;
-		}
+	if ((long)pdest & 0x02)
+	{
+		*pdest++ = (short)(izi >> 16);
+		izi += izistep;
+		count--;
+	}
 
-		if ((doublecount = count >> 1) > 0)
+	if ((doublecount = count >> 1) > 0)
+	{
+		do
 		{
-			do
-			{
-				ltemp = izi >> 16;
-				izi += izistep;
-				ltemp |= izi & 0xFFFF0000;
-				izi += izistep;
-				*(int *)pdest = ltemp;
-				pdest += 2;
-			} while (--doublecount > 0);
-		}
-
-		if (count & 1)
-			*pdest = (short)(izi >> 16);
+			ltemp = izi >> 16;
+			izi += izistep;
+			ltemp |= izi & 0xFFFF0000;
+			izi += izistep;
+			*(int *)pdest = ltemp;
+			pdest += 2;
+		} while (--doublecount > 0);
+	}
 
-	} while ((pspan = pspan->pnext) != NULL);
+	if (count & 1)
+		*pdest = (short)(izi >> 16);
 }
 
 #endif
@@ -31,7 +31,23 @@ surfcache_t                     *sc_rover, *sc_base;
 
 #define GUARDSIZE       4
 
+static void D_SurfBuildCacheWrite (void *start, int size);
 
+
+dcachestats_t	d_cachestats;
+
+int				d_surfcachewanted;	// set by D_CacheFrame, cleared once the video driver regrows
+static int		d_thrashframes;
+
+/*
+================
+D_SurfaceCacheForRes
+
+-surfcachesize <kb> is used as is.  Otherwise the size comes from the
+resolution, or from what D_CacheFrame has asked for since the last
+regrow if that is more.
+================
+*/
 int     D_SurfaceCacheForRes (int width, int height)
 {
 	int             size, pix;
@@ -48,10 +64,52 @@ int     D_SurfaceCacheForRes (int width, int height)
 	if (pix > 64000)
 		size += (pix-64000)*3;
 
+	if (d_surfcachewanted > size)
+		size = d_surfcachewanted;
 
 	return size;
 }
 
+/*
+================
+D_CacheFrame
+
+Called at the start of every frame with the last frame's statistics
+still in d_cachestats.  When the surfaces drawn in a frame keep not
+fitting, the cache is asked to grow to twice that working set, and the
+video driver reallocates it after the next present.
+================
+*/
+void D_CacheFrame (void)
+{
+	int		wanted, limit;
+
+	if (d_cacheadapt.value && !COM_CheckParm ("-surfcachesize") && sc_size)
+	{
+		if (d_cachestats.reused > 0 || d_cachestats.workingset > sc_size / 4 * 3)
+			d_thrashframes++;
+		else
+			d_thrashframes = 0;
+
+		if (d_thrashframes >= CACHE_THRASHFRAMES)
+		{
+			d_thrashframes = 0;
+
+			wanted = (d_cachestats.workingset * 2 + 0xffff) & ~0xffff;
+
+		// don't take more than half of what the hunk has left
+			limit = sc_size + (Hunk_CacheLimit () - Hunk_LowMark ()) / 2;
+			if (wanted > limit)
+				wanted = limit;
+
+			if (wanted > sc_size)
+				d_surfcachewanted = wanted;
+		}
+	}
+
+	memset (&d_cachestats, 0, sizeof(d_cachestats));
+}
+
 void D_CheckCacheGuard (void)
 {
 	byte    *s;
@@ -122,6 +180,20 @@ void D_FlushCaches (void)
 	sc_base->size = sc_size;
 }
 
+/*
+=================
+D_EvictBlock
+=================
+*/
+static void D_EvictBlock (surfcache_t *block)
+{
+	*block->owner = NULL;
+
+	d_cachestats.evictions++;
+	if (block->usedframe == r_framecount || block->prebuilt)
+		d_cachestats.reused++;
+}
+
 /*
 =================
 D_SCAlloc
@@ -155,10 +227,14 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		sc_rover = sc_base;
 	}
 
+	d_cachestats.allocs++;
+	if (wrapped_this_time)
+		d_cachestats.wraps++;
+
 // colect and free surfcache_t blocks until the rover block is large enough
 	new = sc_rover;
 	if (sc_rover->owner)
-		*sc_rover->owner = NULL;
+		D_EvictBlock (sc_rover);
 
 	while (new->size < size)
 	{
@@ -167,12 +243,17 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		if (!sc_rover)
 			Sys_Error ("D_SCAlloc: hit the end of memory");
 		if (sc_rover->owner)
-			*sc_rover->owner = NULL;
+			D_EvictBlock (sc_rover);
 
 		new->size += sc_rover->size;
 		new->next = sc_rover->next;
 	}
 
+// queued spans may still be reading from the blocks about to be reused,
+// and queued builds writing to them
+	D_SpanCacheWrite (new, new->size);
+	D_SurfBuildCacheWrite (new, new->size);
+
 // create a fragment out of any leftovers
 	if (new->size - size > 256)
 	{
@@ -193,6 +274,8 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		new->height = (size - sizeof(*new) + sizeof(new->data)) / width;
 
 	new->owner = NULL;              // should be set properly after return
+	new->prebuilt = false;
+	new->usedframe = -1;
 
 	if (d_roverwrapped)
 	{
@@ -256,12 +339,85 @@ int D_log2 (int num)
 
 //=============================================================================
 
+/*
+Surfaces that need building are found for a whole D_DrawSurfaces pass
+up front (D_PrebuildSurface), their blocks allocated and headers filled
+in on the main thread, and the lighting and texture blending for all of
+them done at once on the job workers.  D_CacheSurface then finds them
+ready.  Everything R_DrawSurface works in is per thread.
+*/
+
+#define	MAX_SURFBUILDS	256
+
+static drawsurf_t	d_surfbuilds[MAX_SURFBUILDS];
+static int			d_numsurfbuilds;
+
+int		d_cachehits, d_cachenew, d_cacherelit, d_cacheprebuilt;
+
 /*
 ================
-D_CacheSurface
+D_BuildSurfaceJob
 ================
 */
-surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
+static void D_BuildSurfaceJob (void *data, int index)
+{
+	drawsurf_t	saved;
+
+// the main thread takes jobs too, and may be in the middle of setting up
+// a surface of its own
+	saved = r_drawsurf;
+	r_drawsurf = d_surfbuilds[index];
+	R_DrawSurface ();
+	r_drawsurf = saved;
+}
+
+/*
+================
+D_FlushSurfaceBuilds
+================
+*/
+void D_FlushSurfaceBuilds (void)
+{
+	if (!d_numsurfbuilds)
+		return;
+
+	Job_Parallel (D_BuildSurfaceJob, NULL, d_numsurfbuilds);
+	d_numsurfbuilds = 0;
+}
+
+/*
+================
+D_SurfBuildCacheWrite
+
+A block queued for building is about to be reused, build it first so
+two surfaces never write the same memory
+================
+*/
+static void D_SurfBuildCacheWrite (void *start, int size)
+{
+	int		i;
+	byte	*dat;
+
+	for (i=0 ; i<d_numsurfbuilds ; i++)
+	{
+		dat = (byte *)d_surfbuilds[i].surfdat;
+		if (dat >= (byte *)start && dat < (byte *)start + size)
+		{
+			D_FlushSurfaceBuilds ();
+			return;
+		}
+	}
+}
+
+/*
+================
+D_SetupSurface
+
+Sets up r_drawsurf for the surface and returns its cache block, or NULL
+if the block already holds the right image
+================
+*/
+static surfcache_t *D_SetupSurface (msurface_t *surface, int miplevel)
 {
 	surfcache_t     *cache;
 
@@ -285,7 +441,7 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 			&& cache->lightadj[1] == r_drawsurf.lightadj[1]
 			&& cache->lightadj[2] == r_drawsurf.lightadj[2]
 			&& cache->lightadj[3] == r_drawsurf.lightadj[3] )
-		return cache;
+		return NULL;
 
 //
 // determine shape of surface
@@ -306,7 +462,13 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 		surface->cachespots[miplevel] = cache;
 		cache->owner = &surface->cachespots[miplevel];
 		cache->mipscale = surfscale;
+		d_cachenew++;
 	}
+	else
+		d_cacherelit++;
+
+	d_cachestats.builds++;
+	d_cachestats.bytesbuilt += r_drawsurf.surfwidth * r_drawsurf.surfheight;
 
 	if (surface->dlightframe == r_framecount)
 		cache->dlight = 1;
@@ -321,13 +483,74 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 	cache->lightadj[2] = r_drawsurf.lightadj[2];
 	cache->lightadj[3] = r_drawsurf.lightadj[3];
 
-//
-// draw and light the surface texture
-//
 	r_drawsurf.surf = surface;
 
+	D_SpanCacheWrite (cache, cache->size);
+
+	return cache;
+}
+
+/*
+================
+D_PrebuildSurface
+
+Queues the surface for D_FlushSurfaceBuilds if D_CacheSurface would have
+to build it
+================
+*/
+void D_PrebuildSurface (msurface_t *surface, int miplevel)
+{
+	surfcache_t     *cache;
+
+	cache = surface->cachespots[miplevel];
+	if (cache && cache->prebuilt)
+		return;		// already queued this pass
+
+	cache = D_SetupSurface (surface, miplevel);
+	if (!cache)
+		return;
+
+	if (d_numsurfbuilds == MAX_SURFBUILDS)
+		D_FlushSurfaceBuilds ();
+
+	d_surfbuilds[d_numsurfbuilds++] = r_drawsurf;
+	cache->prebuilt = true;
+
 	c_surf++;
-	R_DrawSurface ();
+	d_cacheprebuilt++;
+}
+
+/*
+================
+D_CacheSurface
+================
+*/
+surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
+{
+	surfcache_t     *cache;
+
+	cache = surface->cachespots[miplevel];
+	if (cache && cache->prebuilt)
+		cache->prebuilt = false;
+	else if (D_SetupSurface (surface, miplevel))
+	{
+	//
+	// draw and light the surface texture
+	//
+		c_surf++;
+		R_DrawSurface ();
+	}
+	else
+		d_cachehits++;
+
+	cache = surface->cachespots[miplevel];
+
+// count each block once toward the frame's working set
+	if (cache->usedframe != r_framecount)
+	{
+		cache->usedframe = r_framecount;
+		d_cachestats.workingset += cache->size;
+	}
 
-	return surface->cachespots[miplevel];
+	return cache;
 }
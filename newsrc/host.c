@@ -210,6 +210,7 @@ void Host_FindMaxClients(void) {
 	}
 
 	svs.clients = Hunk_AllocName(svs.maxclientslimit*sizeof(client_t), "clients");
+	svs.entsched = Hunk_AllocName(svs.maxclientslimit*MAX_EDICTS*sizeof(entsched_t), "entsched");
 
 	if (svs.maxclients > 1) {
 		Cvar_SetValue("deathmatch", 1.0);
@@ -357,6 +358,8 @@ void SV_DropClient(qboolean crash) {
 	int i;
 	client_t *client;
 
+	net_serverstatechanged = true;
+
 	if (!crash) {
 		// send any final messages (don't check for errors)
 		if (NET_CanSendMessage(host_client->netconnection)) {
@@ -493,6 +496,7 @@ void Host_ClearMemory(void) {
 	Con_DPrintf("Clearing memory\n");
 	D_FlushCaches();
 	Mod_ClearAll();
+	COM_FlushFileCache();
 
 	if (host_hunklevel) {
 		Hunk_FreeToLowMark(host_hunklevel);
@@ -675,6 +679,8 @@ void _Host_Frame(double elapsed_time) {
 		return;
 	}
 
+	Timing_StartFrame();
+
 	// get new key events
 	Sys_SendKeyEvents();
 
@@ -701,7 +707,9 @@ void _Host_Frame(double elapsed_time) {
 	Host_GetConsoleCommands();
 
 	if (sv.active) {
+		Timing_Begin(TIME_SERVER);
 		Host_ServerFrame();
+		Timing_End(TIME_SERVER);
 	}
 
 	//-------------------
@@ -720,7 +728,9 @@ void _Host_Frame(double elapsed_time) {
 
 	// fetch results from server
 	if (cls.state == ca_connected) {
+		Timing_Begin(TIME_CLIENT);
 		CL_ReadFromServer();
+		Timing_End(TIME_CLIENT);
 	}
 
 	// update video
@@ -728,19 +738,23 @@ void _Host_Frame(double elapsed_time) {
 		time1 = Sys_FloatTime();
 	}
 
+	Timing_Begin(TIME_SCREEN);
 	SCR_UpdateScreen();
+	Timing_End(TIME_SCREEN);
 
 	if (host_speeds.value) {
 		time2 = Sys_FloatTime ();
 	}
 
 	// update audio
+	Timing_Begin(TIME_SOUND);
 	if (cls.signon == SIGNONS) {
 		S_Update(r_origin, vpn, vright, vup);
 		CL_DecayLights();
 	} else {
 		S_Update(vec3_origin, vec3_origin, vec3_origin, vec3_origin);
 	}
+	Timing_End(TIME_SOUND);
 
 	if (host_speeds.value) {
 		pass1 = (time1 - time3) * 1000;
@@ -756,6 +770,12 @@ void _Host_Frame(double elapsed_time) {
 				pass3);
 	}
 
+	Host_SaveFrame();
+	Cache_Frame();
+	Memory_Frame();
+
+	Timing_EndFrame();
+
 	host_framecount++;
 }
 
@@ -894,13 +914,15 @@ void Host_Init(quakeparms_t *parms) {
 	com_argc = parms->argc;
 	com_argv = parms->argv;
 
-	Memory_Init(parms->membase, parms->memsize);
+	Memory_Init(parms->membase, parms->memsize, parms->memreserve);
 	Cbuf_Init();
 	Cmd_Init();
 	V_Init();
 	Chase_Init();
 	Host_InitVCR(parms);
 	COM_Init(); // parms->basedir);
+	Jobs_Init();
+	Timing_Init();
 	Host_InitLocal();
 	W_LoadWadFile("gfx.wad");
 	Key_Init();
@@ -913,6 +935,9 @@ void Host_Init(quakeparms_t *parms) {
 
 	Con_Printf("Exe: "__TIME__" "__DATE__"\n");
 	Con_Printf("%4.1f megabyte heap\n",parms->memsize/ (1024*1024.0));
+	if (parms->memreserve) {
+		Con_Printf("%4.1f megabytes reserved for the heap to grow into\n", parms->memreserve / (1024*1024.0));
+	}
 
 	R_InitTextures();		// needed even for dedicated servers
 
@@ -989,10 +1014,13 @@ void Host_Shutdown(void) {
 	scr_disabled_for_loading = true;
 
 	Host_WriteConfiguration();
+	Host_FinishSave();
+	Timing_Stop();
 
 	NET_Shutdown();
 	S_Shutdown();
 	IN_Shutdown();
+	Jobs_Shutdown();
 
 	if (cls.state != ca_dedicated) {
 		VID_Shutdown();
@@ -457,6 +457,147 @@ void Host_SavegameComment (char *text)
 }
 
 
+/*
+==============================================================================
+
+ASYNC SAVEGAMES
+
+Host_Savegame_f only takes a copy of the game state; turning it into text
+and writing the file happens on a worker thread.  The file is written
+under a temporary name and renamed over the old save when it is complete,
+so a crash in the middle never leaves a truncated savegame behind.
+==============================================================================
+*/
+
+cvar_t	savegame_async = {"savegame_async", "1"};
+
+typedef struct
+{
+	job_t			job;
+
+	char			name[256];
+	char			comment[SAVEGAME_COMMENT_LENGTH+1];
+	float			spawn_parms[NUM_SPAWN_PARMS];
+	int				skill;
+	char			mapname[64];
+	double			time;
+	char			lightstyles[MAX_LIGHTSTYLES][MAX_STYLESTRING];
+	edsnapshot_t	*edicts;
+
+	double			snaptime;		// main thread, taking the snapshot
+	double			writetime;		// writer, formatting and writing
+	qboolean		failed;
+} savegame_t;
+
+static savegame_t	*host_save;		// being written, or finished but not reported
+
+/*
+===============
+Host_WriteSave
+
+Runs on a worker thread
+===============
+*/
+static void Host_WriteSave (void *data)
+{
+	savegame_t	*save;
+	char		tempname[260];
+	FILE		*f;
+	int			i;
+	double		start;
+
+	save = data;
+	start = Sys_FloatTime ();
+
+	sprintf (tempname, "%s.tmp", save->name);
+	f = fopen (tempname, "w");
+	if (!f)
+	{
+		save->failed = true;
+		return;
+	}
+
+	fprintf (f, "%i\n", SAVEGAME_VERSION);
+	fprintf (f, "%s\n", save->comment);
+	for (i=0 ; i<NUM_SPAWN_PARMS ; i++)
+		fprintf (f, "%f\n", save->spawn_parms[i]);
+	fprintf (f, "%d\n", save->skill);
+	fprintf (f, "%s\n", save->mapname);
+	fprintf (f, "%f\n", save->time);
+
+// write the light styles
+
+	for (i=0 ; i<MAX_LIGHTSTYLES ; i++)
+		fprintf (f, "%s\n", save->lightstyles[i]);
+
+	ED_WriteSnapshot (f, save->edicts);
+
+	if (ferror (f))
+		save->failed = true;
+	if (fclose (f))
+		save->failed = true;
+
+	if (save->failed)
+		remove (tempname);
+	else if (rename (tempname, save->name))
+		save->failed = true;
+
+	save->writetime = Sys_FloatTime () - start;
+}
+
+/*
+===============
+Host_ReportSave
+===============
+*/
+static void Host_ReportSave (void)
+{
+	savegame_t	*save;
+
+	save = host_save;
+	host_save = NULL;
+
+	if (save->failed)
+		Con_Printf ("ERROR: couldn't write %s.\n", save->name);
+	else
+		Con_Printf ("done.\n");
+	Con_DPrintf ("save: %.2f ms on the main thread, %.2f ms writing\n",
+		save->snaptime * 1000, save->writetime * 1000);
+
+	ED_FreeSnapshot (save->edicts);
+	free (save);
+}
+
+/*
+===============
+Host_SaveFrame
+
+Called every frame to report a background save once it is done
+===============
+*/
+void Host_SaveFrame (void)
+{
+	if (host_save && Job_Done (&host_save->job))
+		Host_ReportSave ();
+}
+
+/*
+===============
+Host_FinishSave
+
+Blocks until any background save is on disk, before loading a game,
+starting another save, or quitting
+===============
+*/
+void Host_FinishSave (void)
+{
+	if (!host_save)
+		return;
+
+	Job_Wait (&host_save->job);
+	Host_ReportSave ();
+}
+
 /*
 ===============
 Host_Savegame_f
@@ -464,10 +605,9 @@ Host_Savegame_f
 */
 void Host_Savegame_f (void)
 {
-	char	name[256];
-	FILE	*f;
-	int		i;
-	char	comment[SAVEGAME_COMMENT_LENGTH+1];
+	savegame_t	*save;
+	int			i;
+	double		start;
 
 	if (cmd_source != src_command)
 		return;
@@ -511,45 +651,46 @@ void Host_Savegame_f (void)
 		}
 	}
 
-	sprintf (name, "%s/%s", com_gamedir, Cmd_Argv(1));
-	COM_DefaultExtension (name, ".sav");
+	Host_FinishSave ();
 
-	Con_Printf ("Saving game to %s...\n", name);
-	f = fopen (name, "w");
-	if (!f)
-	{
-		Con_Printf ("ERROR: couldn't open.\n");
-		return;
-	}
+	save = calloc (1, sizeof(*save));
+	if (!save)
+		Sys_Error ("Host_Savegame_f: out of memory");
 
-	fprintf (f, "%i\n", SAVEGAME_VERSION);
-	Host_SavegameComment (comment);
-	fprintf (f, "%s\n", comment);
-	for (i=0 ; i<NUM_SPAWN_PARMS ; i++)
-		fprintf (f, "%f\n", svs.clients->spawn_parms[i]);
-	fprintf (f, "%d\n", current_skill);
-	fprintf (f, "%s\n", sv.name);
-	fprintf (f, "%f\n",sv.time);
+	sprintf (save->name, "%s/%s", com_gamedir, Cmd_Argv(1));
+	COM_DefaultExtension (save->name, ".sav");
 
-// write the light styles
+	Con_Printf ("Saving game to %s...\n", save->name);
 
+	start = Sys_FloatTime ();
+
+	Host_SavegameComment (save->comment);
+	for (i=0 ; i<NUM_SPAWN_PARMS ; i++)
+		save->spawn_parms[i] = svs.clients->spawn_parms[i];
+	save->skill = current_skill;
+	strcpy (save->mapname, sv.name);
+	save->time = sv.time;
 	for (i=0 ; i<MAX_LIGHTSTYLES ; i++)
 	{
 		if (sv.lightstyles[i])
-			fprintf (f, "%s\n", sv.lightstyles[i]);
+			Q_strncpy (save->lightstyles[i], sv.lightstyles[i], MAX_STYLESTRING-1);
 		else
-			fprintf (f,"m\n");
+			strcpy (save->lightstyles[i], "m");
 	}
+	save->edicts = ED_Snapshot ();
 
-
-	ED_WriteGlobals (f);
-	for (i=0 ; i<sv.num_edicts ; i++)
+	if (savegame_async.value)
 	{
-		ED_Write (f, EDICT_NUM(i));
-		fflush (f);
+		Job_SubmitBackground (&save->job, Host_WriteSave, save);
+		save->snaptime = Sys_FloatTime () - start;
+		host_save = save;
+		return;
 	}
-	fclose (f);
-	Con_Printf ("done.\n");
+
+	Host_WriteSave (save);
+	save->snaptime = Sys_FloatTime () - start;
+	host_save = save;
+	Host_ReportSave ();
 }
 
 
@@ -568,6 +709,9 @@ void Host_Loadgame_f(void) {
 		return;
 	}
 
+	// the save may still be on its way to disk
+	Host_FinishSave();
+
 	cls.demonum = -1;  // stop demo loop in case this fails
 
 	char name[MAX_OSPATH];
@@ -1922,6 +2066,7 @@ void Host_InitCommands (void)
 	Cmd_AddCommand ("ping", Host_Ping_f);
 	Cmd_AddCommand ("load", Host_Loadgame_f);
 	Cmd_AddCommand ("save", Host_Savegame_f);
+	Cvar_RegisterVariable (&savegame_async);
 	Cmd_AddCommand ("give", Host_Give_f);
 
 	Cmd_AddCommand ("startdemos", Host_Startdemos_f);
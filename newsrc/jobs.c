@@ -0,0 +1,351 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// jobs.c -- worker thread pool
+
+#include "quakedef.h"
+#include <pthread.h>
+
+/*
+Two fifo queues behind one mutex.  Jobs here are few and coarse (a file
+read, a band of the screen), so the lock is never the bottleneck.  A
+thread waiting on a job takes queued work itself rather than sleeping,
+which keeps the main thread busy and lets jobs wait on other jobs.
+
+Background jobs (a savegame write) can take much longer than a frame, so
+they go on their own queue that only the workers take from; a thread
+waiting for a span band never ends up writing a file.
+*/
+
+static pthread_t		job_threads[MAX_WORKERS];
+static int				job_numworkers;
+static qboolean			job_quit;
+
+static pthread_mutex_t	job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	job_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	job_finished = PTHREAD_COND_INITIALIZER;
+
+static job_t			*job_head, *job_tail;
+static job_t			*job_bghead, *job_bgtail;	// only workers run these
+
+static struct
+{
+	int		submitted;
+	int		background;
+	int		helped;			// run by a thread that was waiting on another job
+	int		inline_run;		// run by Job_Submit with no workers
+} job_stats;
+
+/*
+================
+Job_Pop
+
+Called with job_lock held
+================
+*/
+static job_t *Job_Pop (job_t **head, job_t **tail)
+{
+	job_t	*job;
+
+	job = *head;
+	if (job)
+	{
+		*head = job->next;
+		if (!*head)
+			*tail = NULL;
+	}
+	return job;
+}
+
+/*
+================
+Job_Push
+
+Called with job_lock held
+================
+*/
+static void Job_Push (job_t **head, job_t **tail, job_t *job)
+{
+	if (*tail)
+		(*tail)->next = job;
+	else
+		*head = job;
+	*tail = job;
+	pthread_cond_signal (&job_queued);
+}
+
+/*
+================
+Job_Run
+
+Called with job_lock held, returns with it held
+================
+*/
+static void Job_Run (job_t *job)
+{
+	pthread_mutex_unlock (&job_lock);
+	job->func (job->data);
+	pthread_mutex_lock (&job_lock);
+
+	job->done = true;
+	pthread_cond_broadcast (&job_finished);
+}
+
+/*
+================
+Job_Worker
+================
+*/
+static void *Job_Worker (void *arg)
+{
+	job_t	*job;
+
+	pthread_mutex_lock (&job_lock);
+	while (!job_quit)
+	{
+		job = Job_Pop (&job_head, &job_tail);
+		if (!job)
+			job = Job_Pop (&job_bghead, &job_bgtail);
+		if (!job)
+		{
+			pthread_cond_wait (&job_queued, &job_lock);
+			continue;
+		}
+		Job_Run (job);
+	}
+	pthread_mutex_unlock (&job_lock);
+
+	return NULL;
+}
+
+/*
+================
+Job_Queue
+================
+*/
+static void Job_Queue (job_t *job, void (*func) (void *data), void *data, qboolean background)
+{
+	job->func = func;
+	job->data = data;
+	job->done = false;
+	job->next = NULL;
+
+	if (!job_numworkers)
+	{
+		job_stats.inline_run++;
+		func (data);
+		job->done = true;
+		return;
+	}
+
+	pthread_mutex_lock (&job_lock);
+	job_stats.submitted++;
+	if (background)
+	{
+		job_stats.background++;
+		Job_Push (&job_bghead, &job_bgtail, job);
+	}
+	else
+		Job_Push (&job_head, &job_tail, job);
+	pthread_mutex_unlock (&job_lock);
+}
+
+/*
+================
+Job_Submit
+================
+*/
+void Job_Submit (job_t *job, void (*func) (void *data), void *data)
+{
+	Job_Queue (job, func, data, false);
+}
+
+/*
+================
+Job_SubmitBackground
+================
+*/
+void Job_SubmitBackground (job_t *job, void (*func) (void *data), void *data)
+{
+	Job_Queue (job, func, data, true);
+}
+
+/*
+================
+Job_Wait
+================
+*/
+void Job_Wait (job_t *job)
+{
+	job_t	*other;
+
+	pthread_mutex_lock (&job_lock);
+	while (!job->done)
+	{
+		other = Job_Pop (&job_head, &job_tail);
+		if (other)
+		{
+			job_stats.helped++;
+			Job_Run (other);
+		}
+		else
+			pthread_cond_wait (&job_finished, &job_lock);
+	}
+	pthread_mutex_unlock (&job_lock);
+}
+
+/*
+================
+Job_Done
+================
+*/
+qboolean Job_Done (job_t *job)
+{
+	qboolean	done;
+
+	pthread_mutex_lock (&job_lock);
+	done = job->done;
+	pthread_mutex_unlock (&job_lock);
+
+	return done;
+}
+
+/*
+================
+Job_Parallel
+================
+*/
+typedef struct
+{
+	void	(*func) (void *data, int index);
+	void	*data;
+	int		count;
+	int		next;
+} parallel_t;
+
+static void Job_ParallelRun (void *data)
+{
+	parallel_t	*p;
+	int			i;
+
+	p = data;
+	while ((i = __sync_fetch_and_add (&p->next, 1)) < p->count)
+		p->func (p->data, i);
+}
+
+void Job_Parallel (void (*func) (void *data, int index), void *data, int count)
+{
+	parallel_t	p;
+	job_t		helpers[MAX_WORKERS];
+	int			i, numhelpers;
+
+	p.func = func;
+	p.data = data;
+	p.count = count;
+	p.next = 0;
+
+	numhelpers = job_numworkers;
+	if (numhelpers > count - 1)
+		numhelpers = count - 1;
+
+	for (i=0 ; i<numhelpers ; i++)
+		Job_Submit (&helpers[i], Job_ParallelRun, &p);
+
+	Job_ParallelRun (&p);
+
+	for (i=0 ; i<numhelpers ; i++)
+		Job_Wait (&helpers[i]);
+}
+
+/*
+================
+Jobs_Workers
+================
+*/
+int Jobs_Workers (void)
+{
+	return job_numworkers;
+}
+
+/*
+================
+Jobs_Stats_f
+================
+*/
+static void Jobs_Stats_f (void)
+{
+	Con_Printf ("%i worker threads\n", job_numworkers);
+	Con_Printf ("%i jobs queued, %i in the background, %i run by waiting threads, %i run inline\n",
+		job_stats.submitted, job_stats.background, job_stats.helped, job_stats.inline_run);
+}
+
+/*
+================
+Jobs_Init
+
+-threads <n> sets the number of workers, the default is one less than
+the processor count since the main thread works too
+================
+*/
+void Jobs_Init (void)
+{
+	int		i, count;
+
+	i = COM_CheckParm ("-threads");
+	if (i && i < com_argc-1)
+		count = Q_atoi (com_argv[i+1]);
+	else
+		count = Sys_CPUCount () - 1;
+
+	if (count < 0)
+		count = 0;
+	if (count > MAX_WORKERS)
+		count = MAX_WORKERS;
+
+	for (i=0 ; i<count ; i++)
+	{
+		if (pthread_create (&job_threads[i], NULL, Job_Worker, NULL))
+		{
+			Con_Printf ("Jobs_Init: only started %i of %i threads\n", i, count);
+			break;
+		}
+	}
+	job_numworkers = i;
+
+	Cmd_AddCommand ("jobs", Jobs_Stats_f);
+}
+
+/*
+================
+Jobs_Shutdown
+================
+*/
+void Jobs_Shutdown (void)
+{
+	int		i;
+
+	pthread_mutex_lock (&job_lock);
+	job_quit = true;
+	pthread_cond_broadcast (&job_queued);
+	pthread_mutex_unlock (&job_lock);
+
+	for (i=0 ; i<job_numworkers ; i++)
+		pthread_join (job_threads[i], NULL);
+	job_numworkers = 0;
+}
@@ -0,0 +1,64 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// jobs.h -- worker thread pool
+
+/*
+Job functions run on worker threads, so they may only touch memory the
+submitter handed them.  No Con_Printf, no hunk, zone or cache calls, no
+cvar changes; report back through the job's own data instead.
+
+With no workers (-threads 0, or a single cpu) Job_Submit runs the job
+before returning, so callers never need a separate single threaded path.
+*/
+
+#define	MAX_WORKERS		16
+
+// for the few globals a job function works in, each thread gets its own
+#define	THREADLOCAL		__thread
+
+typedef struct job_s
+{
+	void			(*func) (void *data);
+	void			*data;
+	volatile int	done;
+	struct job_s	*next;
+} job_t;
+
+void Jobs_Init (void);
+void Jobs_Shutdown (void);
+int Jobs_Workers (void);		// worker threads, not counting the main thread
+
+// the job_t must stay valid until Job_Wait returns for it
+void Job_Submit (job_t *job, void (*func) (void *data), void *data);
+
+// for jobs that may run longer than a frame; only the workers run them,
+// never a thread that is waiting in Job_Wait
+void Job_SubmitBackground (job_t *job, void (*func) (void *data), void *data);
+
+// runs queued jobs (not background ones) on the calling thread until this
+// one is finished
+void Job_Wait (job_t *job);
+
+// true once the job has run, never blocks
+qboolean Job_Done (job_t *job);
+
+// calls func (data, 0) through func (data, count-1) spread over the
+// workers and the calling thread, and returns when all of them are done
+void Job_Parallel (void (*func) (void *data, int index), void *data, int count);
@@ -0,0 +1,232 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// lz.c -- lzss compression for network messages
+
+#include "quakedef.h"
+
+/*
+The output is a series of groups of up to eight items, each group led by a
+control byte.  Bit n of the control byte describes item n, low bit first:
+
+0	literal byte
+1	match, two bytes: low 8 bits of (offset-1), then the high 4 bits of
+	(offset-1) in the top nibble and (length-3) in the bottom nibble
+
+Both sides start with lz_dictionary already in the window, so the first
+precache names and baselines of a signon can refer back into it.
+*/
+
+#define	LZ_WINDOW		4096
+#define	LZ_MINMATCH		3
+#define	LZ_MAXMATCH		(15 + LZ_MINMATCH)
+#define	LZ_HASHSIZE		4096
+#define	LZ_MAXCHAIN		32
+
+// strings that turn up in nearly every serverinfo and baseline block
+static char lz_dictionary[] =
+	"progs/h_player.mdl\0progs/gib1.mdl\0progs/gib2.mdl\0progs/gib3.mdl\0"
+	"progs/backpack.mdl\0progs/armor.mdl\0progs/missile.mdl\0progs/grenade.mdl\0"
+	"progs/spike.mdl\0progs/s_spike.mdl\0progs/bolt.mdl\0progs/bolt2.mdl\0"
+	"progs/v_shot.mdl\0progs/v_shot2.mdl\0progs/v_nail.mdl\0progs/v_nail2.mdl\0"
+	"progs/v_rock.mdl\0progs/v_rock2.mdl\0progs/v_light.mdl\0progs/v_axe.mdl\0"
+	"progs/s_explod.spr\0progs/s_bubble.spr\0"
+	"maps/b_batt0.bsp\0maps/b_nail0.bsp\0maps/b_shell0.bsp\0maps/b_rock0.bsp\0"
+	"maps/b_bh25.bsp\0maps/b_bh100.bsp\0"
+	"weapons/r_exp3.wav\0weapons/rocket1i.wav\0weapons/sgun1.wav\0"
+	"weapons/guncock.wav\0weapons/ric1.wav\0weapons/ric2.wav\0weapons/ric3.wav\0"
+	"weapons/spike2.wav\0weapons/tink1.wav\0weapons/grenade.wav\0weapons/bounce.wav\0"
+	"weapons/shotgn2.wav\0weapons/lhit.wav\0weapons/lstart.wav\0weapons/pkup.wav\0"
+	"items/itembk2.wav\0items/armor1.wav\0items/health1.wav\0items/r_item1.wav\0"
+	"items/r_item2.wav\0items/damage.wav\0items/damage2.wav\0items/damage3.wav\0"
+	"player/plyrjmp8.wav\0player/land.wav\0player/land2.wav\0player/drown1.wav\0"
+	"player/drown2.wav\0player/gasp1.wav\0player/gasp2.wav\0player/h2odeath.wav\0"
+	"player/pain1.wav\0player/pain2.wav\0player/pain3.wav\0player/pain4.wav\0"
+	"player/pain5.wav\0player/pain6.wav\0player/death1.wav\0player/death2.wav\0"
+	"player/death3.wav\0player/death4.wav\0player/death5.wav\0player/udeath.wav\0"
+	"player/gib.wav\0player/tornoff2.wav\0player/inh2o.wav\0player/slimbrn2.wav\0"
+	"player/lburn1.wav\0player/lburn2.wav\0player/teledth1.wav\0"
+	"misc/h2ohit1.wav\0misc/water1.wav\0misc/water2.wav\0misc/outwater.wav\0"
+	"misc/talk.wav\0misc/r_tele1.wav\0misc/r_tele2.wav\0misc/r_tele3.wav\0"
+	"misc/r_tele4.wav\0misc/r_tele5.wav\0misc/power.wav\0misc/null.wav\0"
+	"ambience/windfly.wav\0ambience/fire1.wav\0ambience/drip1.wav\0"
+	"demon/dland2.wav\0doors/drclos4.wav\0doors/medtry.wav\0doors/meduse.wav\0"
+	"plats/plat1.wav\0plats/plat2.wav\0buttons/switch21.wav\0buttons/airbut1.wav\0"
+	"progs/player.mdl\0*1\0*2\0*3\0*4\0*5\0*6\0*7\0*8\0*9\0";
+
+#define	LZ_DICTSIZE		((int)sizeof(lz_dictionary) - 1)
+
+static byte		lz_work[LZ_DICTSIZE + LZ_MAXINPUT];
+static int		lz_head[LZ_HASHSIZE];
+static int		lz_prev[LZ_DICTSIZE + LZ_MAXINPUT];
+
+#define	LZ_HASH(p)	(((p)[0] << 4 ^ (p)[1] << 2 ^ (p)[2]) & (LZ_HASHSIZE - 1))
+
+static void LZ_Insert (int pos)
+{
+	int		h;
+
+	h = LZ_HASH(lz_work + pos);
+	lz_prev[pos] = lz_head[h];
+	lz_head[h] = pos;
+}
+
+/*
+==================
+LZ_Compress
+
+==================
+*/
+int LZ_Compress (byte *in, int inlen, byte *out, int outmax)
+{
+	int		pos, end;
+	int		outpos, ctrlpos, item;
+	int		p, chain;
+	int		len, bestlen, bestoffset;
+
+	if (inlen > LZ_MAXINPUT)
+		return -1;
+
+	Q_memcpy (lz_work, lz_dictionary, LZ_DICTSIZE);
+	Q_memcpy (lz_work + LZ_DICTSIZE, in, inlen);
+	end = LZ_DICTSIZE + inlen;
+
+	for (p=0 ; p<LZ_HASHSIZE ; p++)
+		lz_head[p] = -1;
+	for (pos=0 ; pos + LZ_MINMATCH <= LZ_DICTSIZE ; pos++)
+		LZ_Insert (pos);
+
+	outpos = 0;
+	ctrlpos = 0;
+	item = 8;
+	pos = LZ_DICTSIZE;
+
+	while (pos < end)
+	{
+		if (item == 8)
+		{
+			if (outpos >= outmax)
+				return -1;
+			ctrlpos = outpos++;
+			out[ctrlpos] = 0;
+			item = 0;
+		}
+
+	// look for the longest match in the window
+		bestlen = 0;
+		bestoffset = 0;
+		if (pos + LZ_MINMATCH <= end)
+		{
+			chain = 0;
+			for (p = lz_head[LZ_HASH(lz_work + pos)] ; p >= 0 && pos - p <= LZ_WINDOW && chain < LZ_MAXCHAIN ; p = lz_prev[p], chain++)
+			{
+				for (len=0 ; len<LZ_MAXMATCH && pos+len<end ; len++)
+					if (lz_work[p+len] != lz_work[pos+len])
+						break;
+				if (len > bestlen)
+				{
+					bestlen = len;
+					bestoffset = pos - p;
+					if (len == LZ_MAXMATCH)
+						break;
+				}
+			}
+		}
+
+		if (bestlen >= LZ_MINMATCH)
+		{
+			if (outpos + 2 > outmax)
+				return -1;
+			out[ctrlpos] |= 1 << item;
+			out[outpos++] = (bestoffset - 1) & 255;
+			out[outpos++] = (((bestoffset - 1) >> 4) & 0xf0) | (bestlen - LZ_MINMATCH);
+			while (bestlen--)
+			{
+				if (pos + LZ_MINMATCH <= end)
+					LZ_Insert (pos);
+				pos++;
+			}
+		}
+		else
+		{
+			if (outpos + 1 > outmax)
+				return -1;
+			out[outpos++] = lz_work[pos];
+			if (pos + LZ_MINMATCH <= end)
+				LZ_Insert (pos);
+			pos++;
+		}
+		item++;
+	}
+
+	return outpos;
+}
+
+/*
+==================
+LZ_Decompress
+
+==================
+*/
+int LZ_Decompress (byte *in, int inlen, byte *out, int outmax)
+{
+	int		pos, end;
+	int		inpos, ctrl, item;
+	int		offset, len;
+
+	if (outmax > LZ_MAXINPUT)
+		outmax = LZ_MAXINPUT;
+
+	Q_memcpy (lz_work, lz_dictionary, LZ_DICTSIZE);
+	pos = LZ_DICTSIZE;
+	end = LZ_DICTSIZE + outmax;
+
+	inpos = 0;
+	while (inpos < inlen)
+	{
+		ctrl = in[inpos++];
+		for (item=0 ; item<8 && inpos<inlen ; item++)
+		{
+			if (ctrl & (1 << item))
+			{
+				if (inpos + 2 > inlen)
+					return -1;
+				offset = (in[inpos] | ((in[inpos+1] & 0xf0) << 4)) + 1;
+				len = (in[inpos+1] & 15) + LZ_MINMATCH;
+				inpos += 2;
+				if (offset > pos || pos + len > end)
+					return -1;
+				while (len--)
+				{
+					lz_work[pos] = lz_work[pos - offset];
+					pos++;
+				}
+			}
+			else
+			{
+				if (pos >= end)
+					return -1;
+				lz_work[pos++] = in[inpos++];
+			}
+		}
+	}
+
+	Q_memcpy (out, lz_work + LZ_DICTSIZE, pos - LZ_DICTSIZE);
+	return pos - LZ_DICTSIZE;
+}
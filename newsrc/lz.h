@@ -0,0 +1,26 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// lz.h -- lzss compression for network messages
+
+#define LZ_MAXINPUT		8192		// NET_MAXMESSAGE
+
+// both return the output length, or -1 if it didn't fit in outmax
+int LZ_Compress (byte *in, int inlen, byte *out, int outmax);
+int LZ_Decompress (byte *in, int inlen, byte *out, int outmax);
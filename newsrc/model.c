@@ -32,9 +32,20 @@ void Mod_LoadSpriteModel(model_t* mod, void* buffer);
 void Mod_LoadBrushModel(model_t* mod, void* buffer);
 void Mod_LoadAliasModel(model_t* mod, void* buffer);
 model_t* Mod_LoadModel(model_t* mod, qboolean crash);
+qboolean Mod_LoadCooked(model_t* mod, byte* source, int size, unsigned crc);
+void Mod_SaveCooked(model_t* mod, byte* source, int size, unsigned crc, int start);
+void Mod_CookBench_f(void);
+
+cvar_t mod_cook = {"mod_cook", "1"};
 
 byte mod_novis[MAX_MAP_LEAFS / 8];
 
+// the brush model being loaded is in a mapped pak, read only and there for good
+qboolean mod_mapped;
+
+// size of the cache block Mod_LoadAliasModel last made
+int mod_aliassize;
+
 // list of loaded models
 #define MAX_MOD_KNOWN 256
 model_t mod_known[MAX_MOD_KNOWN];
@@ -52,6 +63,9 @@ Mod_Init
 */
 void Mod_Init(void) {
 	memset(mod_novis, 0xff, sizeof(mod_novis));
+
+	Cvar_RegisterVariable(&mod_cook);
+	Cmd_AddCommand("cookbench", Mod_CookBench_f);
 }
 
 /*
@@ -255,6 +269,33 @@ void Mod_TouchModel (char *name)
 	}
 }
 
+/*
+==================
+Mod_Prefetch
+
+Starts reading a model that Mod_ForName is going to need
+==================
+*/
+void Mod_Prefetch (char *name)
+{
+	model_t	*mod;
+
+	if (name[0] == '*')
+		return;		// inline models come with the world
+
+	mod = Mod_FindName (name);
+
+	if (mod->type == mod_alias)
+	{
+		if (Cache_Check (&mod->cache))
+			return;
+	}
+	else if (mod->needload == NL_PRESENT)
+		return;
+
+	COM_PrefetchFile (name);
+}
+
 /*
 ==================
 Mod_LoadModel
@@ -278,10 +319,23 @@ model_t* Mod_LoadModel(model_t* model, qboolean crash) {
 
 	// load the file
 	byte stackbuf[1024];  // avoid dirtying the cache heap
-	unsigned* buf = (unsigned*)COM_LoadStackFile(
-			model->name,
-			stackbuf,
-			sizeof(stackbuf));
+
+	// brush models can be read straight out of a mapped pak, the alias and
+	// sprite loaders fix the file up in place so they need their own copy
+	unsigned* buf = (unsigned*)COM_MapFile(model->name);
+	mod_mapped = buf != NULL;
+
+	if (buf && (LittleLong(*buf) == IDPOLYHEADER || LittleLong(*buf) == IDSPRITEHEADER)) {
+		buf = NULL;
+		mod_mapped = false;
+	}
+
+	if (!buf) {
+		buf = (unsigned*)COM_LoadStackFile(
+				model->name,
+				stackbuf,
+				sizeof(stackbuf));
+	}
 
 	if (!buf) {
 		if (crash) {
@@ -291,6 +345,8 @@ model_t* Mod_LoadModel(model_t* model, qboolean crash) {
 		return NULL;
 	}
 
+	int filesize = com_filesize;
+
 	// allocate a new model
 	COM_FileBase(model->name, loadname);
 
@@ -299,6 +355,19 @@ model_t* Mod_LoadModel(model_t* model, qboolean crash) {
 	// fill it in
 	model->needload = NL_PRESENT;
 
+	// before the loaders, which may change the file
+	unsigned crc = 0;
+
+	if (mod_cook.value) {
+		crc = CRC32_Block((byte*)buf, filesize);
+
+		if (Mod_LoadCooked(model, (byte*)buf, filesize, crc)) {
+			return model;
+		}
+	}
+
+	int start = Hunk_LowMark();
+
 	// call the apropriate loader
 	switch (LittleLong(*(unsigned*)buf)) {
 		case IDPOLYHEADER:
@@ -314,6 +383,10 @@ model_t* Mod_LoadModel(model_t* model, qboolean crash) {
 			break;
 	}
 
+	if (mod_cook.value) {
+		Mod_SaveCooked(model, (byte*)buf, filesize, crc, start);
+	}
+
 	return model;
 }
 
@@ -350,6 +423,7 @@ Mod_LoadTextures
 void Mod_LoadTextures (lump_t *l)
 {
 	int		i, j, pixels, num, max, altmax;
+	int		nummiptex, dataofs, width, height;
 	miptex_t	*mt;
 	texture_t	*tx, *tx2;
 	texture_t	*anims[10];
@@ -361,35 +435,34 @@ void Mod_LoadTextures (lump_t *l)
 		loadmodel->textures = NULL;
 		return;
 	}
+	// the lump may be read only, so it is swapped on the way out, not in place
 	m = (dmiptexlump_t *)(mod_base + l->fileofs);
 
-	m->nummiptex = LittleLong (m->nummiptex);
+	nummiptex = LittleLong (m->nummiptex);
 
-	loadmodel->numtextures = m->nummiptex;
-	loadmodel->textures = Hunk_AllocName (m->nummiptex * sizeof(*loadmodel->textures) , loadname);
+	loadmodel->numtextures = nummiptex;
+	loadmodel->textures = Hunk_AllocName (nummiptex * sizeof(*loadmodel->textures) , loadname);
 
-	for (i=0 ; i<m->nummiptex ; i++)
+	for (i=0 ; i<nummiptex ; i++)
 	{
-		m->dataofs[i] = LittleLong(m->dataofs[i]);
-		if (m->dataofs[i] == -1)
+		dataofs = LittleLong(m->dataofs[i]);
+		if (dataofs == -1)
 			continue;
-		mt = (miptex_t *)((byte *)m + m->dataofs[i]);
-		mt->width = LittleLong (mt->width);
-		mt->height = LittleLong (mt->height);
-		for (j=0 ; j<MIPLEVELS ; j++)
-			mt->offsets[j] = LittleLong (mt->offsets[j]);
+		mt = (miptex_t *)((byte *)m + dataofs);
+		width = LittleLong (mt->width);
+		height = LittleLong (mt->height);
 
-		if ( (mt->width & 15) || (mt->height & 15) )
+		if ( (width & 15) || (height & 15) )
 			Sys_Error ("Texture %s is not 16 aligned", mt->name);
-		pixels = mt->width*mt->height/64*85;
+		pixels = width*height/64*85;
 		tx = Hunk_AllocName (sizeof(texture_t) +pixels, loadname );
 		loadmodel->textures[i] = tx;
 
 		memcpy (tx->name, mt->name, sizeof(tx->name));
-		tx->width = mt->width;
-		tx->height = mt->height;
+		tx->width = width;
+		tx->height = height;
 		for (j=0 ; j<MIPLEVELS ; j++)
-			tx->offsets[j] = mt->offsets[j] + sizeof(texture_t) - sizeof(miptex_t);
+			tx->offsets[j] = LittleLong (mt->offsets[j]) + sizeof(texture_t) - sizeof(miptex_t);
 		// the pixels immediately follow the structures
 		memcpy ( tx+1, mt+1, pixels);
 
@@ -503,6 +576,11 @@ void Mod_LoadLighting (lump_t *l)
 		loadmodel->lightdata = NULL;
 		return;
 	}
+	if (mod_mapped)
+	{
+		loadmodel->lightdata = mod_base + l->fileofs;
+		return;
+	}
 	loadmodel->lightdata = Hunk_AllocName ( l->filelen, loadname);
 	memcpy (loadmodel->lightdata, mod_base + l->fileofs, l->filelen);
 }
@@ -520,6 +598,11 @@ void Mod_LoadVisibility (lump_t *l)
 		loadmodel->visdata = NULL;
 		return;
 	}
+	if (mod_mapped)
+	{
+		loadmodel->visdata = mod_base + l->fileofs;
+		return;
+	}
 	loadmodel->visdata = Hunk_AllocName ( l->filelen, loadname);
 	memcpy (loadmodel->visdata, mod_base + l->fileofs, l->filelen);
 }
@@ -1139,21 +1222,21 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 {
 	int			i, j;
 	dheader_t	*header;
+	dheader_t	swapped;
 	dmodel_t 	*bm;
 
 	loadmodel->type = mod_brush;
 
-	header = (dheader_t *)buffer;
-
-	i = LittleLong (header->version);
+	i = LittleLong (((dheader_t *)buffer)->version);
 	if (i != BSPVERSION)
 		Sys_Error ("Mod_LoadBrushModel: %s has wrong version number (%i should be %i)", mod->name, i, BSPVERSION);
 
-// swap all the lumps
-	mod_base = (byte *)header;
+// swap all the lumps, into a copy since the buffer may be read only
+	mod_base = (byte *)buffer;
+	header = &swapped;
 
 	for (i=0 ; i<sizeof(dheader_t)/4 ; i++)
-		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
+		((int *)header)[i] = LittleLong ( ((int *)buffer)[i]);
 
 // load into heap
 
@@ -1650,6 +1733,7 @@ void Mod_LoadAliasModel (model_t *mod, void *buffer)
 	if (!mod->cache.data)
 		return;
 	memcpy (mod->cache.data, pheader, total);
+	mod_aliassize = total;
 
 	Hunk_FreeToLowMark (start);
 }
@@ -1865,3 +1949,569 @@ void Mod_Print (void)
 		Con_Printf ("\n");
 	}
 }
+
+/*
+===============================================================================
+
+COOKED MODELS
+
+A loaded model is written out as it sits in memory, so the next load of
+the same file is one read and a pass over the pointers instead of the
+lump by lump conversion.  Brush models and sprites are everything the
+loader put on the hunk, plus the model_t structures; alias models are
+already position independent, so they are just the cache block.
+
+Cooked files live under <gamedir>/cooked/ and are only used if the
+source file's CRC and size, the format version and the pak mapping all
+match.  Pointers are written as offsets, so a file is good for any build
+that lays the structures out the same way.  mod_cook 0 turns them off.
+
+===============================================================================
+*/
+
+#define COOK_IDENT (('D' << 24) + ('K' << 16) + ('C' << 8) + 'Q')
+#define COOK_VERSION 2  // bump when anything that gets written changes shape
+
+// pointers in a cooked file are offsets into this layout
+#define COOK_NOTEXTURE 1
+#define COOK_HUNKOFS 16
+#define COOK_MAPOFS 0x40000000  // then the source file, when it is mapped
+
+// <gamedir>/cooked/<model name>
+#define COOK_PATHSIZE (MAX_OSPATH + 8 + MAX_QPATH)
+
+typedef struct {
+	int ident;
+	int version;
+	int modelsize;  // sizeof(model_t), in case it changes without a version bump
+	int pixbytes;  // sprites are converted to the screen depth
+	int type;
+	unsigned crc;  // CRC32_Block of the whole source file
+	int filesize;
+	qboolean mapped;  // some pointers lead into the mapped source file
+	int nummodels;  // model_t structures that follow, world first
+	int datasize;  // then the hunk or cache data
+} cookheader_t;
+
+// the model_t structures going to or coming from a file
+static model_t cookmodels[MAX_MAP_MODELS];
+
+// pointer translation between where things are in memory and where they
+// are in the cooked file's layout, in either direction
+static struct {
+	unsigned long hunkbase;
+	unsigned long newhunk;
+	unsigned long hunksize;
+	byte* hunkdata;  // where the data at newhunk is right now
+	unsigned long mapbase;
+	unsigned long newmap;
+	unsigned long mapsize;
+	unsigned long notexture;
+	unsigned long newnotexture;
+	qboolean bad;  // a pointer to something that wasn't saved
+} reloc;
+
+static void* Mod_Reloc(void* ptr) {
+	unsigned long p = (unsigned long)ptr;
+
+	if (!p) {
+		return NULL;
+	}
+
+	if (p - reloc.hunkbase < reloc.hunksize) {
+		return (void*)(reloc.newhunk + (p - reloc.hunkbase));
+	}
+
+	if (p - reloc.mapbase < reloc.mapsize) {
+		return (void*)(reloc.newmap + (p - reloc.mapbase));
+	}
+
+	if (p == reloc.notexture) {
+		return (void*)reloc.newnotexture;
+	}
+
+	reloc.bad = true;
+	return NULL;
+}
+
+// the memory a relocated pointer leads to, so the data can be walked
+// while its pointers are being written as offsets
+static void* Mod_RelocData(void* ptr) {
+	unsigned long p = (unsigned long)ptr;
+
+	if (p && p - reloc.newhunk < reloc.hunksize) {
+		return reloc.hunkdata + (p - reloc.newhunk);
+	}
+
+	return ptr;
+}
+
+#define RELOC(p) ((p) = Mod_Reloc(p))
+
+/*
+=================
+Mod_RelocBrush
+
+The model level pointers are relocated first, and the arrays are found
+through them.  Inline models share the world's arrays.  Cached surfaces
+and efrags belong to the renderer, not the file.
+=================
+*/
+static void Mod_RelocBrush(model_t* mod, int numleafs, qboolean arrays) {
+	RELOC(mod->submodels);
+	RELOC(mod->planes);
+	RELOC(mod->leafs);
+	RELOC(mod->vertexes);
+	RELOC(mod->edges);
+	RELOC(mod->nodes);
+	RELOC(mod->texinfo);
+	RELOC(mod->surfaces);
+	RELOC(mod->surfedges);
+	RELOC(mod->clipnodes);
+	RELOC(mod->marksurfaces);
+	RELOC(mod->textures);
+	RELOC(mod->visdata);
+	RELOC(mod->lightdata);
+	RELOC(mod->entities);
+
+	for (int i = 0; i < MAX_MAP_HULLS; i++) {
+		RELOC(mod->hulls[i].clipnodes);
+		RELOC(mod->hulls[i].planes);
+	}
+
+	if (!arrays || reloc.bad) {
+		return;
+	}
+
+	mtexinfo_t* texinfo = Mod_RelocData(mod->texinfo);
+
+	for (int i = 0; i < mod->numtexinfo; i++) {
+		RELOC(texinfo[i].texture);
+	}
+
+	msurface_t* surfaces = Mod_RelocData(mod->surfaces);
+
+	for (int i = 0; i < mod->numsurfaces; i++) {
+		msurface_t* surf = &surfaces[i];
+
+		RELOC(surf->plane);
+		RELOC(surf->texinfo);
+		RELOC(surf->samples);
+		memset(surf->cachespots, 0, sizeof(surf->cachespots));
+	}
+
+	mnode_t* nodes = Mod_RelocData(mod->nodes);
+
+	for (int i = 0; i < mod->numnodes; i++) {
+		mnode_t* node = &nodes[i];
+
+		RELOC(node->parent);
+		RELOC(node->plane);
+		RELOC(node->children[0]);
+		RELOC(node->children[1]);
+	}
+
+	mleaf_t* leafs = Mod_RelocData(mod->leafs);
+
+	for (int i = 0; i < numleafs; i++) {
+		mleaf_t* leaf = &leafs[i];
+
+		RELOC(leaf->parent);
+		RELOC(leaf->compressed_vis);
+		RELOC(leaf->firstmarksurface);
+		leaf->efrags = NULL;
+	}
+
+	msurface_t** marksurfaces = Mod_RelocData(mod->marksurfaces);
+
+	for (int i = 0; i < mod->nummarksurfaces; i++) {
+		RELOC(marksurfaces[i]);
+	}
+
+	texture_t** textures = Mod_RelocData(mod->textures);
+
+	for (int i = 0; i < mod->numtextures; i++) {
+		texture_t* tx = Mod_RelocData(RELOC(textures[i]));
+
+		// notexture isn't in the data, and isn't ours to change
+		if (tx && tx != Mod_RelocData((void*)reloc.newnotexture)) {
+			RELOC(tx->anim_next);
+			RELOC(tx->alternate_anims);
+		}
+	}
+}
+
+/*
+=================
+Mod_RelocSprite
+=================
+*/
+static void Mod_RelocSprite(model_t* mod) {
+	msprite_t* psprite = Mod_RelocData(RELOC(mod->cache.data));
+
+	if (!psprite) {
+		return;
+	}
+
+	psprite->cachespot = NULL;
+
+	for (int i = 0; i < psprite->numframes; i++) {
+		mspriteframe_t* frame = Mod_RelocData(RELOC(psprite->frames[i].frameptr));
+
+		if (!frame) {
+			return;
+		}
+
+		if (psprite->frames[i].type == SPR_SINGLE) {
+			frame->pcachespot = NULL;
+			continue;
+		}
+
+		mspritegroup_t* group = (mspritegroup_t*)frame;
+
+		RELOC(group->intervals);
+
+		for (int j = 0; j < group->numframes; j++) {
+			frame = Mod_RelocData(RELOC(group->frames[j]));
+
+			if (frame) {
+				frame->pcachespot = NULL;
+			}
+		}
+	}
+}
+
+// leafs in the file; the world's numleafs only counts the visible ones
+static int Mod_CountLeafs(byte* source) {
+	dheader_t* header = (dheader_t*)source;
+
+	return LittleLong(header->lumps[LUMP_LEAFS].filelen) / sizeof(dleaf_t);
+}
+
+// path is COOK_PATHSIZE
+static void Mod_CookPath(model_t* mod, char* path) {
+	snprintf(path, COOK_PATHSIZE, "%s/cooked/%s", com_gamedir, mod->name);
+}
+
+/*
+=================
+Mod_SaveCooked
+
+start is the hunk low mark from before the loader ran.  The model and
+its data are copied and the copies relocated to the file's layout, the
+loaded model is left alone.
+=================
+*/
+void Mod_SaveCooked(model_t* mod, byte* source, int size, unsigned crc, int start) {
+	cookheader_t header;
+	byte* data;
+	byte* copy;
+	char path[COOK_PATHSIZE];
+
+	memset(&header, 0, sizeof(header));
+	header.ident = COOK_IDENT;
+	header.version = COOK_VERSION;
+	header.modelsize = sizeof(model_t);
+	header.pixbytes = r_pixbytes;
+	header.type = mod->type;
+	header.crc = crc;
+	header.filesize = size;
+	header.nummodels = 1;
+
+	cookmodels[0] = *mod;
+
+	if (mod->type == mod_alias) {
+		data = mod->cache.data;
+
+		if (!data) {
+			return;
+		}
+
+		// the data has no pointers, and nothing in the model_t is used
+		header.datasize = mod_aliassize;
+		cookmodels[0].cache.data = NULL;
+	} else {
+		data = Hunk_MarkPointer(start);
+		header.datasize = Hunk_LowMark() - start;
+
+		if (header.datasize >= COOK_MAPOFS - COOK_HUNKOFS) {
+			return;
+		}
+
+		if (mod->type == mod_brush) {
+			header.mapped = mod_mapped;
+
+			for (int i = 1; i < mod->numsubmodels && i < MAX_MAP_MODELS; i++) {
+				cookmodels[header.nummodels++] = *Mod_FindName(va("*%i", i));
+			}
+		}
+	}
+
+	copy = malloc(header.datasize);
+
+	if (!copy) {
+		return;
+	}
+
+	memcpy(copy, data, header.datasize);
+
+	if (mod->type != mod_alias) {
+		memset(&reloc, 0, sizeof(reloc));
+		reloc.hunkbase = (unsigned long)data;
+		reloc.newhunk = COOK_HUNKOFS;
+		reloc.hunksize = header.datasize;
+		reloc.hunkdata = copy;
+
+		if (header.mapped) {
+			reloc.mapbase = (unsigned long)source;
+			reloc.newmap = COOK_MAPOFS;
+			reloc.mapsize = size;
+		}
+
+		reloc.notexture = (unsigned long)r_notexture_mip;
+		reloc.newnotexture = COOK_NOTEXTURE;
+
+		if (mod->type == mod_brush) {
+			for (int i = 0; i < header.nummodels; i++) {
+				Mod_RelocBrush(&cookmodels[i], Mod_CountLeafs(source), i == 0);
+			}
+		} else {
+			Mod_RelocSprite(&cookmodels[0]);
+		}
+
+		// every pointer has to lead somewhere that can be put back
+		if (reloc.bad) {
+			Con_DPrintf("Mod_SaveCooked: can't cook %s\n", mod->name);
+			free(copy);
+			return;
+		}
+	}
+
+	Mod_CookPath(mod, path);
+	COM_CreatePath(path);
+
+	FILE* f = fopen(path, "wb");
+
+	if (!f) {
+		free(copy);
+		return;
+	}
+
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(cookmodels, sizeof(model_t), header.nummodels, f);
+	fwrite(copy, header.datasize, 1, f);
+	free(copy);
+
+	if (ferror(f)) {
+		fclose(f);
+		remove(path);
+		return;
+	}
+
+	fclose(f);
+}
+
+/*
+=================
+Mod_LoadCooked
+
+Returns false if there is no usable cooked file, and the model should
+be loaded from source
+=================
+*/
+qboolean Mod_LoadCooked(model_t* mod, byte* source, int size, unsigned crc) {
+	cookheader_t header;
+	char path[COOK_PATHSIZE];
+
+	Mod_CookPath(mod, path);
+
+	FILE* f = fopen(path, "rb");
+
+	if (!f) {
+		return false;
+	}
+
+	if (fread(&header, sizeof(header), 1, f) != 1
+			|| header.ident != COOK_IDENT
+			|| header.version != COOK_VERSION
+			|| header.modelsize != sizeof(model_t)
+			|| header.pixbytes != r_pixbytes
+			|| header.crc != crc
+			|| header.filesize != size
+			|| header.mapped != (header.type == mod_brush && mod_mapped)
+			|| header.nummodels < 1
+			|| header.nummodels > MAX_MAP_MODELS
+			|| header.datasize <= 0
+			|| header.datasize >= COOK_MAPOFS - COOK_HUNKOFS
+			|| fread(cookmodels, sizeof(model_t), header.nummodels, f) != header.nummodels) {
+		fclose(f);
+		return false;
+	}
+
+	model_t* models = cookmodels;
+
+	if (header.type == mod_alias) {
+		Cache_Alloc(&mod->cache, header.datasize, loadname);
+
+		if (!mod->cache.data) {
+			fclose(f);
+			return false;
+		}
+
+		if (fread(mod->cache.data, header.datasize, 1, f) != 1) {
+			Cache_Free(&mod->cache);
+			fclose(f);
+			return false;
+		}
+
+		fclose(f);
+
+		mod->type = mod_alias;
+		mod->numframes = models[0].numframes;
+		mod->synctype = models[0].synctype;
+		mod->flags = models[0].flags;
+		VectorCopy(models[0].mins, mod->mins);
+		VectorCopy(models[0].maxs, mod->maxs);
+		return true;
+	}
+
+	int start = Hunk_LowMark();
+	byte* data = Hunk_AllocName(header.datasize, loadname);
+
+	if (fread(data, header.datasize, 1, f) != 1) {
+		fclose(f);
+		Hunk_FreeToLowMark(start);
+		return false;
+	}
+
+	fclose(f);
+
+	memset(&reloc, 0, sizeof(reloc));
+	reloc.hunkbase = COOK_HUNKOFS;
+	reloc.newhunk = (unsigned long)data;
+	reloc.hunksize = header.datasize;
+	reloc.hunkdata = data;
+
+	if (header.mapped) {
+		reloc.mapbase = COOK_MAPOFS;
+		reloc.newmap = (unsigned long)source;
+		reloc.mapsize = size;
+	}
+
+	reloc.notexture = COOK_NOTEXTURE;
+	reloc.newnotexture = (unsigned long)r_notexture_mip;
+
+	if (header.type == mod_sprite) {
+		Mod_RelocSprite(&models[0]);
+	} else {
+		for (int i = 0; i < header.nummodels; i++) {
+			Mod_RelocBrush(&models[i], Mod_CountLeafs(source), i == 0);
+		}
+	}
+
+	if (reloc.bad) {
+		Hunk_FreeToLowMark(start);
+		return false;
+	}
+
+	// install them; the world keeps its name, the inline models are
+	// looked up by theirs
+	strcpy(models[0].name, mod->name);
+	*mod = models[0];
+
+	for (int i = 1; i < header.nummodels; i++) {
+		*Mod_FindName(models[i].name) = models[i];
+	}
+
+	if (mod->type == mod_brush) {
+		for (int i = 0; i < mod->numtextures; i++) {
+			texture_t* tx = mod->textures[i];
+
+			if (tx && !Q_strncmp(tx->name, "sky", 3)) {
+				R_InitSky(tx);
+			}
+		}
+	}
+
+	Con_DPrintf("Mod_LoadCooked: %s\n", mod->name);
+	return true;
+}
+
+/*
+=================
+Mod_CookBench_f
+
+cookbench [model] [count]
+
+Times loads of a model from source and from its cooked file
+=================
+*/
+void Mod_CookBench_f(void) {
+	char* name = "maps/start.bsp";
+	int count = 5;
+	float cook = mod_cook.value;
+	double times[2];
+
+	if (Cmd_Argc() > 1) {
+		name = Cmd_Argv(1);
+	}
+
+	if (Cmd_Argc() > 2) {
+		count = Q_atoi(Cmd_Argv(2));
+
+		if (count < 1) {
+			count = 1;
+		}
+	}
+
+	if (sv.active || cls.state == ca_connected) {
+		Con_Printf("cookbench: can't run with a level loaded\n");
+		return;
+	}
+
+	int mark = Hunk_LowMark();
+
+	// pass 0 converts the source every time, pass 1 starts with a load
+	// that writes the cooked file if it isn't there yet
+	for (int pass = 0; pass < 2; pass++) {
+		Cvar_SetValue("mod_cook", pass);
+		times[pass] = 0;
+
+		for (int i = -pass; i < count; i++) {
+			model_t* mod = Mod_FindName(name);
+
+			Mod_ClearAll();
+			mod->needload = NL_NEEDS_LOADED;
+
+			if (mod->type == mod_alias && mod->cache.data) {
+				Cache_Free(&mod->cache);
+			}
+
+			double start = Sys_FloatTime();
+
+			if (!Mod_LoadModel(mod, false)) {
+				Con_Printf("cookbench: couldn't load %s\n", name);
+				Cvar_SetValue("mod_cook", cook);
+				Hunk_FreeToLowMark(mark);
+				return;
+			}
+
+			if (i >= 0) {
+				times[pass] += Sys_FloatTime() - start;
+			}
+
+			Hunk_FreeToLowMark(mark);
+		}
+	}
+
+	Mod_ClearAll();
+	Cvar_SetValue("mod_cook", cook);
+
+	Con_Printf("%s, %i loads each\n", name, count);
+	Con_Printf("source: %7.2f ms\n", times[0] * 1000 / count);
+	Con_Printf("cooked: %7.2f ms\n", times[1] * 1000 / count);
+
+	if (times[1] > 0) {
+		Con_Printf("%.1fx faster\n", times[0] / times[1]);
+	}
+}
@@ -44,6 +44,12 @@ struct qsockaddr
 
 #define NET_PROTOCOL_VERSION	3
 
+// optional capability flags, appended to CCREQ_CONNECT by the client and
+// echoed back in CCREP_ACCEPT with the ones the server agreed to.  Older
+// peers never read past the fields they know about.
+#define NET_CAP_COMPRESS		1		// reliable messages are lz compressed
+#define NET_CAP_CHALLENGE		2		// client answers CCREP_CHALLENGE
+
 // This is the network info/connection protocol.  It is used to find Quake
 // servers, get info about them, and connect to them.  Once connected, the
 // Quake game protocol (documented elsewhere) is used.
@@ -56,6 +62,8 @@ struct qsockaddr
 // CCREQ_CONNECT
 //		string	game_name				"QUAKE"
 //		byte	net_protocol_version	NET_PROTOCOL_VERSION
+//		byte	capabilities			NET_CAP_* (optional)
+//		long	challenge				NET_CAP_CHALLENGE only, 0 on first try
 //
 // CCREQ_SERVER_INFO
 //		string	game_name				"QUAKE"
@@ -71,6 +79,7 @@ struct qsockaddr
 //
 // CCREP_ACCEPT
 //		long	port
+//		byte	capabilities			NET_CAP_* (optional)
 //
 // CCREP_REJECT
 //		string	reason
@@ -94,6 +103,9 @@ struct qsockaddr
 // CCREP_RULE_INFO
 //		string	rule
 //		string	value
+//
+// CCREP_CHALLENGE
+//		long	challenge				send it back in a new CCREQ_CONNECT
 
 //	note:
 //		There are two address forms used above.  The short form is just a
@@ -115,6 +127,7 @@ struct qsockaddr
 #define CCREP_SERVER_INFO	0x83
 #define CCREP_PLAYER_INFO	0x84
 #define CCREP_RULE_INFO		0x85
+#define CCREP_CHALLENGE		0x86
 
 typedef struct qsocket_s
 {
@@ -126,6 +139,7 @@ typedef struct qsocket_s
 	qboolean		disconnected;
 	qboolean		canSend;
 	qboolean		sendNext;
+	qboolean		compress;		// NET_CAP_COMPRESS was negotiated
 
 	int				driver;
 	int				landriver;
@@ -136,12 +150,12 @@ typedef struct qsocket_s
 	unsigned int	sendSequence;
 	unsigned int	unreliableSendSequence;
 	int				sendMessageLength;
-	byte			sendMessage [NET_MAXMESSAGE];
+	byte			sendMessage [NET_MAXMESSAGE + 1];	// + compression tag
 
 	unsigned int	receiveSequence;
 	unsigned int	unreliableReceiveSequence;
 	int				receiveMessageLength;
-	byte			receiveMessage [NET_MAXMESSAGE];
+	byte			receiveMessage [NET_MAXMESSAGE + 1];
 
 	struct qsockaddr	addr;
 	char				address[NET_NAMELEN];
@@ -208,6 +222,7 @@ extern int			net_hostport;
 
 extern int net_driverlevel;
 extern cvar_t		hostname;
+extern cvar_t		net_compress;
 extern char			playername[];
 extern int			playercolor;
 
@@ -221,6 +236,44 @@ void NET_FreeQSocket(qsocket_t *);
 double SetNetTime(void);
 
 
+// what the server looked like when last published, for answering
+// CCREQ_SERVER_INFO, CCREQ_PLAYER_INFO and CCREQ_RULE_INFO without going
+// near svs or the cvar list
+#define	MAX_QUERYRULES	64
+
+typedef struct
+{
+	char	name[MAX_SCOREBOARDNAME];
+	int		colors;
+	int		frags;
+	double	connecttime;
+	char	address[NET_NAMELEN];
+} queryplayer_t;
+
+typedef struct
+{
+	char	name[32];
+	char	value[64];
+} queryrule_t;
+
+typedef struct
+{
+	char			hostname[64];
+	char			mapname[64];
+	int				activeconnections;
+	int				maxclients;
+	int				numplayers;
+	queryplayer_t	players[MAX_SCOREBOARD];	// active clients, in order
+	int				numrules;
+	queryrule_t		rules[MAX_QUERYRULES];		// server cvars, in order
+} net_serverstate_t;
+
+extern net_serverstate_t	net_serverstate;
+extern qboolean				net_serverstatechanged;	// republish next frame
+
+void NET_PublishServerState (void);
+
+
 #define HOSTCACHESIZE	8
 
 typedef struct
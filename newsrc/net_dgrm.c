@@ -68,6 +68,27 @@ int packetsReceived = 0;
 int receivedDuplicateCount = 0;
 int shortPacketCount = 0;
 int droppedDatagrams;
+int compressedMessages = 0;
+int compressedBytesIn = 0;
+int compressedBytesOut = 0;
+double compressTime = 0;
+int decompressedMessages = 0;
+double decompressTime = 0;
+int queriesServed[3];		// server, player, rule info
+int queriesDropped = 0;
+int connectAttempts = 0;
+int connectsAccepted = 0;
+int connectsBanned = 0;
+int connectsRateLimited = 0;
+int challengesSent = 0;
+double connectTime = 0;
+
+cvar_t	net_queryrate = {"net_queryrate", "20"};	// per address per second, 0 = no limit
+cvar_t	net_connectrate = {"net_connectrate", "4"};	// per address per second, 0 = no limit
+cvar_t	net_floodban = {"net_floodban", "60"};		// seconds to ban connect flooders, 0 = never
+cvar_t	net_requirechallenge = {"net_requirechallenge", "0"};	// turn away clients that can't answer one
+
+static unsigned cookiesecret;	// keys the connect challenges, picked at startup
 
 static int myDriverLevel;
 
@@ -102,10 +123,68 @@ char *StrAddr (struct qsockaddr *addr)
 unsigned long banAddr = 0x00000000;
 unsigned long banMask = 0xffffffff;
 
+/*
+The address out of an AF_INET qsockaddr, as sin_addr.s_addr would hold
+it.  Only the four address bytes are copied: the sockaddr_in above is
+longer than a qsockaddr where a long is 64 bits.
+*/
+static unsigned long NET_InetAddr (struct qsockaddr *addr)
+{
+	struct sockaddr_in	inaddr;
+
+	memset (&inaddr, 0, sizeof(inaddr));
+	memcpy (&inaddr.sin_addr, addr->sa_data + 2, 4);
+	return inaddr.sin_addr.s_addr;
+}
+
+// addresses banned automatically for flooding connect requests
+#define	MAX_FLOODBANS	32
+
+struct
+{
+	unsigned long	addr;
+	double			expires;
+} floodbans[MAX_FLOODBANS];
+
+void NET_FloodBan (unsigned long addr)
+{
+	int		i, oldest;
+
+	oldest = 0;
+	for (i = 0; i < MAX_FLOODBANS; i++)
+	{
+		if (floodbans[i].expires < net_time || floodbans[i].addr == addr)
+			break;
+		if (floodbans[i].expires < floodbans[oldest].expires)
+			oldest = i;
+	}
+	if (i == MAX_FLOODBANS)
+		i = oldest;
+
+	floodbans[i].addr = addr;
+	floodbans[i].expires = net_time + net_floodban.value;
+	Con_Printf("Banning %s for %i seconds for flooding\n", inet_ntoa(*(struct in_addr *)&addr), (int)net_floodban.value);
+}
+
+qboolean NET_IsBanned (unsigned long addr)
+{
+	int		i;
+
+	if ((addr & banMask) == banAddr)
+		return true;
+
+	for (i = 0; i < MAX_FLOODBANS; i++)
+		if (floodbans[i].addr == addr && floodbans[i].expires >= net_time)
+			return true;
+
+	return false;
+}
+
 void NET_Ban_f (void)
 {
 	char	addrStr [32];
 	char	maskStr [32];
+	int		i;
 	void	(*print) (char *fmt, ...);
 
 	if (cmd_source == src_command)
@@ -135,11 +214,17 @@ void NET_Ban_f (void)
 			}
 			else
 				print("Banning not active\n");
+			for (i = 0; i < MAX_FLOODBANS; i++)
+				if (floodbans[i].expires >= net_time)
+					print("Banning %s for flooding, %i seconds left\n", inet_ntoa(*(struct in_addr *)&floodbans[i].addr), (int)(floodbans[i].expires - net_time));
 			break;
 
 		case 2:
 			if (Q_strcasecmp(Cmd_Argv(1), "off") == 0)
+			{
 				banAddr = 0x00000000;
+				Q_memset(floodbans, 0, sizeof(floodbans));
+			}
 			else
 				banAddr = inet_addr(Cmd_Argv(1));
 			banMask = 0xffffffff;
@@ -158,6 +243,89 @@ void NET_Ban_f (void)
 #endif
 
 
+/*
+On a connection that negotiated NET_CAP_COMPRESS, every reliable message
+starts with one of these, and the rest is either the message as is or its
+LZ_Compress output, whichever is smaller.
+*/
+#define	MSG_RAW		0
+#define	MSG_LZ		1
+
+static void Datagram_PackMessage (qsocket_t *sock, sizebuf_t *data)
+{
+	int		len;
+	double	start;
+
+	if (!sock->compress)
+	{
+		Q_memcpy(sock->sendMessage, data->data, data->cursize);
+		sock->sendMessageLength = data->cursize;
+		return;
+	}
+
+	start = Sys_FloatTime();
+	len = LZ_Compress(data->data, data->cursize, sock->sendMessage + 1, data->cursize - 1);
+	compressTime += Sys_FloatTime() - start;
+
+	compressedMessages++;
+	compressedBytesIn += data->cursize;
+
+	if (len == -1)
+	{
+		sock->sendMessage[0] = MSG_RAW;
+		Q_memcpy(sock->sendMessage + 1, data->data, data->cursize);
+		sock->sendMessageLength = data->cursize + 1;
+	}
+	else
+	{
+		sock->sendMessage[0] = MSG_LZ;
+		sock->sendMessageLength = len + 1;
+	}
+
+	compressedBytesOut += sock->sendMessageLength;
+}
+
+/*
+Puts a complete reliable message into net_message, undoing
+Datagram_PackMessage.  Returns false if it can't be made sense of.
+*/
+static qboolean Datagram_UnpackMessage (qsocket_t *sock, byte *data, int length)
+{
+	int		len;
+	double	start;
+
+	SZ_Clear(&net_message);
+
+	if (!sock->compress)
+	{
+		SZ_Write(&net_message, data, length);
+		return true;
+	}
+
+	if (length < 1)
+		return false;
+
+	if (data[0] == MSG_RAW)
+	{
+		SZ_Write(&net_message, data + 1, length - 1);
+		return true;
+	}
+
+	if (data[0] != MSG_LZ)
+		return false;
+
+	start = Sys_FloatTime();
+	len = LZ_Decompress(data + 1, length - 1, net_message.data, net_message.maxsize);
+	decompressTime += Sys_FloatTime() - start;
+	if (len == -1)
+		return false;
+
+	decompressedMessages++;
+	net_message.cursize = len;
+	return true;
+}
+
+
 int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 {
 	unsigned int	packetLen;
@@ -175,12 +343,11 @@ int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 		Sys_Error("SendMessage: called with canSend == false\n");
 #endif
 
-	Q_memcpy(sock->sendMessage, data->data, data->cursize);
-	sock->sendMessageLength = data->cursize;
+	Datagram_PackMessage(sock, data);
 
-	if (data->cursize <= MAX_DATAGRAM)
+	if (sock->sendMessageLength <= MAX_DATAGRAM)
 	{
-		dataLen = data->cursize;
+		dataLen = sock->sendMessageLength;
 		eom = NETFLAG_EOM;
 	}
 	else
@@ -441,11 +608,21 @@ int	Datagram_GetMessage (qsocket_t *sock)
 
 			if (flags & NETFLAG_EOM)
 			{
-				SZ_Clear(&net_message);
-				SZ_Write(&net_message, sock->receiveMessage, sock->receiveMessageLength);
-				SZ_Write(&net_message, packetBuffer.data, length);
+				if (sock->receiveMessageLength + length > NET_MAXMESSAGE + (sock->compress ? 1 : 0))
+				{
+					Con_Printf("Oversize message\n");
+					return -1;
+				}
+				Q_memcpy(sock->receiveMessage + sock->receiveMessageLength, packetBuffer.data, length);
+				length += sock->receiveMessageLength;
 				sock->receiveMessageLength = 0;
 
+				if (!Datagram_UnpackMessage(sock, sock->receiveMessage, length))
+				{
+					Con_Printf("Bad compressed message\n");
+					return -1;
+				}
+
 				ret = 1;
 				break;
 			}
@@ -487,6 +664,23 @@ void NET_Stats_f (void)
 		Con_Printf("receivedDuplicateCount     = %i\n", receivedDuplicateCount);
 		Con_Printf("shortPacketCount           = %i\n", shortPacketCount);
 		Con_Printf("droppedDatagrams           = %i\n", droppedDatagrams);
+		Con_Printf("queries served             = %i server, %i player, %i rule\n", queriesServed[0], queriesServed[1], queriesServed[2]);
+		Con_Printf("queries rate limited       = %i\n", queriesDropped);
+		Con_Printf("connect requests           = %i\n", connectAttempts);
+		if (connectAttempts)
+		{
+			Con_Printf("  accepted %i, challenged %i, rate limited %i, banned %i\n", connectsAccepted, challengesSent, connectsRateLimited, connectsBanned);
+			Con_Printf("connect handling           = %.1f usec/request (%.0f/sec)\n", 1000000.0 * connectTime / connectAttempts, connectTime > 0 ? connectAttempts / connectTime : 0);
+		}
+		Con_Printf("compressedMessages         = %i\n", compressedMessages);
+		if (compressedMessages)
+		{
+			Con_Printf("compressed bytes           = %i -> %i (%.1f%%)\n", compressedBytesIn, compressedBytesOut, 100.0 * compressedBytesOut / compressedBytesIn);
+			Con_Printf("compress time              = %.1f usec/msg\n", 1000000.0 * compressTime / compressedMessages);
+		}
+		Con_Printf("decompressedMessages       = %i\n", decompressedMessages);
+		if (decompressedMessages)
+			Con_Printf("decompress time            = %.1f usec/msg\n", 1000000.0 * decompressTime / decompressedMessages);
 	}
 	else if (Q_strcmp(Cmd_Argv(1), "*") == 0)
 	{
@@ -770,6 +964,12 @@ int Datagram_Init (void)
 
 	myDriverLevel = net_driverlevel;
 	Cmd_AddCommand ("net_stats", NET_Stats_f);
+	Cvar_RegisterVariable (&net_queryrate);
+	Cvar_RegisterVariable (&net_connectrate);
+	Cvar_RegisterVariable (&net_floodban);
+	Cvar_RegisterVariable (&net_requirechallenge);
+
+	cookiesecret = ((unsigned)rand() << 16) ^ (unsigned)rand() ^ (unsigned)(Sys_FloatTime() * 1000000.0);
 
 	if (COM_CheckParm("-nolan"))
 		return -1;
@@ -827,146 +1027,240 @@ void Datagram_Listen (qboolean state)
 }
 
 
-static qsocket_t *_Datagram_CheckNewConnections (void)
+/*
+=============================================================================
+
+QUERY RESPONDER
+
+Server browsers poll CCREQ_SERVER_INFO, CCREQ_PLAYER_INFO and
+CCREQ_RULE_INFO all the time.  They are answered from net_serverstate,
+which the server publishes once a frame, so a query never walks the
+clients or the cvar list.  Each source address only gets net_queryrate
+answers a second, and a flood of queries can't hold up a connect waiting
+behind it on the accept socket.
+
+Connect requests get the same per address limit (net_connectrate), and an
+address that keeps hammering away after running dry is banned for
+net_floodban seconds.  A client that sets NET_CAP_CHALLENGE is first sent a
+CCREP_CHALLENGE cookie, and nothing is allocated for it until it sends
+that cookie back, which a spoofed source address never sees.  The cookie
+is a hash of the address, a secret and the time, so the server keeps no
+state for pending challenges.
+
+=============================================================================
+*/
+
+#define	RATESLOTS		256
+#define	QUERYBATCH		64		// most control packets read per call
+#define	FLOODSTRIKES	32		// requests turned away before a flood ban
+
+#define	CHALLENGEWINDOW	10		// seconds a cookie stays good for, at least
+
+typedef struct
 {
-	struct qsockaddr clientaddr;
-	struct qsockaddr newaddr;
-	int			newsock;
-	int			acceptsock;
-	qsocket_t	*sock;
-	qsocket_t	*s;
-	int			len;
-	int			command;
-	int			control;
-	int			ret;
+	struct qsockaddr	addr;
+	double				time;
+	float				tokens;
+	int					strikes;	// requests refused since the bucket was last full
+} ratesource_t;
 
-	acceptsock = dfunc.CheckNewConnections();
-	if (acceptsock == -1)
-		return NULL;
+static ratesource_t	querysources[RATESLOTS];
+static ratesource_t	connectsources[RATESLOTS];
 
-	SZ_Clear(&net_message);
+/*
+===================
+Datagram_RateLimit
 
-	len = dfunc.Read (acceptsock, net_message.data, net_message.maxsize, &clientaddr);
-	if (len < sizeof(int))
-		return NULL;
-	net_message.cursize = len;
+Token bucket per source address, allowing rate requests a second.
+Returns 0 if the request can go ahead, otherwise the number of requests
+refused since the bucket was last full.
+===================
+*/
+static int Datagram_RateLimit (ratesource_t *table, struct qsockaddr *addr, float rate)
+{
+	ratesource_t	*source;
+	unsigned		hash;
+	int				i;
 
-	MSG_BeginReading ();
-	control = BigLong(*((int *)net_message.data));
-	MSG_ReadLong();
-	if (control == -1)
-		return NULL;
-	if ((control & (~NETFLAG_LENGTH_MASK)) !=  NETFLAG_CTL)
-		return NULL;
-	if ((control & NETFLAG_LENGTH_MASK) != len)
-		return NULL;
+	if (rate <= 0)
+		return 0;
+
+	// the port is left out, so a browser can't dodge the limit by changing it
+	hash = 0;
+	for (i = 2; i < 6; i++)
+		hash = hash * 31 + addr->sa_data[i];
+	source = &table[hash % RATESLOTS];
+
+	if (source->time == 0 || dfunc.AddrCompare(addr, &source->addr) < 0)
+	{
+		source->addr = *addr;
+		source->tokens = rate;
+		source->strikes = 0;
+	}
+	else
+	{
+		source->tokens += (net_time - source->time) * rate;
+		if (source->tokens >= rate)
+		{
+			source->tokens = rate;
+			source->strikes = 0;
+		}
+	}
+	source->time = net_time;
+
+	if (source->tokens < 1)
+		return ++source->strikes;
+	source->tokens -= 1;
+	return 0;
+}
+
+/*
+===================
+Datagram_Cookie
+
+The challenge a client at addr has to send back, for the given time window.
+===================
+*/
+static int Datagram_Cookie (struct qsockaddr *addr, int window)
+{
+	unsigned		hash;
+	unsigned char	*p;
+	int				i;
+
+	hash = 2166136261u ^ cookiesecret;
+	p = (unsigned char *)addr;
+	for (i = 0; i < sizeof(struct qsockaddr); i++)
+		hash = (hash ^ p[i]) * 16777619u;
+	hash = (hash ^ window) * 16777619u;
+	hash = (hash ^ cookiesecret) * 16777619u;
+	return (int)hash;
+}
 
-	command = MSG_ReadByte();
+static qboolean Datagram_CheckCookie (struct qsockaddr *addr, int cookie)
+{
+	int		window;
+
+	window = (int)(net_time / CHALLENGEWINDOW);
+	return cookie == Datagram_Cookie(addr, window) || cookie == Datagram_Cookie(addr, window - 1);
+}
+
+static void Datagram_AnswerQuery (int acceptsock, int command, struct qsockaddr *clientaddr)
+{
+	struct qsockaddr	newaddr;
+	net_serverstate_t	*state;
+	queryplayer_t		*player;
+	queryrule_t			*rule;
+	char				*prevCvarName;
+	int					playerNumber;
+	int					i;
+
+	state = &net_serverstate;
+
+	// pick up the arguments before net_message is reused for the reply
+	playerNumber = 0;
+	prevCvarName = "";
 	if (command == CCREQ_SERVER_INFO)
 	{
 		if (Q_strcmp(MSG_ReadString(), "QUAKE") != 0)
-			return NULL;
+			return;
+	}
+	else if (command == CCREQ_PLAYER_INFO)
+		playerNumber = MSG_ReadByte();
+	else
+		prevCvarName = MSG_ReadString();
 
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
+	if (Datagram_RateLimit (querysources, clientaddr, net_queryrate.value))
+	{
+		queriesDropped++;
+		return;
+	}
+
+	SZ_Clear(&net_message);
+	// save space for the header, filled in later
+	MSG_WriteLong(&net_message, 0);
+
+	if (command == CCREQ_SERVER_INFO)
+	{
 		MSG_WriteByte(&net_message, CCREP_SERVER_INFO);
 		dfunc.GetSocketAddr(acceptsock, &newaddr);
 		MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
-		MSG_WriteString(&net_message, hostname.string);
-		MSG_WriteString(&net_message, sv.name);
-		MSG_WriteByte(&net_message, net_activeconnections);
-		MSG_WriteByte(&net_message, svs.maxclients);
+		MSG_WriteString(&net_message, state->hostname);
+		MSG_WriteString(&net_message, state->mapname);
+		MSG_WriteByte(&net_message, state->activeconnections);
+		MSG_WriteByte(&net_message, state->maxclients);
 		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-		SZ_Clear(&net_message);
-		return NULL;
+		queriesServed[0]++;
 	}
-
-	if (command == CCREQ_PLAYER_INFO)
+	else if (command == CCREQ_PLAYER_INFO)
 	{
-		int			playerNumber;
-		int			activeNumber;
-		int			clientNumber;
-		client_t	*client;
-
-		playerNumber = MSG_ReadByte();
-		activeNumber = -1;
-		for (clientNumber = 0, client = svs.clients; clientNumber < svs.maxclients; clientNumber++, client++)
+		if (playerNumber < 0 || playerNumber >= state->numplayers)
 		{
-			if (client->active)
-			{
-				activeNumber++;
-				if (activeNumber == playerNumber)
-					break;
-			}
+			SZ_Clear(&net_message);
+			return;
 		}
-		if (clientNumber == svs.maxclients)
-			return NULL;
+		player = &state->players[playerNumber];
 
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
 		MSG_WriteByte(&net_message, CCREP_PLAYER_INFO);
 		MSG_WriteByte(&net_message, playerNumber);
-		MSG_WriteString(&net_message, client->name);
-		MSG_WriteLong(&net_message, client->colors);
-		MSG_WriteLong(&net_message, (int)client->edict->v.frags);
-		MSG_WriteLong(&net_message, (int)(net_time - client->netconnection->connecttime));
-		MSG_WriteString(&net_message, client->netconnection->address);
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-		SZ_Clear(&net_message);
-
-		return NULL;
+		MSG_WriteString(&net_message, player->name);
+		MSG_WriteLong(&net_message, player->colors);
+		MSG_WriteLong(&net_message, player->frags);
+		MSG_WriteLong(&net_message, (int)(net_time - player->connecttime));
+		MSG_WriteString(&net_message, player->address);
+		queriesServed[1]++;
 	}
-
-	if (command == CCREQ_RULE_INFO)
+	else
 	{
-		char	*prevCvarName;
-		cvar_t	*var;
-
 		// find the search start location
-		prevCvarName = MSG_ReadString();
+		i = 0;
 		if (*prevCvarName)
 		{
-			var = Cvar_FindVar (prevCvarName);
-			if (!var)
-				return NULL;
-			var = var->next;
-		}
-		else
-			var = cvar_vars;
-
-		// search for the next server cvar
-		while (var)
-		{
-			if (var->server)
-				break;
-			var = var->next;
+			for (i = 0; i < state->numrules; i++)
+				if (Q_strcmp(state->rules[i].name, prevCvarName) == 0)
+					break;
+			if (i == state->numrules)
+			{
+				SZ_Clear(&net_message);
+				return;
+			}
+			i++;
 		}
 
-		// send the response
-
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
 		MSG_WriteByte(&net_message, CCREP_RULE_INFO);
-		if (var)
+		if (i < state->numrules)
 		{
-			MSG_WriteString(&net_message, var->name);
-			MSG_WriteString(&net_message, var->string);
+			rule = &state->rules[i];
+			MSG_WriteString(&net_message, rule->name);
+			MSG_WriteString(&net_message, rule->value);
 		}
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
-		SZ_Clear(&net_message);
-
-		return NULL;
+		queriesServed[2]++;
 	}
 
-	if (command != CCREQ_CONNECT)
-		return NULL;
+	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+	dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
+	SZ_Clear(&net_message);
+}
+
+/*
+===================
+Datagram_AcceptConnect
+
+Handles a CCREQ_CONNECT sitting in net_message.  Everything that can turn
+the request away is checked before a qsocket or a network socket is
+allocated for it.
+===================
+*/
+static qsocket_t *Datagram_AcceptConnect (int acceptsock, struct qsockaddr *clientaddr)
+{
+	struct qsockaddr newaddr;
+	int			newsock;
+	qsocket_t	*sock;
+	qsocket_t	*s;
+	int			ret;
+	int			caps;
+	int			cookie;
+	int			strikes;
+	qboolean	verified;
 
 	if (Q_strcmp(MSG_ReadString(), "QUAKE") != 0)
 		return NULL;
@@ -979,38 +1273,103 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 		MSG_WriteByte(&net_message, CCREP_REJECT);
 		MSG_WriteString(&net_message, "Incompatible version.\n");
 		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
 		SZ_Clear(&net_message);
 		return NULL;
 	}
 
+	// older clients don't send capabilities
+	caps = MSG_ReadByte();
+	if (msg_badread)
+		caps = 0;
+	cookie = 0;
+	if (caps & NET_CAP_CHALLENGE)
+	{
+		cookie = MSG_ReadLong();
+		if (msg_badread)
+			cookie = 0;
+	}
+	if (!net_compress.value)
+		caps &= ~NET_CAP_COMPRESS;
+
 #ifdef BAN_TEST
 	// check for a ban
-	if (clientaddr.sa_family == AF_INET)
+	if (clientaddr->sa_family == AF_INET)
 	{
 		unsigned long testAddr;
-		testAddr = ((struct sockaddr_in *)&clientaddr)->sin_addr.s_addr;
-		if ((testAddr & banMask) == banAddr)
+		testAddr = NET_InetAddr (clientaddr);
+		if (NET_IsBanned (testAddr))
 		{
+			connectsBanned++;
+			// flooders don't get anything to reflect at anybody
+			if ((testAddr & banMask) != banAddr)
+				return NULL;
+
 			SZ_Clear(&net_message);
 			// save space for the header, filled in later
 			MSG_WriteLong(&net_message, 0);
 			MSG_WriteByte(&net_message, CCREP_REJECT);
 			MSG_WriteString(&net_message, "You have been banned.\n");
 			*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-			dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+			dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
 			SZ_Clear(&net_message);
 			return NULL;
 		}
 	}
 #endif
 
+	// make sure the request really came from where it says before
+	// counting it against the address or allocating anything for it
+	verified = false;
+	if (caps & NET_CAP_CHALLENGE)
+	{
+		if (!Datagram_CheckCookie (clientaddr, cookie))
+		{
+			SZ_Clear(&net_message);
+			// save space for the header, filled in later
+			MSG_WriteLong(&net_message, 0);
+			MSG_WriteByte(&net_message, CCREP_CHALLENGE);
+			MSG_WriteLong(&net_message, Datagram_Cookie (clientaddr, (int)(net_time / CHALLENGEWINDOW)));
+			*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+			dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
+			SZ_Clear(&net_message);
+			challengesSent++;
+			return NULL;
+		}
+		verified = true;
+	}
+	else if (net_requirechallenge.value)
+	{
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_REJECT);
+		MSG_WriteString(&net_message, "Server requires a newer client.\n");
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
+		SZ_Clear(&net_message);
+		return NULL;
+	}
+
+	strikes = Datagram_RateLimit (connectsources, clientaddr, net_connectrate.value);
+	if (strikes)
+	{
+		connectsRateLimited++;
+#ifdef BAN_TEST
+		// anyone can put somebody else's address on a connect, so only
+		// a source that answered a challenge can earn a ban
+		if (verified && strikes >= FLOODSTRIKES && net_floodban.value > 0 && clientaddr->sa_family == AF_INET)
+			NET_FloodBan (NET_InetAddr (clientaddr));
+#endif
+		return NULL;
+	}
+
 	// see if this guy is already connected
 	for (s = net_activeSockets; s; s = s->next)
 	{
 		if (s->driver != net_driverlevel)
 			continue;
-		ret = dfunc.AddrCompare(&clientaddr, &s->addr);
+		ret = dfunc.AddrCompare(clientaddr, &s->addr);
 		if (ret >= 0)
 		{
 			// is this a duplicate connection reqeust?
@@ -1023,8 +1382,9 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 				MSG_WriteByte(&net_message, CCREP_ACCEPT);
 				dfunc.GetSocketAddr(s->socket, &newaddr);
 				MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+				MSG_WriteByte(&net_message, s->compress ? NET_CAP_COMPRESS : 0);
 				*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-				dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+				dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
 				SZ_Clear(&net_message);
 				return NULL;
 			}
@@ -1046,7 +1406,7 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 		MSG_WriteByte(&net_message, CCREP_REJECT);
 		MSG_WriteString(&net_message, "Server is full.\n");
 		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
 		SZ_Clear(&net_message);
 		return NULL;
 	}
@@ -1060,7 +1420,7 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 	}
 
 	// connect to the client
-	if (dfunc.Connect (newsock, &clientaddr) == -1)
+	if (dfunc.Connect (newsock, clientaddr) == -1)
 	{
 		dfunc.CloseSocket(newsock);
 		NET_FreeQSocket(sock);
@@ -1070,8 +1430,9 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 	// everything is allocated, just fill in the details
 	sock->socket = newsock;
 	sock->landriver = net_landriverlevel;
-	sock->addr = clientaddr;
-	Q_strcpy(sock->address, dfunc.AddrToString(&clientaddr));
+	sock->addr = *clientaddr;
+	sock->compress = (caps & NET_CAP_COMPRESS) != 0;
+	Q_strcpy(sock->address, dfunc.AddrToString(clientaddr));
 
 	// send him back the info about the server connection he has been allocated
 	SZ_Clear(&net_message);
@@ -1080,11 +1441,70 @@ static qsocket_t *_Datagram_CheckNewConnections (void)
 	MSG_WriteByte(&net_message, CCREP_ACCEPT);
 	dfunc.GetSocketAddr(newsock, &newaddr);
 	MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+	MSG_WriteByte(&net_message, caps & NET_CAP_COMPRESS);
 //	MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
 	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-	dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+	dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
 	SZ_Clear(&net_message);
 
+	connectsAccepted++;
+	return sock;
+}
+
+static qsocket_t *_Datagram_CheckNewConnections (void)
+{
+	struct qsockaddr clientaddr;
+	int			acceptsock;
+	qsocket_t	*sock;
+	int			len;
+	int			command;
+	int			control;
+	int			count;
+	double		start;
+
+	acceptsock = dfunc.CheckNewConnections();
+	if (acceptsock == -1)
+		return NULL;
+
+	// answer queries until a connect request turns up
+	for (count = 0; ; count++)
+	{
+		if (count == QUERYBATCH)
+			return NULL;
+
+		SZ_Clear(&net_message);
+
+		len = dfunc.Read (acceptsock, net_message.data, net_message.maxsize, &clientaddr);
+		if (len < (int)sizeof(int))
+			return NULL;
+		net_message.cursize = len;
+
+		MSG_BeginReading ();
+		control = BigLong(*((int *)net_message.data));
+		MSG_ReadLong();
+		if (control == -1)
+			continue;
+		if ((control & (~NETFLAG_LENGTH_MASK)) !=  NETFLAG_CTL)
+			continue;
+		if ((control & NETFLAG_LENGTH_MASK) != len)
+			continue;
+
+		command = MSG_ReadByte();
+		if (command == CCREQ_SERVER_INFO || command == CCREQ_PLAYER_INFO || command == CCREQ_RULE_INFO)
+		{
+			Datagram_AnswerQuery (acceptsock, command, &clientaddr);
+			continue;
+		}
+
+		if (command == CCREQ_CONNECT)
+			break;
+	}
+
+	start = Sys_FloatTime ();
+	sock = Datagram_AcceptConnect (acceptsock, &clientaddr);
+	connectTime += Sys_FloatTime () - start;
+	connectAttempts++;
+
 	return sock;
 }
 
@@ -1211,6 +1631,21 @@ void Datagram_SearchForHosts (qboolean xmit)
 }
 
 
+static void Datagram_SendConnect (int sock, struct qsockaddr *sendaddr, int cookie)
+{
+	SZ_Clear(&net_message);
+	// save space for the header, filled in later
+	MSG_WriteLong(&net_message, 0);
+	MSG_WriteByte(&net_message, CCREQ_CONNECT);
+	MSG_WriteString(&net_message, "QUAKE");
+	MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+	MSG_WriteByte(&net_message, NET_CAP_CHALLENGE | (net_compress.value ? NET_CAP_COMPRESS : 0));
+	MSG_WriteLong(&net_message, cookie);
+	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+	dfunc.Write (sock, net_message.data, net_message.cursize, sendaddr);
+	SZ_Clear(&net_message);
+}
+
 static qsocket_t *_Datagram_Connect (char *host)
 {
 	struct qsockaddr sendaddr;
@@ -1221,6 +1656,7 @@ static qsocket_t *_Datagram_Connect (char *host)
 	int			reps;
 	double		start_time;
 	int			control;
+	int			cookie;
 	char		*reason;
 
 	// see if we can resolve the host name
@@ -1244,18 +1680,11 @@ static qsocket_t *_Datagram_Connect (char *host)
 	// send the connection request
 	Con_Printf("trying...\n"); SCR_UpdateScreen ();
 	start_time = net_time;
+	cookie = 0;
 
 	for (reps = 0; reps < 3; reps++)
 	{
-		SZ_Clear(&net_message);
-		// save space for the header, filled in later
-		MSG_WriteLong(&net_message, 0);
-		MSG_WriteByte(&net_message, CCREQ_CONNECT);
-		MSG_WriteString(&net_message, "QUAKE");
-		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
-		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-		dfunc.Write (newsock, net_message.data, net_message.cursize, &sendaddr);
-		SZ_Clear(&net_message);
+		Datagram_SendConnect (newsock, &sendaddr, cookie);
 		do
 		{
 			ret = dfunc.Read (newsock, net_message.data, net_message.maxsize, &readaddr);
@@ -1301,6 +1730,16 @@ static qsocket_t *_Datagram_Connect (char *host)
 					ret = 0;
 					continue;
 				}
+
+				// prove we're really at this address and go again
+				if (net_message.data[msg_readcount] == CCREP_CHALLENGE)
+				{
+					MSG_ReadByte();
+					cookie = MSG_ReadLong();
+					Datagram_SendConnect (newsock, &sendaddr, cookie);
+					ret = 0;
+					continue;
+				}
 			}
 		}
 		while (ret == 0 && (SetNetTime() - start_time) < 2.5);
@@ -1339,6 +1778,11 @@ static qsocket_t *_Datagram_Connect (char *host)
 	{
 		Q_memcpy(&sock->addr, &sendaddr, sizeof(struct qsockaddr));
 		dfunc.SetSocketPort (&sock->addr, MSG_ReadLong());
+
+		// older servers don't send capabilities
+		ret = MSG_ReadByte();
+		if (!msg_badread && (ret & NET_CAP_COMPRESS))
+			sock->compress = true;
 	}
 	else
 	{
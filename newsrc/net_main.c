@@ -65,6 +65,7 @@ int unreliableMessagesReceived = 0;
 
 cvar_t	net_messagetimeout = {"net_messagetimeout","300"};
 cvar_t	hostname = {"hostname", "UNNAMED"};
+cvar_t	net_compress = {"net_compress", "1"};	// offer/accept compressed reliable messages
 
 qboolean	configRestored = false;
 cvar_t	config_com_port = {"_config_com_port", "0x3f8", true};
@@ -133,6 +134,7 @@ qsocket_t *NET_NewQSocket (void)
 	sock->driverdata = NULL;
 	sock->canSend = true;
 	sock->sendNext = false;
+	sock->compress = false;
 	sock->lastMessageTime = net_time;
 	sock->ackSequence = 0;
 	sock->sendSequence = 0;
@@ -441,6 +443,67 @@ JustDoIt:
 }
 
 
+/*
+===================
+NET_PublishServerState
+
+Called by the server once a frame.  The copy is only redone when
+net_serverstatechanged is set (map, clients coming and going, server
+cvars), or every NET_PUBLISHINTERVAL seconds for frags and names.
+===================
+*/
+#define	NET_PUBLISHINTERVAL	1.0
+
+net_serverstate_t	net_serverstate;
+qboolean			net_serverstatechanged = true;
+
+void NET_PublishServerState (void)
+{
+	static double		lastpublish;
+	net_serverstate_t	*state;
+	queryplayer_t		*player;
+	queryrule_t			*rule;
+	client_t			*client;
+	cvar_t				*var;
+	int					i;
+
+	if (!net_serverstatechanged && realtime - lastpublish < NET_PUBLISHINTERVAL)
+		return;
+	net_serverstatechanged = false;
+	lastpublish = realtime;
+
+	state = &net_serverstate;
+
+	Q_strncpy (state->hostname, hostname.string, sizeof(state->hostname) - 1);
+	Q_strncpy (state->mapname, sv.name, sizeof(state->mapname) - 1);
+	state->activeconnections = net_activeconnections;
+	state->maxclients = svs.maxclients;
+
+	state->numplayers = 0;
+	for (i = 0, client = svs.clients; i < svs.maxclients; i++, client++)
+	{
+		if (!client->active)
+			continue;
+		player = &state->players[state->numplayers++];
+		Q_strncpy (player->name, client->name, sizeof(player->name) - 1);
+		player->colors = client->colors;
+		player->frags = (int)client->edict->v.frags;
+		player->connecttime = client->netconnection->connecttime;
+		Q_strncpy (player->address, client->netconnection->address, sizeof(player->address) - 1);
+	}
+
+	state->numrules = 0;
+	for (var = cvar_vars; var && state->numrules < MAX_QUERYRULES; var = var->next)
+	{
+		if (!var->server)
+			continue;
+		rule = &state->rules[state->numrules++];
+		Q_strncpy (rule->name, var->name, sizeof(rule->name) - 1);
+		Q_strncpy (rule->value, var->string, sizeof(rule->value) - 1);
+	}
+}
+
+
 /*
 ===================
 NET_CheckNewConnections
@@ -852,6 +915,7 @@ void NET_Init (void)
 
 	Cvar_RegisterVariable (&net_messagetimeout);
 	Cvar_RegisterVariable (&hostname);
+	Cvar_RegisterVariable (&net_compress);
 	Cvar_RegisterVariable (&config_com_port);
 	Cvar_RegisterVariable (&config_com_irq);
 	Cvar_RegisterVariable (&config_com_baud);
@@ -34,6 +34,8 @@ int pr_edict_size;  // in bytes
 unsigned short pr_crc;
 
 ddef_t* ED_FieldAtOfs(int ofs);
+static void ED_LiveView(edsnapshot_t* view);
+static char* ED_ValueString(edsnapshot_t* view, etype_t type, eval_t* val, char* line);
 qboolean ED_ParseEpair(void* dest_start, ddef_t* key, char* raw_value);
 
 cvar_t nomonsters = {"nomonsters", "0"};
@@ -341,48 +343,11 @@ Easier to parse than PR_ValueString
 */
 char* PR_UglyValueString(etype_t type, eval_t* val) {
 	static char line[256];
-	ddef_t* def;
-	dfunction_t* f;
-
-	type &= ~DEF_SAVEGLOBAL;
-
-	switch (type) {
-		case ev_string:
-			sprintf(line, "%s", pr_strings + val->string);
-			break;
-
-		case ev_entity:
-			sprintf(line, "%i", NUM_FOR_EDICT(PROG_TO_EDICT(val->edict)));
-			break;
-
-		case ev_function:
-			f = pr_functions + val->function;
-			sprintf(line, "%s", pr_strings + f->s_name);
-			break;
-
-		case ev_field:
-			def = ED_FieldAtOfs(val->_int);
-			sprintf(line, "%s", pr_strings + def->s_name);
-			break;
-
-		case ev_void:
-			sprintf(line, "void");
-			break;
+	edsnapshot_t live;
 
-		case ev_float:
-			sprintf(line, "%f", val->_float);
-			break;
+	ED_LiveView(&live);
 
-		case ev_vector:
-			sprintf(line, "%f %f %f", val->vector[0], val->vector[1], val->vector[2]);
-			break;
-
-		default:
-			sprintf(line, "bad type %i", type);
-			break;
-	}
-
-	return line;
+	return ED_ValueString(&live, type, val, line);
 }
 
 /*
@@ -585,14 +550,99 @@ void ED_Count(void) {
 	Con_Printf("step:       %3i\n", step);
 }
 
+/*
+==============================================================================
+
+					SAVEGAME SNAPSHOTS
+
+Savegames are written from an edsnapshot_t rather than from the live
+progs, so the slow part (formatting every field of every edict) can run
+on a worker thread while the server keeps running.  The live view just
+points at the progs; a snapshot owns copies of everything it reads.
+==============================================================================
+*/
+
 /*
 =============
-ED_Write
+ED_LiveView
+=============
+*/
+static void ED_LiveView(edsnapshot_t* view) {
+	view->strings = pr_strings;
+	view->functions = pr_functions;
+	view->fielddefs = pr_fielddefs;
+	view->numfielddefs = progs->numfielddefs;
+	view->globaldefs = pr_globaldefs;
+	view->numglobaldefs = progs->numglobaldefs;
+	view->globals = pr_globals;
+	view->edicts = (byte*)sv.edicts;
+	view->num_edicts = sv.num_edicts;
+	view->edict_size = pr_edict_size;
+}
 
-For savegames
+/*
+=============
+ED_ValueString
+
+PR_UglyValueString against a view, into a caller supplied line so worker
+threads can use it
 =============
 */
-void ED_Write(FILE* save_file, edict_t* ed) {
+static char* ED_ValueString(edsnapshot_t* view, etype_t type, eval_t* val, char* line) {
+	type &= ~DEF_SAVEGLOBAL;
+
+	switch (type) {
+		case ev_string:
+			sprintf(line, "%s", view->strings + val->string);
+			break;
+
+		case ev_entity:
+			sprintf(line, "%i", val->edict / view->edict_size);
+			break;
+
+		case ev_function:
+			sprintf(line, "%s", view->strings + view->functions[val->function].s_name);
+			break;
+
+		case ev_field:
+			line[0] = 0;
+
+			for (int i = 0; i < view->numfielddefs; i++) {
+				if (view->fielddefs[i].ofs == val->_int) {
+					sprintf(line, "%s", view->strings + view->fielddefs[i].s_name);
+					break;
+				}
+			}
+			break;
+
+		case ev_void:
+			sprintf(line, "void");
+			break;
+
+		case ev_float:
+			sprintf(line, "%f", val->_float);
+			break;
+
+		case ev_vector:
+			sprintf(line, "%f %f %f", val->vector[0], val->vector[1], val->vector[2]);
+			break;
+
+		default:
+			sprintf(line, "bad type %i", type);
+			break;
+	}
+
+	return line;
+}
+
+/*
+=============
+ED_ViewWrite
+=============
+*/
+static void ED_ViewWrite(FILE* save_file, edsnapshot_t* view, edict_t* ed) {
+	char line[256];
+
 	fprintf(save_file, "{\n");
 
 	if (ed->free) {
@@ -600,9 +650,9 @@ void ED_Write(FILE* save_file, edict_t* ed) {
 		return;
 	}
 
-	for (int i = 1; i < progs->numfielddefs; i++) {
-		ddef_t* d = &pr_fielddefs[i];
-		char* name = pr_strings + d->s_name;
+	for (int i = 1; i < view->numfielddefs; i++) {
+		ddef_t* d = &view->fielddefs[i];
+		char* name = view->strings + d->s_name;
 
 		if (name[strlen(name)-2] == '_') {
 			// skip _x, _y, _z vars
@@ -626,31 +676,26 @@ void ED_Write(FILE* save_file, edict_t* ed) {
 		}
 
 		fprintf(save_file, "\"%s\" ", name);
-		fprintf(save_file, "\"%s\"\n", PR_UglyValueString(d->type, (eval_t*)v));
+		fprintf(save_file, "\"%s\"\n", ED_ValueString(view, d->type, (eval_t*)v, line));
 	}
 
 	fprintf(save_file, "}\n");
 }
 
 /*
-==============================================================================
-
-					ARCHIVING GLOBALS
+=============
+ED_ViewWriteGlobals
 
 FIXME: need to tag constants, doesn't really work
-==============================================================================
-*/
-
-/*
-=============
-ED_WriteGlobals
 =============
 */
-void ED_WriteGlobals(FILE* save_file) {
+static void ED_ViewWriteGlobals(FILE* save_file, edsnapshot_t* view) {
+	char line[256];
+
 	fprintf(save_file, "{\n");
 
-	for (int i = 0; i < progs->numglobaldefs; i++) {
-		ddef_t* def = &pr_globaldefs[i];
+	for (int i = 0; i < view->numglobaldefs; i++) {
+		ddef_t* def = &view->globaldefs[i];
 		int type = def->type;
 
 		if (!(def->type & DEF_SAVEGLOBAL)) {
@@ -665,15 +710,173 @@ void ED_WriteGlobals(FILE* save_file) {
 			continue;
 		}
 
-		char* name = pr_strings + def->s_name;
+		char* name = view->strings + def->s_name;
 
 		fprintf(save_file, "\"%s\" ", name);
-		fprintf(save_file, "\"%s\"\n", PR_UglyValueString(type, (eval_t*)&pr_globals[def->ofs]));
+		fprintf(save_file, "\"%s\"\n", ED_ValueString(view, type, (eval_t*)&view->globals[def->ofs], line));
 	}
 
 	fprintf(save_file, "}\n");
 }
 
+/*
+=============
+ED_Write
+
+For savegames
+=============
+*/
+void ED_Write(FILE* save_file, edict_t* ed) {
+	edsnapshot_t live;
+
+	ED_LiveView(&live);
+	ED_ViewWrite(save_file, &live, ed);
+}
+
+/*
+=============
+ED_WriteGlobals
+=============
+*/
+void ED_WriteGlobals(FILE* save_file) {
+	edsnapshot_t live;
+
+	ED_LiveView(&live);
+	ED_ViewWriteGlobals(save_file, &live);
+}
+
+/*
+=============
+ED_SnapshotString
+
+Strings made by ED_NewString or pointing at builtin buffers live outside
+the progs string table and may change or be freed once the server moves
+on, so copy them after the table and repoint the value at the copy
+=============
+*/
+static void ED_SnapshotString(edsnapshot_t* snap, string_t* value, int* extra_size) {
+	if (*value >= 0 && *value < progs->numstrings) {
+		return;
+	}
+
+	char* s = pr_strings + *value;
+	int len = strlen(s) + 1;
+
+	if (progs->numstrings + snap->extra + len > *extra_size) {
+		*extra_size = (progs->numstrings + snap->extra + len) * 2;
+		snap->strings = realloc(snap->strings, *extra_size);
+
+		if (!snap->strings) {
+			Sys_Error("ED_Snapshot: out of memory");
+		}
+	}
+
+	*value = progs->numstrings + snap->extra;
+	memcpy(snap->strings + *value, s, len);
+	snap->extra += len;
+}
+
+/*
+=============
+ED_Snapshot
+
+Copies everything a savegame needs from the progs and the edicts.  This
+is a handful of memcpys, much cheaper than formatting the text, and the
+result is safe to write out from another thread.
+=============
+*/
+edsnapshot_t* ED_Snapshot(void) {
+	edsnapshot_t* snap = calloc(1, sizeof(*snap));
+	int fieldsize = progs->numfielddefs * sizeof(ddef_t);
+	int globaldefsize = progs->numglobaldefs * sizeof(ddef_t);
+	int functionsize = progs->numfunctions * sizeof(dfunction_t);
+	int globalsize = progs->numglobals * 4;
+	int edictsize = sv.num_edicts * pr_edict_size;
+	int stringsize = progs->numstrings;
+
+	if (!snap) {
+		Sys_Error("ED_Snapshot: out of memory");
+	}
+
+	snap->block = malloc(fieldsize + globaldefsize + functionsize + globalsize + edictsize);
+	snap->strings = malloc(stringsize);
+
+	if (!snap->block || !snap->strings) {
+		Sys_Error("ED_Snapshot: out of memory");
+	}
+
+	byte* b = snap->block;
+
+	snap->fielddefs = memcpy(b, pr_fielddefs, fieldsize);
+	snap->globaldefs = memcpy(b += fieldsize, pr_globaldefs, globaldefsize);
+	snap->functions = memcpy(b += globaldefsize, pr_functions, functionsize);
+	snap->globals = memcpy(b += functionsize, pr_globals, globalsize);
+	snap->edicts = memcpy(b += globalsize, sv.edicts, edictsize);
+	memcpy(snap->strings, pr_strings, progs->numstrings);
+
+	snap->numfielddefs = progs->numfielddefs;
+	snap->numglobaldefs = progs->numglobaldefs;
+	snap->num_edicts = sv.num_edicts;
+	snap->edict_size = pr_edict_size;
+
+	// only string values can point outside the copy
+	for (int i = 0; i < snap->numglobaldefs; i++) {
+		ddef_t* def = &snap->globaldefs[i];
+
+		if ((def->type & ~DEF_SAVEGLOBAL) == ev_string) {
+			ED_SnapshotString(snap, (string_t*)&snap->globals[def->ofs], &stringsize);
+		}
+	}
+
+	for (int e = 0; e < snap->num_edicts; e++) {
+		edict_t* ed = (edict_t*)(snap->edicts + e * snap->edict_size);
+
+		if (ed->free) {
+			continue;
+		}
+
+		for (int i = 1; i < snap->numfielddefs; i++) {
+			ddef_t* d = &snap->fielddefs[i];
+
+			if ((d->type & ~DEF_SAVEGLOBAL) == ev_string) {
+				ED_SnapshotString(snap, (string_t*)((int*)&ed->v + d->ofs), &stringsize);
+			}
+		}
+	}
+
+	return snap;
+}
+
+/*
+=============
+ED_WriteSnapshot
+
+The globals and every edict, exactly as ED_WriteGlobals and ED_Write
+would have written them when the snapshot was taken.  Safe to call from
+a worker thread.
+=============
+*/
+void ED_WriteSnapshot(FILE* save_file, edsnapshot_t* snap) {
+	ED_ViewWriteGlobals(save_file, snap);
+
+	for (int e = 0; e < snap->num_edicts; e++) {
+		ED_ViewWrite(save_file, snap, (edict_t*)(snap->edicts + e * snap->edict_size));
+	}
+
+	fflush(save_file);
+}
+
+/*
+=============
+ED_FreeSnapshot
+=============
+*/
+void ED_FreeSnapshot(edsnapshot_t* snap) {
+	free(snap->strings);
+	free(snap->block);
+	free(snap);
+}
+
 /*
 =============
 ED_ParseGlobals
@@ -84,6 +84,28 @@ void ED_Write(FILE* f, edict_t* ed);
 char* ED_ParseEdict(char* data, edict_t* ent);
 
 void ED_WriteGlobals(FILE* f);
+
+// a copy of the globals and edicts that can be written out later, from
+// any thread, as ED_WriteGlobals and ED_Write would have written them
+typedef struct {
+	char* strings;  // progs strings, then copies of any others
+	int extra;  // bytes of copied strings after the progs strings
+	dfunction_t* functions;
+	ddef_t* fielddefs;
+	int numfielddefs;
+	ddef_t* globaldefs;
+	int numglobaldefs;
+	float* globals;
+	byte* edicts;
+	int num_edicts;
+	int edict_size;
+	void* block;  // holds everything but the strings
+} edsnapshot_t;
+
+edsnapshot_t* ED_Snapshot(void);
+void ED_WriteSnapshot(FILE* f, edsnapshot_t* snap);
+void ED_FreeSnapshot(edsnapshot_t* snap);
+
 void ED_ParseGlobals(char* data);
 
 void ED_LoadFromFile(char* data);
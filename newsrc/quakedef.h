@@ -216,6 +216,8 @@ void VID_UnlockBuffer(void);
 #include "vid.h"
 #include "sys.h"
 #include "zone.h"
+#include "jobs.h"
+#include "timing.h"
 #include "mathlib.h"
 
 typedef struct {
@@ -257,6 +259,7 @@ typedef struct {
 #include "view.h"
 #include "menu.h"
 #include "crc.h"
+#include "lz.h"
 
 #ifdef GLQUAKE
 #include "glquake.h"
@@ -275,8 +278,15 @@ typedef struct {
 	char **argv;
 	void *membase;
 	int memsize;
+	int memreserve;  // address space reserved at membase, 0 if all of memsize is committed
 } quakeparms_t;
 
+// how much the hunk can grow to by default
+#define DEFAULT_MEMRESERVE (512 * 1024 * 1024)
+
+// hunk offsets are ints, so this is as big as it can get
+#define MAX_MEMSIZE 0x7ff00000
+
 
 //=============================================================================
 
@@ -306,6 +316,8 @@ extern double realtime;
 void Host_ClearMemory(void);
 void Host_ServerFrame(void);
 void Host_InitCommands(void);
+void Host_SaveFrame(void);
+void Host_FinishSave(void);
 void Host_Init(quakeparms_t *parms);
 void Host_Shutdown(void);
 void Host_Error(char *error, ...);
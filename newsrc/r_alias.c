@@ -24,6 +24,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "d_local.h"	// FIXME: shouldn't be needed (is needed for patch
 						// right now, but that should move)
 
+#if !id386 && (defined(__x86_64__) || defined(__i386__))
+#define R_AVX2
+#include <immintrin.h>
+#endif
+
 #define LIGHT_MIN	5		// lowest light value we'll allow, to avoid the
 							//  need for inner-loop light clamping
 
@@ -451,6 +456,107 @@ void R_AliasTransformFinalVert (finalvert_t *fv, auxvert_t *av,
 
 #if	!id386
 
+#ifdef R_AVX2
+/*
+================
+R_AliasTransformAndProjectFinalVerts_AVX2
+
+Eight verts at a time, with the operations in the same order and
+precision as the C loop below so the results are bit for bit the same.
+1/z is divided in double like the C version's 1.0 constant makes it.
+Returns how many verts were done, the C loop does the rest.
+================
+*/
+__attribute__((target("avx2")))
+static int R_AliasTransformAndProjectFinalVerts_AVX2 (finalvert_t *fv,
+	trivertx_t *pverts, stvert_t *pstverts, int numverts)
+{
+	__m256i		raw, bytemask, lightindex, zero;
+	__m256		x, y, z, dot, zi, nx, ny, nz, lightcos, shade;
+	__m128d		one;
+	__m256i		u, v, ziint, light;
+	int			ou[8], ov[8], ozi[8], olight[8];
+	int			i, j;
+	float		*t0, *t1, *t2;
+
+	t0 = aliastransform[0];
+	t1 = aliastransform[1];
+	t2 = aliastransform[2];
+
+	bytemask = _mm256_set1_epi32 (0xff);
+	zero = _mm256_setzero_si256 ();
+	one = _mm_set1_pd (1.0);
+
+	for (i=0 ; i+8<=numverts ; i+=8, pverts+=8)
+	{
+		raw = _mm256_loadu_si256 ((__m256i *)pverts);
+		x = _mm256_cvtepi32_ps (_mm256_and_si256 (raw, bytemask));
+		y = _mm256_cvtepi32_ps (_mm256_and_si256 (_mm256_srli_epi32 (raw, 8), bytemask));
+		z = _mm256_cvtepi32_ps (_mm256_and_si256 (_mm256_srli_epi32 (raw, 16), bytemask));
+		lightindex = _mm256_srli_epi32 (raw, 24);
+
+	// transform and project
+#define ALIASDOT(t)	_mm256_add_ps (_mm256_add_ps (_mm256_add_ps ( \
+			_mm256_mul_ps (x, _mm256_set1_ps (t[0])), \
+			_mm256_mul_ps (y, _mm256_set1_ps (t[1]))), \
+			_mm256_mul_ps (z, _mm256_set1_ps (t[2]))), \
+			_mm256_set1_ps (t[3]))
+
+		dot = ALIASDOT(t2);
+		zi = _mm256_set_m128 (
+				_mm256_cvtpd_ps (_mm256_div_pd (_mm256_set_m128d (one, one),
+						_mm256_cvtps_pd (_mm256_extractf128_ps (dot, 1)))),
+				_mm256_cvtpd_ps (_mm256_div_pd (_mm256_set_m128d (one, one),
+						_mm256_cvtps_pd (_mm256_castps256_ps128 (dot)))));
+		ziint = _mm256_cvttps_epi32 (zi);
+
+		dot = ALIASDOT(t0);
+		u = _mm256_cvttps_epi32 (_mm256_add_ps (_mm256_mul_ps (dot, zi),
+				_mm256_set1_ps (aliasxcenter)));
+		dot = ALIASDOT(t1);
+		v = _mm256_cvttps_epi32 (_mm256_add_ps (_mm256_mul_ps (dot, zi),
+				_mm256_set1_ps (aliasycenter)));
+#undef ALIASDOT
+
+	// lighting
+		lightindex = _mm256_add_epi32 (lightindex, _mm256_add_epi32 (lightindex, lightindex));
+		nx = _mm256_i32gather_ps (&r_avertexnormals[0][0], lightindex, 4);
+		ny = _mm256_i32gather_ps (&r_avertexnormals[0][1], lightindex, 4);
+		nz = _mm256_i32gather_ps (&r_avertexnormals[0][2], lightindex, 4);
+		lightcos = _mm256_add_ps (_mm256_add_ps (
+				_mm256_mul_ps (nx, _mm256_set1_ps (r_plightvec[0])),
+				_mm256_mul_ps (ny, _mm256_set1_ps (r_plightvec[1]))),
+				_mm256_mul_ps (nz, _mm256_set1_ps (r_plightvec[2])));
+
+	// only the verts facing away from the light get shaded, and only
+	// those can go below zero
+		shade = _mm256_and_ps (_mm256_mul_ps (_mm256_set1_ps (r_shadelight), lightcos),
+				_mm256_cmp_ps (lightcos, _mm256_setzero_ps (), _CMP_LT_OQ));
+		light = _mm256_add_epi32 (_mm256_set1_epi32 (r_ambientlight),
+				_mm256_cvttps_epi32 (shade));
+		light = _mm256_max_epi32 (light, zero);
+
+		_mm256_storeu_si256 ((__m256i *)ou, u);
+		_mm256_storeu_si256 ((__m256i *)ov, v);
+		_mm256_storeu_si256 ((__m256i *)ozi, ziint);
+		_mm256_storeu_si256 ((__m256i *)olight, light);
+
+		for (j=0 ; j<8 ; j++, fv++, pstverts++)
+		{
+			fv->v[0] = ou[j];
+			fv->v[1] = ov[j];
+			fv->v[2] = pstverts->s;
+			fv->v[3] = pstverts->t;
+			fv->v[4] = olight[j];
+			fv->v[5] = ozi[j];
+			fv->flags = pstverts->onseam;
+		}
+	}
+
+	return i;
+}
+#endif
+
 /*
 ================
 R_AliasTransformAndProjectFinalVerts
@@ -463,8 +569,20 @@ void R_AliasTransformAndProjectFinalVerts (finalvert_t *fv, stvert_t *pstverts)
 	trivertx_t	*pverts;
 
 	pverts = r_apverts;
+	i = 0;
 
-	for (i=0 ; i<r_anumverts ; i++, fv++, pverts++, pstverts++)
+#ifdef R_AVX2
+	if (r_simd.value && r_haveavx2)
+	{
+		i = R_AliasTransformAndProjectFinalVerts_AVX2 (fv, pverts, pstverts,
+				r_anumverts);
+		fv += i;
+		pverts += i;
+		pstverts += i;
+	}
+#endif
+
+	for ( ; i<r_anumverts ; i++, fv++, pverts++, pstverts++)
 	{
 	// transform and project
 		zi = 1.0 / (DotProduct(pverts->v, aliastransform[2]) +
@@ -750,3 +868,194 @@ void R_AliasDrawModel (alight_t *plighting)
 	else
 		R_AliasPreparePoints ();
 }
+
+/*
+================
+R_AliasBenchPass
+
+Draws the bench triangles into the view count times, with the screen and
+z buffer cleared first
+================
+*/
+static double R_AliasBenchPass (int count)
+{
+	int		i, y, width;
+	double	start;
+
+	width = r_refdef.vrectright - r_refdef.vrect.x;
+	for (y=r_refdef.vrect.y ; y<r_refdef.vrectbottom ; y++)
+	{
+		memset (d_viewbuffer + d_scantable[y] + r_refdef.vrect.x, 0, width);
+		memset (zspantable[y] + r_refdef.vrect.x, 0, width * sizeof(short));
+	}
+
+	start = Sys_FloatTime ();
+	for (i=0 ; i<count ; i++)
+		D_PolysetDraw ();
+	return Sys_FloatTime () - start;
+}
+
+/*
+================
+R_AliasBenchSave
+================
+*/
+static void R_AliasBenchSave (byte *pixels, short *zbuf)
+{
+	int		y, width;
+
+	width = r_refdef.vrectright - r_refdef.vrect.x;
+	for (y=r_refdef.vrect.y ; y<r_refdef.vrectbottom ; y++)
+	{
+		memcpy (pixels, d_viewbuffer + d_scantable[y] + r_refdef.vrect.x, width);
+		memcpy (zbuf, zspantable[y] + r_refdef.vrect.x, width * sizeof(short));
+		pixels += width;
+		zbuf += width;
+	}
+}
+
+/*
+================
+R_AliasBench_f
+
+aliasbench [count]
+
+A crowd of random verts and large random triangles over the whole view,
+transformed and drawn with the C and the vector kernels.  Both have to
+give the same finalverts and the same pixels and z.  The view is drawn
+over; the next frame puts it back.
+================
+*/
+#define	BENCH_VERTS		1024
+#define	BENCH_TRIS		256
+#define	BENCH_SKIN		256
+
+void R_AliasBench_f (void)
+{
+	static trivertx_t	verts[BENCH_VERTS];
+	static stvert_t		stverts[BENCH_VERTS];
+	static finalvert_t	fverts[2][BENCH_VERTS];
+	static mtriangle_t	tris[BENCH_TRIS];
+	static byte			skinbuf[4 + BENCH_SKIN*BENCH_SKIN];
+	byte				*pixels[2];
+	short				*zbuf[2];
+	int					i, j, n, count, width, height, size;
+	float				oldsimd;
+	double				start, time[2];
+
+	count = 200;
+	if (Cmd_Argc () > 1)
+		count = Q_atoi (Cmd_Argv (1));
+	if (count < 1)
+		count = 1;
+
+	if (!r_haveavx2)
+	{
+		Con_Printf ("no vector kernels for this cpu\n");
+		return;
+	}
+	if (!d_viewbuffer || !cl.worldmodel)
+	{
+		Con_Printf ("aliasbench needs a map loaded\n");
+		return;
+	}
+
+	oldsimd = r_simd.value;
+
+// verts as seen from a hundred or so units away
+	for (i=0 ; i<BENCH_VERTS ; i++)
+	{
+		for (j=0 ; j<3 ; j++)
+			verts[i].v[j] = rand ();
+		verts[i].lightnormalindex = rand () % NUMVERTEXNORMALS;
+		stverts[i].onseam = rand () & ALIAS_ONSEAM;
+		stverts[i].s = rand () & 0xffff;
+		stverts[i].t = rand () & 0xffff;
+	}
+
+	for (j=0 ; j<3 ; j++)
+	{
+		aliastransform[0][j] = (rand () % 200 - 100) * 0.01 / ((float)0x8000 * 0x10000);
+		aliastransform[1][j] = (rand () % 200 - 100) * 0.01 / ((float)0x8000 * 0x10000);
+		aliastransform[2][j] = (rand () % 100) * 0.001 / ((float)0x8000 * 0x10000);
+		r_plightvec[j] = (rand () % 200 - 100) * 0.01;
+	}
+	aliastransform[0][3] = 0;
+	aliastransform[1][3] = 0;
+	aliastransform[2][3] = 100 / ((float)0x8000 * 0x10000);
+	VectorNormalize (r_plightvec);
+	r_ambientlight = 64;
+	r_shadelight = 96;
+
+	r_apverts = verts;
+	r_anumverts = BENCH_VERTS;
+
+	memset (fverts, 0, sizeof(fverts));
+	for (n=0 ; n<2 ; n++)
+	{
+		Cvar_SetValue ("r_simd", n);
+		start = Sys_FloatTime ();
+		for (i=0 ; i<count ; i++)
+			R_AliasTransformAndProjectFinalVerts (fverts[n], stverts);
+		time[n] = Sys_FloatTime () - start;
+	}
+
+	Con_Printf ("verts: %6.1f ns c %6.1f ns avx2 per vert, %s\n",
+			time[0] * 1e9 / (count * BENCH_VERTS),
+			time[1] * 1e9 / (count * BENCH_VERTS),
+			memcmp (fverts[0], fverts[1], sizeof(fverts[0])) ? "MISMATCH" : "identical");
+
+// triangles anywhere in the view, half of them facing away
+	width = r_refdef.vrectright - r_refdef.vrect.x;
+	height = r_refdef.vrectbottom - r_refdef.vrect.y;
+
+	for (i=0 ; i<BENCH_VERTS ; i++)
+	{
+		fverts[0][i].v[0] = r_refdef.vrect.x + rand () % width;
+		fverts[0][i].v[1] = r_refdef.vrect.y + rand () % height;
+		fverts[0][i].v[2] = (rand () % BENCH_SKIN) << 16;
+		fverts[0][i].v[3] = (rand () % BENCH_SKIN) << 16;
+		fverts[0][i].v[4] = (rand () % VID_GRADES) << 8;
+		fverts[0][i].v[5] = (rand () & 0x7fff) << 16;
+		fverts[0][i].flags = 0;
+	}
+	for (i=0 ; i<BENCH_TRIS ; i++)
+	{
+		tris[i].facesfront = 1;
+		for (j=0 ; j<3 ; j++)
+			tris[i].vertindex[j] = rand () % BENCH_VERTS;
+	}
+	for (i=0 ; i<sizeof(skinbuf) ; i++)
+		skinbuf[i] = rand ();
+
+	r_affinetridesc.pfinalverts = fverts[0];
+	r_affinetridesc.ptriangles = tris;
+	r_affinetridesc.numtriangles = BENCH_TRIS;
+	r_affinetridesc.drawtype = 0;
+	r_affinetridesc.pskin = skinbuf + 4;
+	r_affinetridesc.skinwidth = BENCH_SKIN;
+	r_affinetridesc.skinheight = BENCH_SKIN;
+	r_affinetridesc.seamfixupX16 = 0;
+	acolormap = vid.colormap;
+
+	size = width * height;
+	pixels[0] = Hunk_TempAlloc (size * 2 * (1 + sizeof(short)));
+	pixels[1] = pixels[0] + size;
+	zbuf[0] = (short *)(pixels[1] + size);
+	zbuf[1] = zbuf[0] + size;
+
+	for (n=0 ; n<2 ; n++)
+	{
+		Cvar_SetValue ("r_simd", n);
+		time[n] = R_AliasBenchPass (count);
+		R_AliasBenchSave (pixels[n], zbuf[n]);
+	}
+
+	Con_Printf ("triangles: %6.1f us c %6.1f us avx2 per %i, %s\n",
+			time[0] * 1e6 / count, time[1] * 1e6 / count, BENCH_TRIS,
+			memcmp (pixels[0], pixels[1], size) ||
+			memcmp (zbuf[0], zbuf[1], size * sizeof(short))
+			? "MISMATCH" : "identical");
+
+	Cvar_SetValue ("r_simd", oldsimd);
+}
@@ -442,200 +442,501 @@ void R_DrawSubmodelPolygons (model_t *pmodel, int clipflags)
 
 /*
 ================
-R_RecursiveWorldNode
+R_CullNode
+
+Returns true if the node is entirely off screen, and clears the clipflags
+for the planes it is entirely on the inside of
 ================
 */
-void R_RecursiveWorldNode (mnode_t *node, int clipflags)
+static qboolean R_CullNode (mnode_t *node, int *clipflags)
 {
-	int			i, c, side, *pindex;
+	int			i, *pindex;
 	vec3_t		acceptpt, rejectpt;
-	mplane_t	*plane;
-	msurface_t	*surf, **mark;
-	mleaf_t		*pleaf;
-	double		d, dot;
+	double		d;
 
-	if (node->contents == CONTENTS_SOLID)
-		return;		// solid
-
-	if (node->visframe != r_visframecount)
-		return;
-
-// cull the clipping planes if not trivial accept
 // FIXME: the compiler is doing a lousy job of optimizing here; it could be
 //  twice as fast in ASM
-	if (clipflags)
+	for (i=0 ; i<4 ; i++)
 	{
-		for (i=0 ; i<4 ; i++)
-		{
-			if (! (clipflags & (1<<i)) )
-				continue;	// don't need to clip against it
+		if (! (*clipflags & (1<<i)) )
+			continue;	// don't need to clip against it
 
-		// generate accept and reject points
-		// FIXME: do with fast look-ups or integer tests based on the sign bit
-		// of the floating point values
+	// generate accept and reject points
+	// FIXME: do with fast look-ups or integer tests based on the sign bit
+	// of the floating point values
 
-			pindex = pfrustum_indexes[i];
+		pindex = pfrustum_indexes[i];
 
-			rejectpt[0] = (float)node->minmaxs[pindex[0]];
-			rejectpt[1] = (float)node->minmaxs[pindex[1]];
-			rejectpt[2] = (float)node->minmaxs[pindex[2]];
+		rejectpt[0] = (float)node->minmaxs[pindex[0]];
+		rejectpt[1] = (float)node->minmaxs[pindex[1]];
+		rejectpt[2] = (float)node->minmaxs[pindex[2]];
 
-			d = DotProduct (rejectpt, view_clipplanes[i].normal);
-			d -= view_clipplanes[i].dist;
+		d = DotProduct (rejectpt, view_clipplanes[i].normal);
+		d -= view_clipplanes[i].dist;
 
-			if (d <= 0)
-				return;
+		if (d <= 0)
+			return true;
 
-			acceptpt[0] = (float)node->minmaxs[pindex[3+0]];
-			acceptpt[1] = (float)node->minmaxs[pindex[3+1]];
-			acceptpt[2] = (float)node->minmaxs[pindex[3+2]];
+		acceptpt[0] = (float)node->minmaxs[pindex[3+0]];
+		acceptpt[1] = (float)node->minmaxs[pindex[3+1]];
+		acceptpt[2] = (float)node->minmaxs[pindex[3+2]];
 
-			d = DotProduct (acceptpt, view_clipplanes[i].normal);
-			d -= view_clipplanes[i].dist;
+		d = DotProduct (acceptpt, view_clipplanes[i].normal);
+		d -= view_clipplanes[i].dist;
 
-			if (d >= 0)
-				clipflags &= ~(1<<i);	// node is entirely on screen
-		}
+		if (d >= 0)
+			*clipflags &= ~(1<<i);	// node is entirely on screen
 	}
 
-// if a leaf node, draw stuff
-	if (node->contents < 0)
-	{
-		pleaf = (mleaf_t *)node;
+	return false;
+}
 
-		mark = pleaf->firstmarksurface;
-		c = pleaf->nummarksurfaces;
 
-		if (c)
-		{
-			do
-			{
-				(*mark)->visframe = r_framecount;
-				mark++;
-			} while (--c);
-		}
+/*
+================
+R_DrawLeaf
+================
+*/
+static void R_DrawLeaf (mleaf_t *pleaf)
+{
+	int			c;
+	msurface_t	**mark;
 
-	// deal with model fragments in this leaf
-		if (pleaf->efrags)
-		{
-			R_StoreEfrags (&pleaf->efrags);
-		}
+	mark = pleaf->firstmarksurface;
+	c = pleaf->nummarksurfaces;
 
-		pleaf->key = r_currentkey;
-		r_currentkey++;		// all bmodels in a leaf share the same key
+	if (c)
+	{
+		do
+		{
+			(*mark)->visframe = r_framecount;
+			mark++;
+		} while (--c);
 	}
-	else
+
+// deal with model fragments in this leaf
+	if (pleaf->efrags)
 	{
-	// node is just a decision point, so go down the apropriate sides
+		R_StoreEfrags (&pleaf->efrags);
+	}
 
-	// find which side of the node we are on
-		plane = node->plane;
+	R_WorldKey (pleaf);		// all bmodels in a leaf share the same key
+}
 
-		switch (plane->type)
-		{
-		case PLANE_X:
-			dot = modelorg[0] - plane->dist;
-			break;
-		case PLANE_Y:
-			dot = modelorg[1] - plane->dist;
-			break;
-		case PLANE_Z:
-			dot = modelorg[2] - plane->dist;
-			break;
-		default:
-			dot = DotProduct (modelorg, plane->normal) - plane->dist;
-			break;
-		}
 
-		if (dot >= 0)
-			side = 0;
-		else
-			side = 1;
+/*
+================
+R_NodeDist
+
+Which side of the node the view is on
+================
+*/
+static double R_NodeDist (mnode_t *node)
+{
+	mplane_t	*plane;
 
-	// recurse down the children, front side first
-		R_RecursiveWorldNode (node->children[side], clipflags);
+	plane = node->plane;
 
-	// draw stuff
-		c = node->numsurfaces;
+	switch (plane->type)
+	{
+	case PLANE_X:
+		return modelorg[0] - plane->dist;
+	case PLANE_Y:
+		return modelorg[1] - plane->dist;
+	case PLANE_Z:
+		return modelorg[2] - plane->dist;
+	default:
+		return DotProduct (modelorg, plane->normal) - plane->dist;
+	}
+}
 
-		if (c)
-		{
-			surf = cl.worldmodel->surfaces + node->firstsurface;
 
-			if (dot < -BACKFACE_EPSILON)
+/*
+================
+R_DrawNodeSurfaces
+================
+*/
+static void R_DrawNodeSurfaces (mnode_t *node, double dot, int clipflags)
+{
+	int			c;
+	msurface_t	*surf;
+
+	c = node->numsurfaces;
+
+	if (c)
+	{
+		surf = cl.worldmodel->surfaces + node->firstsurface;
+
+		if (dot < -BACKFACE_EPSILON)
+		{
+			do
 			{
-				do
+				if ((surf->flags & SURF_PLANEBACK) &&
+					(surf->visframe == r_framecount))
 				{
-					if ((surf->flags & SURF_PLANEBACK) &&
-						(surf->visframe == r_framecount))
+					if (r_drawpolys)
 					{
-						if (r_drawpolys)
+						if (r_worldpolysbacktofront)
 						{
-							if (r_worldpolysbacktofront)
+							if (numbtofpolys < MAX_BTOFPOLYS)
 							{
-								if (numbtofpolys < MAX_BTOFPOLYS)
-								{
-									pbtofpolys[numbtofpolys].clipflags =
-											clipflags;
-									pbtofpolys[numbtofpolys].psurf = surf;
-									numbtofpolys++;
-								}
-							}
-							else
-							{
-								R_RenderPoly (surf, clipflags);
+								pbtofpolys[numbtofpolys].clipflags =
+										clipflags;
+								pbtofpolys[numbtofpolys].psurf = surf;
+								numbtofpolys++;
 							}
 						}
 						else
 						{
-							R_RenderFace (surf, clipflags);
+							R_RenderPoly (surf, clipflags);
 						}
 					}
+					else
+					{
+						R_WorldFace (surf, clipflags);
+					}
+				}
 
-					surf++;
-				} while (--c);
-			}
-			else if (dot > BACKFACE_EPSILON)
+				surf++;
+			} while (--c);
+		}
+		else if (dot > BACKFACE_EPSILON)
+		{
+			do
 			{
-				do
+				if (!(surf->flags & SURF_PLANEBACK) &&
+					(surf->visframe == r_framecount))
 				{
-					if (!(surf->flags & SURF_PLANEBACK) &&
-						(surf->visframe == r_framecount))
+					if (r_drawpolys)
 					{
-						if (r_drawpolys)
+						if (r_worldpolysbacktofront)
 						{
-							if (r_worldpolysbacktofront)
+							if (numbtofpolys < MAX_BTOFPOLYS)
 							{
-								if (numbtofpolys < MAX_BTOFPOLYS)
-								{
-									pbtofpolys[numbtofpolys].clipflags =
-											clipflags;
-									pbtofpolys[numbtofpolys].psurf = surf;
-									numbtofpolys++;
-								}
-							}
-							else
-							{
-								R_RenderPoly (surf, clipflags);
+								pbtofpolys[numbtofpolys].clipflags =
+										clipflags;
+								pbtofpolys[numbtofpolys].psurf = surf;
+								numbtofpolys++;
 							}
 						}
 						else
 						{
-							R_RenderFace (surf, clipflags);
+							R_RenderPoly (surf, clipflags);
 						}
 					}
+					else
+					{
+						R_WorldFace (surf, clipflags);
+					}
+				}
+
+				surf++;
+			} while (--c);
+		}
+
+	// all surfaces on the same node share the same sequence number
+		R_WorldKey (NULL);
+	}
+}
+
+
+/*
+================
+R_RecursiveWorldNode
+================
+*/
+void R_RecursiveWorldNode (mnode_t *node, int clipflags)
+{
+	int			side;
+	double		dot;
+
+	if (node->contents == CONTENTS_SOLID)
+		return;		// solid
+
+	if (node->visframe != r_visframecount)
+		return;
+
+// cull the clipping planes if not trivial accept
+	if (clipflags && R_CullNode (node, &clipflags))
+		return;
+
+// if a leaf node, draw stuff
+	if (node->contents < 0)
+	{
+		R_DrawLeaf ((mleaf_t *)node);
+		return;
+	}
+
+// node is just a decision point, so go down the apropriate sides
+
+// find which side of the node we are on
+	dot = R_NodeDist (node);
+
+	if (dot >= 0)
+		side = 0;
+	else
+		side = 1;
+
+// recurse down the children, front side first
+	R_RecursiveWorldNode (node->children[side], clipflags);
+
+// draw stuff
+	R_DrawNodeSurfaces (node, dot, clipflags);
+
+// recurse down the back side
+	R_RecursiveWorldNode (node->children[!side], clipflags);
+}
 
-					surf++;
-				} while (--c);
-			}
 
-		// all surfaces on the same node share the same sequence number
-			r_currentkey++;
+/*
+===============================================================================
+
+VISIBLE NODE LISTS
+
+The nodes marked by R_MarkLeaves for a view leaf, kept as a tree of their
+own so R_VisWorldNode never looks at a node that isn't visible.  The lists
+are made the first time the world is drawn from a leaf and kept in the
+cache for the last few leafs, so walking back into one of them marks its
+nodes straight from the list instead of going through the PVS again.
+
+===============================================================================
+*/
+
+typedef struct
+{
+	mnode_t		*node;
+	int			children[2];	// indexes in the list, -1 if not visible
+} visnode_t;
+
+typedef struct
+{
+	mleaf_t			*leaf;
+	int				numnodes;
+	int				lastframe;
+	cache_user_t	cache;
+} visleaf_t;
+
+#define	MAX_VISLEAFS	32
+
+static visleaf_t	r_visleafs[MAX_VISLEAFS];
+static visnode_t	*r_visnodes;
+static int			r_numvisnodes;
+
+/*
+================
+R_ClearVisLeafs
+
+The lists point into the world model, so they go with it
+================
+*/
+void R_ClearVisLeafs (void)
+{
+	int		i;
+
+	for (i=0 ; i<MAX_VISLEAFS ; i++)
+	{
+		if (r_visleafs[i].cache.data)
+			Cache_Free (&r_visleafs[i].cache);
+		r_visleafs[i].leaf = NULL;
+	}
+}
+
+/*
+================
+R_FindVisLeaf
+================
+*/
+static visleaf_t *R_FindVisLeaf (mleaf_t *leaf)
+{
+	int			i;
+	visleaf_t	*vl;
+
+	for (i=0, vl=r_visleafs ; i<MAX_VISLEAFS ; i++, vl++)
+	{
+		if (vl->leaf == leaf)
+		{
+			vl->lastframe = r_framecount;
+			return vl;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+================
+R_MarkVisLeaf
+
+Marks the nodes visible from leaf from its list, returns false if there
+is no list for it
+================
+*/
+qboolean R_MarkVisLeaf (mleaf_t *leaf)
+{
+	int			i;
+	visleaf_t	*vl;
+	visnode_t	*visnodes;
+
+	if (!r_viscache.value)
+		return false;
+
+	vl = R_FindVisLeaf (leaf);
+	if (!vl)
+		return false;
+
+	visnodes = Cache_Check (&vl->cache);
+	if (!visnodes)
+		return false;
+
+	for (i=0 ; i<vl->numnodes ; i++)
+		visnodes[i].node->visframe = r_visframecount;
+
+	return true;
+}
+
+/*
+================
+R_CountVisNodes
+================
+*/
+static int R_CountVisNodes (mnode_t *node)
+{
+	if (node->contents == CONTENTS_SOLID || node->visframe != r_visframecount)
+		return 0;
+
+	if (node->contents < 0)
+		return 1;
+
+	return 1 + R_CountVisNodes (node->children[0]) +
+			R_CountVisNodes (node->children[1]);
+}
+
+/*
+================
+R_AddVisNode
+
+Adds the node and its visible children depth first, returns its index
+================
+*/
+static int R_AddVisNode (mnode_t *node)
+{
+	int		i, c0, c1;
+
+	if (node->contents == CONTENTS_SOLID || node->visframe != r_visframecount)
+		return -1;
+
+	i = r_numvisnodes++;
+	r_visnodes[i].node = node;
+
+	if (node->contents < 0)
+	{
+		r_visnodes[i].children[0] = -1;
+		r_visnodes[i].children[1] = -1;
+		return i;
+	}
+
+	c0 = R_AddVisNode (node->children[0]);
+	c1 = R_AddVisNode (node->children[1]);
+	r_visnodes[i].children[0] = c0;
+	r_visnodes[i].children[1] = c1;
+
+	return i;
+}
+
+/*
+================
+R_GetVisNodes
+
+The list for the view leaf, made from the current marks if it isn't
+cached.  Returns NULL if the cache has no room.
+================
+*/
+static visnode_t *R_GetVisNodes (void)
+{
+	int			i, count;
+	visleaf_t	*vl, *oldest;
+	visnode_t	*visnodes;
+
+	vl = R_FindVisLeaf (r_viewleaf);
+	if (vl)
+	{
+		visnodes = Cache_Check (&vl->cache);
+		if (visnodes)
+			return visnodes;
+	}
+	else
+	{
+	// take the leaf that has gone the longest without being drawn from
+		oldest = r_visleafs;
+		for (i=1, vl=r_visleafs+1 ; i<MAX_VISLEAFS ; i++, vl++)
+		{
+			if (vl->lastframe < oldest->lastframe)
+				oldest = vl;
 		}
 
-	// recurse down the back side
-		R_RecursiveWorldNode (node->children[!side], clipflags);
+		vl = oldest;
+		if (vl->cache.data)
+			Cache_Free (&vl->cache);
+		vl->leaf = r_viewleaf;
+		vl->lastframe = r_framecount;
+	}
+
+	count = R_CountVisNodes (cl.worldmodel->nodes);
+	if (!count)
+		return NULL;
+
+	visnodes = Cache_Alloc (&vl->cache, count * sizeof(visnode_t), "visnodes");
+	if (!visnodes)
+		return NULL;
+
+	r_visnodes = visnodes;
+	r_numvisnodes = 0;
+	R_AddVisNode (cl.worldmodel->nodes);
+
+	vl->numnodes = count;
+	return visnodes;
+}
+
+/*
+================
+R_VisWorldNode
+
+R_RecursiveWorldNode over a visible node list, in the same order
+================
+*/
+static void R_VisWorldNode (visnode_t *vn, int clipflags)
+{
+	int			side;
+	double		dot;
+	mnode_t		*node;
+
+	node = vn->node;
+
+// cull the clipping planes if not trivial accept
+	if (clipflags && R_CullNode (node, &clipflags))
+		return;
+
+// if a leaf node, draw stuff
+	if (node->contents < 0)
+	{
+		R_DrawLeaf ((mleaf_t *)node);
+		return;
 	}
+
+	dot = R_NodeDist (node);
+
+	if (dot >= 0)
+		side = 0;
+	else
+		side = 1;
+
+	if (vn->children[side] >= 0)
+		R_VisWorldNode (r_visnodes + vn->children[side], clipflags);
+
+	R_DrawNodeSurfaces (node, dot, clipflags);
+
+	if (vn->children[!side] >= 0)
+		R_VisWorldNode (r_visnodes + vn->children[!side], clipflags);
 }
 
 
@@ -658,7 +959,14 @@ void R_RenderWorld (void)
 	clmodel = currententity->model;
 	r_pcurrentvertbase = clmodel->vertexes;
 
-	R_RecursiveWorldNode (clmodel->nodes, 15);
+	R_BeginWorldFaces ();
+
+	if (r_viscache.value && (r_visnodes = R_GetVisNodes ()))
+		R_VisWorldNode (r_visnodes, 15);
+	else
+		R_RecursiveWorldNode (clmodel->nodes, 15);
+
+	R_EndWorldFaces ();
 
 // if the driver wants the polygons back to front, play the visible ones back
 // in that order
@@ -30,7 +30,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define FULLY_CLIPPED_CACHED	0x80000000
 #define FRAMECOUNT_MASK			0x7FFFFFFF
 
-unsigned int	cacheoffset;
+/*
+The edge clipping state below is per thread, so world faces can be clipped
+on the workers (see the world face jobs at the end of the file).
+*/
+THREADLOCAL unsigned int	cacheoffset;
 
 int			c_faceclip;					// number of faces clipped
 
@@ -44,17 +48,18 @@ clipplane_t	*entity_clipplanes;
 clipplane_t	view_clipplanes[4];
 clipplane_t	world_clipplanes[16];
 
-medge_t			*r_pedge;
+THREADLOCAL medge_t		*r_pedge;
 
-qboolean		r_leftclipped, r_rightclipped;
+THREADLOCAL qboolean	r_leftclipped, r_rightclipped;
 static qboolean	makeleftedge, makerightedge;
-qboolean		r_nearzionly;
+THREADLOCAL qboolean	r_nearzionly;
 
 int		sintable[SIN_BUFFER_SIZE];
 int		intsintable[SIN_BUFFER_SIZE];
 
-mvertex_t	r_leftenter, r_leftexit;
-mvertex_t	r_rightenter, r_rightexit;
+THREADLOCAL mvertex_t	r_leftenter, r_leftexit;
+THREADLOCAL mvertex_t	r_rightenter, r_rightexit;
+THREADLOCAL int		r_clipverts;	// CLIP_* bits for the vertices just set
 
 typedef struct
 {
@@ -62,12 +67,71 @@ typedef struct
 	int		ceilv;
 } evert_t;
 
-int				r_emitted;
-float			r_nearzi;
-float			r_u1, r_v1, r_lzi1;
-int				r_ceilv1;
+THREADLOCAL int		r_emitted;
+THREADLOCAL float	r_nearzi;
+THREADLOCAL float	r_u1, r_v1, r_lzi1;
+THREADLOCAL int		r_ceilv1;
+
+THREADLOCAL qboolean	r_lastvertvalid;
+
+// what R_ClipWorldFace found for one edge of a face
+#define	CLIP_EMITTED	1
+#define	CLIP_EDGE		2
+#define	CLIP_LEFTENTER	4
+#define	CLIP_LEFTEXIT	8
+#define	CLIP_RIGHTENTER	16
+#define	CLIP_RIGHTEXIT	32
+
+typedef struct
+{
+	edge_t		edge;
+	int			v, v2;
+	unsigned	cacheoffset;	// CACHEOFFSET_NEW for wherever the edge lands
+	float		nearzi;
+	int			flags;
+	mvertex_t	left, right;	// left or right enter/exit vertex
+} clipedge_t;
 
-qboolean	r_lastvertvalid;
+#define	CACHEOFFSET_NEW		0x7FFFFFFE
+
+// set while a worker clips a world face, the edge goes here, not in the lists
+static THREADLOCAL clipedge_t	*r_clipedge;
+
+
+/*
+================
+R_InsertEdge
+================
+*/
+static void R_InsertEdge (edge_t *edge, int v, int v2)
+{
+	edge_t	*pcheck;
+	int		u_check;
+
+//
+// sort the edge in normally
+//
+	u_check = edge->u;
+	if (edge->surfs[0])
+		u_check++;	// sort trailers after leaders
+
+	if (!newedges[v] || newedges[v]->u >= u_check)
+	{
+		edge->next = newedges[v];
+		newedges[v] = edge;
+	}
+	else
+	{
+		pcheck = newedges[v];
+		while (pcheck->next && pcheck->next->u < u_check)
+			pcheck = pcheck->next;
+		edge->next = pcheck->next;
+		pcheck->next = edge;
+	}
+
+	edge->nextremove = removeedges[v2];
+	removeedges[v2] = edge;
+}
 
 
 #if	!id386
@@ -79,8 +143,7 @@ R_EmitEdge
 */
 void R_EmitEdge (mvertex_t *pv0, mvertex_t *pv1)
 {
-	edge_t	*edge, *pcheck;
-	int		u_check;
+	edge_t	*edge;
 	float	u, u_step;
 	vec3_t	local, transformed;
 	float	*world;
@@ -181,7 +244,10 @@ void R_EmitEdge (mvertex_t *pv0, mvertex_t *pv1)
 
 	side = ceilv0 > r_ceilv1;
 
-	edge = edge_p++;
+	if (r_clipedge)
+		edge = &r_clipedge->edge;
+	else
+		edge = edge_p++;
 
 	edge->owner = r_pedge;
 
@@ -225,29 +291,16 @@ void R_EmitEdge (mvertex_t *pv0, mvertex_t *pv1)
 	if (edge->u > r_refdef.vrectright_adj_shift20)
 		edge->u = r_refdef.vrectright_adj_shift20;
 
-//
-// sort the edge in normally
-//
-	u_check = edge->u;
-	if (edge->surfs[0])
-		u_check++;	// sort trailers after leaders
-
-	if (!newedges[v] || newedges[v]->u >= u_check)
-	{
-		edge->next = newedges[v];
-		newedges[v] = edge;
-	}
-	else
+// a worker leaves the sorting to R_MergeWorldFace
+	if (r_clipedge)
 	{
-		pcheck = newedges[v];
-		while (pcheck->next && pcheck->next->u < u_check)
-			pcheck = pcheck->next;
-		edge->next = pcheck->next;
-		pcheck->next = edge;
+		r_clipedge->v = v;
+		r_clipedge->v2 = v2;
+		r_clipedge->flags |= CLIP_EDGE;
+		return;
 	}
 
-	edge->nextremove = removeedges[v2];
-	removeedges[v2] = edge;
+	R_InsertEdge (edge, v, v2);
 }
 
 
@@ -294,11 +347,13 @@ void R_ClipEdge (mvertex_t *pv0, mvertex_t *pv1, clipplane_t *clip)
 				{
 					r_leftclipped = true;
 					r_leftexit = clipvert;
+					r_clipverts |= CLIP_LEFTEXIT;
 				}
 				else if (clip->rightedge)
 				{
 					r_rightclipped = true;
 					r_rightexit = clipvert;
+					r_clipverts |= CLIP_RIGHTEXIT;
 				}
 
 				R_ClipEdge (pv0, &clipvert, clip->next);
@@ -335,11 +390,13 @@ void R_ClipEdge (mvertex_t *pv0, mvertex_t *pv1, clipplane_t *clip)
 				{
 					r_leftclipped = true;
 					r_leftenter = clipvert;
+					r_clipverts |= CLIP_LEFTENTER;
 				}
 				else if (clip->rightedge)
 				{
 					r_rightclipped = true;
 					r_rightenter = clipvert;
+					r_clipverts |= CLIP_RIGHTENTER;
 				}
 
 				R_ClipEdge (&clipvert, pv1, clip->next);
@@ -378,6 +435,47 @@ void R_EmitCachedEdge (void)
 }
 
 
+/*
+================
+R_PostFace
+
+Adds the surface for a face whose edges have been emitted
+================
+*/
+static void R_PostFace (msurface_t *fa)
+{
+	mplane_t	*pplane;
+	float		distinv;
+	vec3_t		p_normal;
+
+	r_polycount++;
+
+	surface_p->data = (void *)fa;
+	surface_p->nearzi = r_nearzi;
+	surface_p->flags = fa->flags;
+	surface_p->insubmodel = insubmodel;
+	surface_p->spanstate = 0;
+	surface_p->entity = currententity;
+	surface_p->key = r_currentkey++;
+	surface_p->spans = NULL;
+
+	pplane = fa->plane;
+// FIXME: cache this?
+	TransformVector (pplane->normal, p_normal);
+// FIXME: cache this?
+	distinv = 1.0 / (pplane->dist - DotProduct (modelorg, pplane->normal));
+
+	surface_p->d_zistepu = p_normal[0] * xscaleinv * distinv;
+	surface_p->d_zistepv = -p_normal[1] * yscaleinv * distinv;
+	surface_p->d_ziorigin = p_normal[2] * distinv -
+			xcenter * surface_p->d_zistepu -
+			ycenter * surface_p->d_zistepv;
+
+//JDC	VectorCopy (r_worldmodelorg, surface_p->modelorg);
+	surface_p++;
+}
+
+
 /*
 ================
 R_RenderFace
@@ -387,9 +485,6 @@ void R_RenderFace (msurface_t *fa, int clipflags)
 {
 	int			i, lindex;
 	unsigned	mask;
-	mplane_t	*pplane;
-	float		distinv;
-	vec3_t		p_normal;
 	medge_t		*pedges, tedge;
 	clipplane_t	*pclip;
 
@@ -548,31 +643,7 @@ void R_RenderFace (msurface_t *fa, int clipflags)
 	if (!r_emitted)
 		return;
 
-	r_polycount++;
-
-	surface_p->data = (void *)fa;
-	surface_p->nearzi = r_nearzi;
-	surface_p->flags = fa->flags;
-	surface_p->insubmodel = insubmodel;
-	surface_p->spanstate = 0;
-	surface_p->entity = currententity;
-	surface_p->key = r_currentkey++;
-	surface_p->spans = NULL;
-
-	pplane = fa->plane;
-// FIXME: cache this?
-	TransformVector (pplane->normal, p_normal);
-// FIXME: cache this?
-	distinv = 1.0 / (pplane->dist - DotProduct (modelorg, pplane->normal));
-
-	surface_p->d_zistepu = p_normal[0] * xscaleinv * distinv;
-	surface_p->d_zistepv = -p_normal[1] * yscaleinv * distinv;
-	surface_p->d_ziorigin = p_normal[2] * distinv -
-			xcenter * surface_p->d_zistepu -
-			ycenter * surface_p->d_zistepv;
-
-//JDC	VectorCopy (r_worldmodelorg, surface_p->modelorg);
-	surface_p++;
+	R_PostFace (fa);
 }
 
 
@@ -905,3 +976,474 @@ void R_ZDrawSubmodelPolys (model_t *pmodel)
 		}
 	}
 }
+
+
+/*
+=============================================================================
+
+WORLD FACE JOBS
+
+With worker threads, the world walk queues its faces instead of rendering
+them, and every WORLDFACES_PER_JOB faces go off to a worker, which clips
+and projects the edges of each face into records of its own while the
+walk carries on.  R_MergeWorldFace then takes the faces in walk order and
+does the rest of R_RenderFace with the records: the edge cache checks,
+sorting into newedges and removeedges, and posting the surface.  Only the
+merge touches the cache and the lists, so they come out exactly as the
+serial walk leaves them.
+
+=============================================================================
+*/
+
+#define	MAX_WORLDFACES		4096	// faces and key steps between merges
+#define	MAX_CLIPEDGES		16384
+#define	WORLDFACES_PER_JOB	64
+
+typedef struct
+{
+	msurface_t	*surf;		// NULL for a key step
+	mleaf_t		*leaf;		// key step for a leaf, NULL for a node
+	int			clipflags;
+	int			firstclip;	// in r_clipedges
+} worldface_t;
+
+typedef struct
+{
+	job_t		job;
+	int			first, count;
+} clipjob_t;
+
+static worldface_t	r_worldfaces[MAX_WORLDFACES];
+static int			r_numworldfaces;
+
+static clipedge_t	r_clipedges[MAX_CLIPEDGES];
+static int			r_numclipedges;
+
+static clipjob_t	r_clipjobs[MAX_WORLDFACES/WORLDFACES_PER_JOB + 1];
+static int			r_numclipjobs;
+static int			r_jobstart, r_jobfaces;	// queued but not yet in a job
+
+static qboolean		r_queuefaces;
+
+
+/*
+================
+R_ClipWorldFace
+
+Runs on a worker, R_RenderFace's edge loop without the cache
+================
+*/
+static void R_ClipWorldFace (worldface_t *wf)
+{
+	int			i, lindex;
+	unsigned	mask;
+	msurface_t	*fa;
+	medge_t		*pedges;
+	mvertex_t	*pv0, *pv1;
+	clipplane_t	planes[4], *pclip;
+	clipedge_t	*rec;
+
+	fa = wf->surf;
+
+// the view planes are shared, so link up copies of them
+	pclip = NULL;
+
+	for (i=3, mask = 0x08 ; i>=0 ; i--, mask >>= 1)
+	{
+		if (wf->clipflags & mask)
+		{
+			planes[i] = view_clipplanes[i];
+			planes[i].next = pclip;
+			pclip = &planes[i];
+		}
+	}
+
+	r_nearzionly = false;
+	pedges = cl.worldmodel->edges;
+	r_lastvertvalid = false;
+
+	rec = r_clipedges + wf->firstclip;
+
+	for (i=0 ; i<fa->numedges ; i++, rec++)
+	{
+		lindex = cl.worldmodel->surfedges[fa->firstedge + i];
+
+		if (lindex > 0)
+		{
+			r_pedge = &pedges[lindex];
+			pv0 = &r_pcurrentvertbase[r_pedge->v[0]];
+			pv1 = &r_pcurrentvertbase[r_pedge->v[1]];
+		}
+		else
+		{
+			r_pedge = &pedges[-lindex];
+			pv0 = &r_pcurrentvertbase[r_pedge->v[1]];
+			pv1 = &r_pcurrentvertbase[r_pedge->v[0]];
+		}
+
+	// the merge decides whether the cached edge is used instead
+		r_clipedge = rec;
+		rec->flags = 0;
+		cacheoffset = CACHEOFFSET_NEW;
+		r_emitted = 0;
+		r_nearzi = 0;
+		r_clipverts = 0;
+		r_leftclipped = r_rightclipped = false;
+		R_ClipEdge (pv0, pv1, pclip);
+
+		rec->cacheoffset = cacheoffset;
+		rec->nearzi = r_nearzi;
+		rec->flags |= r_clipverts;
+		if (r_emitted)
+			rec->flags |= CLIP_EMITTED;
+
+		if (r_clipverts & CLIP_LEFTENTER)
+			rec->left = r_leftenter;
+		else if (r_clipverts & CLIP_LEFTEXIT)
+			rec->left = r_leftexit;
+
+		if (r_clipverts & CLIP_RIGHTENTER)
+			rec->right = r_rightenter;
+		else if (r_clipverts & CLIP_RIGHTEXIT)
+			rec->right = r_rightexit;
+
+		r_lastvertvalid = true;
+	}
+
+	r_clipedge = NULL;
+}
+
+
+/*
+================
+R_ClipWorldFaces
+================
+*/
+static void R_ClipWorldFaces (void *data)
+{
+	clipjob_t	*cj;
+	worldface_t	*wf;
+	int			i;
+
+	cj = data;
+	wf = r_worldfaces + cj->first;
+
+	for (i=0 ; i<cj->count ; i++, wf++)
+	{
+		if (wf->surf)
+			R_ClipWorldFace (wf);
+	}
+}
+
+
+/*
+================
+R_SubmitClipJob
+================
+*/
+static void R_SubmitClipJob (void)
+{
+	clipjob_t	*cj;
+
+	if (r_jobstart == r_numworldfaces)
+		return;
+
+	cj = &r_clipjobs[r_numclipjobs++];
+	cj->first = r_jobstart;
+	cj->count = r_numworldfaces - r_jobstart;
+
+	r_jobstart = r_numworldfaces;
+	r_jobfaces = 0;
+
+	Job_Submit (&cj->job, R_ClipWorldFaces, cj);
+}
+
+
+/*
+================
+R_EdgeCached
+
+R_RenderFace's cache check for r_pedge, true if it needn't be clipped
+================
+*/
+static qboolean R_EdgeCached (void)
+{
+	if (r_pedge->cachededgeoffset & FULLY_CLIPPED_CACHED)
+	{
+		if ((r_pedge->cachededgeoffset & FRAMECOUNT_MASK) == r_framecount)
+			return true;
+	}
+	else
+	{
+		if ((((unsigned long)edge_p - (unsigned long)r_edges) >
+			 r_pedge->cachededgeoffset) &&
+			(((edge_t *)((unsigned long)r_edges +
+			 r_pedge->cachededgeoffset))->owner == r_pedge))
+		{
+			R_EmitCachedEdge ();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*
+================
+R_MergeWorldFace
+
+R_RenderFace, with the clipping already done by R_ClipWorldFace
+================
+*/
+static void R_MergeWorldFace (worldface_t *wf)
+{
+	int			i, lindex;
+	unsigned	mask;
+	msurface_t	*fa;
+	medge_t		*pedges, tedge;
+	clipplane_t	*pclip;
+	clipedge_t	*rec;
+	edge_t		*edge;
+
+	fa = wf->surf;
+
+// skip out if no more surfs
+	if ((surface_p) >= surf_max)
+	{
+		r_outofsurfaces++;
+		return;
+	}
+
+// ditto if not enough edges left
+	if ((edge_p + fa->numedges + 4) >= edge_max)
+	{
+		r_outofedges += fa->numedges;
+		return;
+	}
+
+	c_faceclip++;
+
+// set up clip planes for the left and right edges
+	pclip = NULL;
+
+	for (i=3, mask = 0x08 ; i>=0 ; i--, mask >>= 1)
+	{
+		if (wf->clipflags & mask)
+		{
+			view_clipplanes[i].next = pclip;
+			pclip = &view_clipplanes[i];
+		}
+	}
+
+	r_emitted = 0;
+	r_nearzi = 0;
+	r_nearzionly = false;
+	makeleftedge = makerightedge = false;
+	pedges = currententity->model->edges;
+
+	rec = r_clipedges + wf->firstclip;
+
+	for (i=0 ; i<fa->numedges ; i++, rec++)
+	{
+		lindex = currententity->model->surfedges[fa->firstedge + i];
+		r_pedge = &pedges[lindex > 0 ? lindex : -lindex];
+
+		if (R_EdgeCached ())
+			continue;
+
+		if (rec->cacheoffset == CACHEOFFSET_NEW)
+			r_pedge->cachededgeoffset = (byte *)edge_p - (byte *)r_edges;
+		else
+			r_pedge->cachededgeoffset = rec->cacheoffset;
+
+		if (rec->nearzi > r_nearzi)
+			r_nearzi = rec->nearzi;
+		if (rec->flags & CLIP_EMITTED)
+			r_emitted = 1;
+
+		if (rec->flags & CLIP_EDGE)
+		{
+			edge = edge_p++;
+			*edge = rec->edge;
+
+			if (edge->surfs[0])
+				edge->surfs[0] = surface_p - surfaces;
+			else
+				edge->surfs[1] = surface_p - surfaces;
+
+			R_InsertEdge (edge, rec->v, rec->v2);
+		}
+
+		if (rec->flags & CLIP_LEFTENTER)
+			r_leftenter = rec->left;
+		if (rec->flags & CLIP_LEFTEXIT)
+			r_leftexit = rec->left;
+		if (rec->flags & CLIP_RIGHTENTER)
+			r_rightenter = rec->right;
+		if (rec->flags & CLIP_RIGHTEXIT)
+			r_rightexit = rec->right;
+
+		if (rec->flags & (CLIP_LEFTENTER | CLIP_LEFTEXIT))
+			makeleftedge = true;
+		if (rec->flags & (CLIP_RIGHTENTER | CLIP_RIGHTEXIT))
+			makerightedge = true;
+	}
+
+// if there was a clip off the left edge, add that edge too
+	if (makeleftedge)
+	{
+		r_pedge = &tedge;
+		r_lastvertvalid = false;
+		R_ClipEdge (&r_leftexit, &r_leftenter, pclip->next);
+	}
+
+// if there was a clip off the right edge, get the right r_nearzi
+	if (makerightedge)
+	{
+		r_pedge = &tedge;
+		r_lastvertvalid = false;
+		r_nearzionly = true;
+		R_ClipEdge (&r_rightexit, &r_rightenter, view_clipplanes[1].next);
+	}
+
+// if no edges made it out, return without posting the surface
+	if (!r_emitted)
+		return;
+
+	R_PostFace (fa);
+}
+
+
+/*
+================
+R_FlushWorldFaces
+================
+*/
+static void R_FlushWorldFaces (void)
+{
+	int			i;
+	worldface_t	*wf;
+	mvertex_t	leftenter, leftexit, rightenter, rightexit;
+
+	R_SubmitClipJob ();
+
+// the main thread can run clip jobs while it waits, keep its clip vertices
+// as R_RenderFace would have left them
+	leftenter = r_leftenter;
+	leftexit = r_leftexit;
+	rightenter = r_rightenter;
+	rightexit = r_rightexit;
+
+	for (i=0 ; i<r_numclipjobs ; i++)
+		Job_Wait (&r_clipjobs[i].job);
+
+	r_leftenter = leftenter;
+	r_leftexit = leftexit;
+	r_rightenter = rightenter;
+	r_rightexit = rightexit;
+
+	for (i=0, wf = r_worldfaces ; i<r_numworldfaces ; i++, wf++)
+	{
+		if (wf->surf)
+			R_MergeWorldFace (wf);
+		else if (wf->leaf)
+			wf->leaf->key = r_currentkey++;
+		else
+			r_currentkey++;
+	}
+
+	r_numworldfaces = r_numclipedges = r_numclipjobs = 0;
+	r_jobstart = r_jobfaces = 0;
+}
+
+
+/*
+================
+R_BeginWorldFaces
+================
+*/
+void R_BeginWorldFaces (void)
+{
+	r_numworldfaces = r_numclipedges = r_numclipjobs = 0;
+	r_jobstart = r_jobfaces = 0;
+
+#if	id386
+	r_queuefaces = false;	// the asm edge clipper can't record
+#else
+	r_queuefaces = r_worldjobs.value && Jobs_Workers () && !r_drawpolys;
+#endif
+}
+
+
+/*
+================
+R_WorldFace
+================
+*/
+void R_WorldFace (msurface_t *fa, int clipflags)
+{
+	worldface_t	*wf;
+
+	if (!r_queuefaces)
+	{
+		R_RenderFace (fa, clipflags);
+		return;
+	}
+
+	if (r_numworldfaces == MAX_WORLDFACES ||
+		r_numclipedges + fa->numedges > MAX_CLIPEDGES)
+		R_FlushWorldFaces ();
+
+	wf = &r_worldfaces[r_numworldfaces++];
+	wf->surf = fa;
+	wf->leaf = NULL;
+	wf->clipflags = clipflags;
+	wf->firstclip = r_numclipedges;
+	r_numclipedges += fa->numedges;
+
+	if (++r_jobfaces == WORLDFACES_PER_JOB)
+		R_SubmitClipJob ();
+}
+
+
+/*
+================
+R_WorldKey
+
+Steps r_currentkey for a node, or for a leaf after giving it the key
+================
+*/
+void R_WorldKey (mleaf_t *leaf)
+{
+	worldface_t	*wf;
+
+	if (!r_queuefaces)
+	{
+		if (leaf)
+			leaf->key = r_currentkey;
+		r_currentkey++;
+		return;
+	}
+
+	if (r_numworldfaces == MAX_WORLDFACES)
+		R_FlushWorldFaces ();
+
+	wf = &r_worldfaces[r_numworldfaces++];
+	wf->surf = NULL;
+	wf->leaf = leaf;
+}
+
+
+/*
+================
+R_EndWorldFaces
+================
+*/
+void R_EndWorldFaces (void)
+{
+	if (r_queuefaces)
+		R_FlushWorldFaces ();
+
+	r_queuefaces = false;
+}
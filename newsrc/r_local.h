@@ -71,6 +71,11 @@ extern cvar_t	r_numsurfs;
 extern cvar_t	r_reportedgeout;
 extern cvar_t	r_maxedges;
 extern cvar_t	r_numedges;
+extern cvar_t	r_simd;
+extern cvar_t	r_viscache;
+extern cvar_t	r_worldjobs;
+
+extern qboolean	r_haveavx2;		// cpu can run the AVX2 kernels
 
 #define XCENTERING	(1.0 / 2.0)
 #define YCENTERING	(1.0 / 2.0)
@@ -99,6 +104,8 @@ extern	clipplane_t	view_clipplanes[4];
 //=============================================================================
 
 void R_RenderWorld (void);
+void R_ClearVisLeafs (void);
+qboolean R_MarkVisLeaf (mleaf_t *leaf);
 
 //=============================================================================
 
@@ -133,6 +140,10 @@ void R_DrawSprite (void);
 void R_RenderFace (msurface_t *fa, int clipflags);
 void R_RenderPoly (msurface_t *fa, int clipflags);
 void R_RenderBmodelFace (bedge_t *pedges, msurface_t *psurf);
+void R_BeginWorldFaces (void);
+void R_WorldFace (msurface_t *fa, int clipflags);	// R_RenderFace or queue it
+void R_WorldKey (mleaf_t *leaf);
+void R_EndWorldFaces (void);
 void R_TransformPlane (mplane_t *p, float *normal, float *dist);
 void R_TransformFrustum (void);
 void R_SetSkyFrame (void);
@@ -300,6 +311,8 @@ extern qboolean	r_fov_greater_than_90;
 
 void R_StoreEfrags (efrag_t **ppefrag);
 void R_TimeRefresh_f (void);
+void R_SurfBench_f (void);
+void R_AliasBench_f (void);
 void R_TimeGraph (void);
 void R_PrintAliasStats (void);
 void R_PrintTimes (void);
@@ -136,6 +136,11 @@ cvar_t	r_maxedges = {"r_maxedges", "0"};
 cvar_t	r_numedges = {"r_numedges", "0"};
 cvar_t	r_aliastransbase = {"r_aliastransbase", "200"};
 cvar_t	r_aliastransadj = {"r_aliastransadj", "100"};
+cvar_t	r_simd = {"r_simd", "1"};	// use the vector kernels the cpu supports
+cvar_t	r_viscache = {"r_viscache", "1"};	// walk cached visible node lists
+cvar_t	r_worldjobs = {"r_worldjobs", "1"};	// clip world faces on the workers
+
+qboolean	r_haveavx2;
 
 extern cvar_t	scr_fov;
 
@@ -213,6 +218,13 @@ void R_Init (void)
 	Cvar_RegisterVariable (&r_numedges);
 	Cvar_RegisterVariable (&r_aliastransbase);
 	Cvar_RegisterVariable (&r_aliastransadj);
+	Cvar_RegisterVariable (&r_simd);
+	Cvar_RegisterVariable (&r_viscache);
+	Cvar_RegisterVariable (&r_worldjobs);
+
+	r_haveavx2 = Sys_CPUHasAVX2 ();
+	Cmd_AddCommand ("surfbench", R_SurfBench_f);
+	Cmd_AddCommand ("aliasbench", R_AliasBench_f);
 
 	Cvar_SetValue ("r_maxedges", (float)NUMSTACKEDGES);
 	Cvar_SetValue ("r_maxsurfs", (float)NUMSTACKSURFACES);
@@ -254,6 +266,7 @@ void R_NewMap (void)
 
 	r_viewleaf = NULL;
 	R_ClearParticles ();
+	R_ClearVisLeafs ();
 
 	r_cnumsurfs = r_maxsurfs.value;
 
@@ -500,6 +513,9 @@ void R_MarkLeaves (void)
 	r_visframecount++;
 	r_oldviewleaf = r_viewleaf;
 
+	if (R_MarkVisLeaf (r_viewleaf))
+		return;
+
 	vis = Mod_LeafPVS (r_viewleaf, cl.worldmodel);
 
 	for (i=0 ; i<cl.worldmodel->numleafs ; i++)
@@ -959,13 +975,17 @@ void R_RenderView_ (void)
 	if (r_timegraph.value || r_speeds.value || r_dspeeds.value)
 		r_time1 = Sys_FloatTime ();
 
+	Timing_Begin (TIME_SETUPFRAME);
 	R_SetupFrame ();
+	Timing_End (TIME_SETUPFRAME);
 
+	Timing_Begin (TIME_MARKLEAVES);
 #ifdef PASSAGES
 SetVisibilityByPassages ();
 #else
 	R_MarkLeaves ();	// done here so we know if we're in water
 #endif
+	Timing_End (TIME_MARKLEAVES);
 
 // make FDIV fast. This reduces timing precision after we've been running for a
 // while, so we don't do it globally.  This also sets chop mode, and we do it
@@ -983,7 +1003,9 @@ SetVisibilityByPassages ();
 		VID_LockBuffer ();
 	}
 
+	Timing_Begin (TIME_EDGES);
 	R_EdgeDrawing ();
+	Timing_End (TIME_EDGES);
 
 	if (!r_dspeeds.value)
 	{
@@ -998,7 +1020,9 @@ SetVisibilityByPassages ();
 		de_time1 = se_time2;
 	}
 
+	Timing_Begin (TIME_ENTITIES);
 	R_DrawEntitiesOnList ();
+	Timing_End (TIME_ENTITIES);
 
 	if (r_dspeeds.value)
 	{
@@ -1006,7 +1030,9 @@ SetVisibilityByPassages ();
 		dv_time1 = de_time2;
 	}
 
+	Timing_Begin (TIME_VIEWMODEL);
 	R_DrawViewModel ();
+	Timing_End (TIME_VIEWMODEL);
 
 	if (r_dspeeds.value)
 	{
@@ -1014,13 +1040,19 @@ SetVisibilityByPassages ();
 		dp_time1 = Sys_FloatTime ();
 	}
 
+	Timing_Begin (TIME_PARTICLES);
 	R_DrawParticles ();
+	Timing_End (TIME_PARTICLES);
 
 	if (r_dspeeds.value)
 		dp_time2 = Sys_FloatTime ();
 
 	if (r_dowarp)
+	{
+		Timing_Begin (TIME_WARP);
 		D_WarpScreen ();
+		Timing_End (TIME_WARP);
+	}
 
 	V_SetContentsColor (r_viewleaf->contents);
 
@@ -202,7 +202,10 @@ void R_PrintTimes (void)
 
 	Con_Printf ("%5.1f ms %3i/%3i/%3i poly %3i surf\n",
 				ms, c_faceclip, r_polycount, r_drawnpolycount, c_surf);
+	Con_Printf ("cache %3i hit %3i new %3i relit %3i on workers\n",
+				d_cachehits, d_cachenew, d_cacherelit, d_cacheprebuilt);
 	c_surf = 0;
+	d_cachehits = d_cachenew = d_cacherelit = d_cacheprebuilt = 0;
 }
 
 
@@ -228,6 +231,10 @@ void R_PrintDSpeeds (void)
 	Con_Printf ("%3i %4.1fp %3iw %4.1fb %3is %4.1fe %4.1fv\n",
 				(int)ms, dp_time, (int)rw_time, db_time, (int)se_time, de_time,
 				dv_time);
+	Con_Printf ("surfcache %ik: %3i alloc %i wrap %3i evict %3i reused %3i built %4ik set %4ik\n",
+				sc_size / 1024, d_cachestats.allocs, d_cachestats.wraps,
+				d_cachestats.evictions, d_cachestats.reused, d_cachestats.builds,
+				d_cachestats.bytesbuilt / 1024, d_cachestats.workingset / 1024);
 }
 
 
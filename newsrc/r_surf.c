@@ -22,20 +22,28 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "r_local.h"
 
-drawsurf_t	r_drawsurf;
-
-int				lightleft, sourcesstep, blocksize, sourcetstep;
-int				lightdelta, lightdeltastep;
-int				lightright, lightleftstep, lightrightstep, blockdivshift;
-unsigned		blockdivmask;
-void			*prowdestbase;
-unsigned char	*pbasesource;
-int				surfrowbytes;	// used by ASM files
-unsigned		*r_lightptr;
-int				r_stepback;
-int				r_lightwidth;
-int				r_numhblocks, r_numvblocks;
-unsigned char	*r_source, *r_sourcemax;
+#if !id386 && (defined(__x86_64__) || defined(__i386__))
+#define R_AVX2
+#include <immintrin.h>
+#endif
+
+// surfaces are built on the job workers (D_FlushSurfaceBuilds), so all
+// of the building state is per thread
+
+THREADLOCAL drawsurf_t	r_drawsurf;
+
+THREADLOCAL int				lightleft, sourcesstep, blocksize, sourcetstep;
+THREADLOCAL int				lightdelta, lightdeltastep;
+THREADLOCAL int				lightright, lightleftstep, lightrightstep, blockdivshift;
+THREADLOCAL unsigned		blockdivmask;
+THREADLOCAL void			*prowdestbase;
+THREADLOCAL unsigned char	*pbasesource;
+THREADLOCAL int				surfrowbytes;	// used by ASM files
+THREADLOCAL unsigned		*r_lightptr;
+THREADLOCAL int				r_stepback;
+THREADLOCAL int				r_lightwidth;
+THREADLOCAL int				r_numhblocks, r_numvblocks;
+THREADLOCAL unsigned char	*r_source, *r_sourcemax;
 
 void R_DrawSurfaceBlock8_mip0 (void);
 void R_DrawSurfaceBlock8_mip1 (void);
@@ -49,9 +57,25 @@ static void	(*surfmiptable[4])(void) = {
 	R_DrawSurfaceBlock8_mip3
 };
 
+#ifdef R_AVX2
+static void R_DrawSurfaceBlock8_mip0_AVX2 (void);
+static void R_DrawSurfaceBlock8_mip1_AVX2 (void);
+static void R_DrawSurfaceBlock8_mip2_AVX2 (void);
+static void R_AddLightmap_AVX2 (unsigned *dest, byte *lightmap, unsigned scale, int size);
+static void R_BoundLights_AVX2 (unsigned *dest, int size);
+
+// two texels a row is too narrow to gain anything at mip 3
+static void	(*surfmiptable_avx2[4])(void) = {
+	R_DrawSurfaceBlock8_mip0_AVX2,
+	R_DrawSurfaceBlock8_mip1_AVX2,
+	R_DrawSurfaceBlock8_mip2_AVX2,
+	R_DrawSurfaceBlock8_mip3
+};
+#endif
+
 
 
-unsigned		blocklights[18*18];
+THREADLOCAL unsigned	blocklights[18*18];
 
 /*
 ===============
@@ -181,6 +205,11 @@ void R_BuildLightMap (void)
 			 maps++)
 		{
 			scale = r_drawsurf.lightadj[maps];	// 8.8 fraction
+#ifdef R_AVX2
+			if (r_haveavx2 && r_simd.value)
+				R_AddLightmap_AVX2 (blocklights, lightmap, scale, size);
+			else
+#endif
 			for (i=0 ; i<size ; i++)
 				blocklights[i] += lightmap[i] * scale;
 			lightmap += size;	// skip to next lightmap
@@ -191,6 +220,14 @@ void R_BuildLightMap (void)
 		R_AddDynamicLights ();
 
 // bound, invert, and shift
+#ifdef R_AVX2
+	if (r_haveavx2 && r_simd.value)
+	{
+		R_BoundLights_AVX2 (blocklights, size);
+		return;
+	}
+#endif
+
 	for (i=0 ; i<size ; i++)
 	{
 		t = (255*256 - (int)blocklights[i]) >> (8 - VID_CBITS);
@@ -284,6 +321,10 @@ void R_DrawSurface (void)
 	if (r_pixbytes == 1)
 	{
 		pblockdrawer = surfmiptable[r_drawsurf.surfmip];
+#ifdef R_AVX2
+		if (r_haveavx2 && r_simd.value)
+			pblockdrawer = surfmiptable_avx2[r_drawsurf.surfmip];
+#endif
 	// TODO: only needs to be set when there is a display settings change
 		horzblockstep = blocksize;
 	}
@@ -585,6 +626,373 @@ void R_DrawSurfaceBlock16 (void)
 #endif
 
 
+//============================================================================
+
+#ifdef R_AVX2
+
+/*
+The vector kernels give exactly the same pixels as the C ones above.
+Lights are interpolated by multiplying the step instead of adding it
+texel by texel, which is the same integer, and the colormap is read with
+a gather.  Only called when the cpu has AVX2.
+*/
+
+/*
+================
+R_AddLightmap_AVX2
+================
+*/
+__attribute__((target("avx2")))
+static void R_AddLightmap_AVX2 (unsigned *dest, byte *lightmap, unsigned scale, int size)
+{
+	__m256i	vscale, l, d;
+	int		i;
+
+	vscale = _mm256_set1_epi32 (scale);
+
+	for (i=0 ; i+8<=size ; i+=8)
+	{
+		l = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((__m128i *)(lightmap + i)));
+		d = _mm256_loadu_si256 ((__m256i *)(dest + i));
+		d = _mm256_add_epi32 (d, _mm256_mullo_epi32 (l, vscale));
+		_mm256_storeu_si256 ((__m256i *)(dest + i), d);
+	}
+
+	for ( ; i<size ; i++)
+		dest[i] += lightmap[i] * scale;
+}
+
+/*
+================
+R_BoundLights_AVX2
+================
+*/
+__attribute__((target("avx2")))
+static void R_BoundLights_AVX2 (unsigned *dest, int size)
+{
+	__m256i	full, minlight, t;
+	int		i, s;
+
+	full = _mm256_set1_epi32 (255*256);
+	minlight = _mm256_set1_epi32 (1 << 6);
+
+	for (i=0 ; i+8<=size ; i+=8)
+	{
+		t = _mm256_loadu_si256 ((__m256i *)(dest + i));
+		t = _mm256_srai_epi32 (_mm256_sub_epi32 (full, t), 8 - VID_CBITS);
+		t = _mm256_max_epi32 (t, minlight);
+		_mm256_storeu_si256 ((__m256i *)(dest + i), t);
+	}
+
+	for ( ; i<size ; i++)
+	{
+		s = (255*256 - (int)dest[i]) >> (8 - VID_CBITS);
+		if (s < (1 << 6))
+			s = (1 << 6);
+		dest[i] = s;
+	}
+}
+
+/*
+================
+R_ShadeTexels_AVX2
+
+Eight texels through the colormap, the texel at index 7 getting light,
+and each one to the left of it another step more.  The colormap is read
+four bytes at a time ending at the wanted byte, so the read never runs
+past the end of it.
+================
+*/
+__attribute__((target("avx2")))
+static inline __m256i R_ShadeTexels_AVX2 (__m128i texels, int light, int lightstep, __m256i steps)
+{
+	__m256i	index;
+
+	index = _mm256_add_epi32 (_mm256_set1_epi32 (light),
+			_mm256_mullo_epi32 (steps, _mm256_set1_epi32 (lightstep)));
+	index = _mm256_and_si256 (index, _mm256_set1_epi32 (0xFF00));
+	index = _mm256_add_epi32 (index, _mm256_cvtepu8_epi32 (texels));
+
+	return _mm256_srli_epi32 (_mm256_i32gather_epi32 (
+			(int *)((byte *)vid.colormap - 3), index, 1), 24);
+}
+
+/*
+================
+R_DrawSurfaceBlock8_mip0_AVX2
+================
+*/
+__attribute__((target("avx2")))
+static void R_DrawSurfaceBlock8_mip0_AVX2 (void)
+{
+	int				v, i;
+	int				lightleft, lightright, lightleftstep, lightrightstep;
+	unsigned char	*psource, *prowdest;
+	unsigned		*lightptr;
+	__m128i			texels;
+	__m256i			lo, hi, steps_lo, steps_hi, words;
+
+	psource = pbasesource;
+	prowdest = prowdestbase;
+	lightptr = r_lightptr;
+
+// texel b gets lightright + (15-b) steps
+	steps_lo = _mm256_setr_epi32 (15, 14, 13, 12, 11, 10, 9, 8);
+	steps_hi = _mm256_setr_epi32 (7, 6, 5, 4, 3, 2, 1, 0);
+
+	for (v=0 ; v<r_numvblocks ; v++)
+	{
+		lightleft = lightptr[0];
+		lightright = lightptr[1];
+		lightptr += r_lightwidth;
+		lightleftstep = (lightptr[0] - lightleft) >> 4;
+		lightrightstep = (lightptr[1] - lightright) >> 4;
+
+		for (i=0 ; i<16 ; i++)
+		{
+			texels = _mm_loadu_si128 ((__m128i *)psource);
+			lo = R_ShadeTexels_AVX2 (texels, lightright,
+					(lightleft - lightright) >> 4, steps_lo);
+			hi = R_ShadeTexels_AVX2 (_mm_srli_si128 (texels, 8), lightright,
+					(lightleft - lightright) >> 4, steps_hi);
+
+			words = _mm256_permute4x64_epi64 (_mm256_packus_epi32 (lo, hi), 0xD8);
+			_mm_storeu_si128 ((__m128i *)prowdest, _mm_packus_epi16 (
+					_mm256_castsi256_si128 (words),
+					_mm256_extracti128_si256 (words, 1)));
+
+			psource += sourcetstep;
+			lightright += lightrightstep;
+			lightleft += lightleftstep;
+			prowdest += surfrowbytes;
+		}
+
+		if (psource >= r_sourcemax)
+			psource -= r_stepback;
+	}
+
+	r_lightptr = lightptr;
+}
+
+/*
+================
+R_DrawSurfaceBlock8_mip1_AVX2
+================
+*/
+__attribute__((target("avx2")))
+static void R_DrawSurfaceBlock8_mip1_AVX2 (void)
+{
+	int				v, i;
+	int				lightleft, lightright, lightleftstep, lightrightstep;
+	unsigned char	*psource, *prowdest;
+	unsigned		*lightptr;
+	__m256i			texels, steps;
+	__m128i			words;
+
+	psource = pbasesource;
+	prowdest = prowdestbase;
+	lightptr = r_lightptr;
+
+	steps = _mm256_setr_epi32 (7, 6, 5, 4, 3, 2, 1, 0);
+
+	for (v=0 ; v<r_numvblocks ; v++)
+	{
+		lightleft = lightptr[0];
+		lightright = lightptr[1];
+		lightptr += r_lightwidth;
+		lightleftstep = (lightptr[0] - lightleft) >> 3;
+		lightrightstep = (lightptr[1] - lightright) >> 3;
+
+		for (i=0 ; i<8 ; i++)
+		{
+			texels = R_ShadeTexels_AVX2 (_mm_loadl_epi64 ((__m128i *)psource),
+					lightright, (lightleft - lightright) >> 3, steps);
+
+			words = _mm_packus_epi32 (_mm256_castsi256_si128 (texels),
+					_mm256_extracti128_si256 (texels, 1));
+			_mm_storel_epi64 ((__m128i *)prowdest, _mm_packus_epi16 (words, words));
+
+			psource += sourcetstep;
+			lightright += lightrightstep;
+			lightleft += lightleftstep;
+			prowdest += surfrowbytes;
+		}
+
+		if (psource >= r_sourcemax)
+			psource -= r_stepback;
+	}
+
+	r_lightptr = lightptr;
+}
+
+/*
+================
+R_DrawSurfaceBlock8_mip2_AVX2
+
+Four texels a row, so half of each gather goes unused, but that is
+still one gather against four dependent loads
+================
+*/
+__attribute__((target("avx2")))
+static void R_DrawSurfaceBlock8_mip2_AVX2 (void)
+{
+	int				v, i, four;
+	int				lightleft, lightright, lightleftstep, lightrightstep;
+	unsigned char	*psource, *prowdest;
+	unsigned		*lightptr;
+	__m256i			texels, steps;
+	__m128i			words;
+
+	psource = pbasesource;
+	prowdest = prowdestbase;
+	lightptr = r_lightptr;
+
+	steps = _mm256_setr_epi32 (3, 2, 1, 0, 0, 0, 0, 0);
+
+	for (v=0 ; v<r_numvblocks ; v++)
+	{
+		lightleft = lightptr[0];
+		lightright = lightptr[1];
+		lightptr += r_lightwidth;
+		lightleftstep = (lightptr[0] - lightleft) >> 2;
+		lightrightstep = (lightptr[1] - lightright) >> 2;
+
+		for (i=0 ; i<4 ; i++)
+		{
+			memcpy (&four, psource, 4);
+			texels = R_ShadeTexels_AVX2 (_mm_cvtsi32_si128 (four),
+					lightright, (lightleft - lightright) >> 2, steps);
+
+			words = _mm_packus_epi32 (_mm256_castsi256_si128 (texels),
+					_mm256_castsi256_si128 (texels));
+			four = _mm_cvtsi128_si32 (_mm_packus_epi16 (words, words));
+			memcpy (prowdest, &four, 4);
+
+			psource += sourcetstep;
+			lightright += lightrightstep;
+			lightleft += lightleftstep;
+			prowdest += surfrowbytes;
+		}
+
+		if (psource >= r_sourcemax)
+			psource -= r_stepback;
+	}
+
+	r_lightptr = lightptr;
+}
+
+#endif	// R_AVX2
+
+/*
+================
+R_SurfBench_f
+
+surfbench [count]
+
+Runs the block drawers and the lightmap accumulation on random data with
+the C and the vector kernels, checks they agree byte for byte, and times
+them
+================
+*/
+void R_SurfBench_f (void)
+{
+	static byte		source[256*256*2];
+	static byte		dest[2][16*16*16];
+	static unsigned	lights[18*18];
+	static unsigned	accum[2][18*18];
+	static byte		lightmap[18*18];
+	int				mip, i, j, n, t, count, numblocks;
+	double			start, time[2];
+	void			(*drawers[2])(void);
+
+	count = 2000;
+	if (Cmd_Argc () > 1)
+		count = Q_atoi (Cmd_Argv (1));
+	if (count < 1)
+		count = 1;
+
+#ifdef R_AVX2
+	if (!r_haveavx2)
+#endif
+	{
+		Con_Printf ("no vector kernels for this cpu\n");
+		return;
+	}
+
+#ifdef R_AVX2
+	for (i=0 ; i<sizeof(source) ; i++)
+		source[i] = rand ();
+	for (i=0 ; i<18*18 ; i++)
+	{
+		lights[i] = (1 << 6) + rand () % (255*256 >> 2);
+		lightmap[i] = rand ();
+	}
+
+	numblocks = 16;		// down one column of a 256 texel high surface
+
+	for (mip=0 ; mip<4 ; mip++)
+	{
+		drawers[0] = surfmiptable[mip];
+		drawers[1] = surfmiptable_avx2[mip];
+
+		for (n=0 ; n<2 ; n++)
+		{
+			start = Sys_FloatTime ();
+			for (i=0 ; i<count ; i++)
+			{
+				blocksize = 16 >> mip;
+				sourcetstep = 256 >> mip;
+				surfrowbytes = blocksize;
+				r_lightwidth = 2;
+				r_numvblocks = numblocks;
+				r_sourcemax = source + (256 >> mip) * (256 >> mip);
+				r_stepback = (256 >> mip) * (256 >> mip);
+				r_lightptr = lights;
+				pbasesource = source + (i & 7) * blocksize;
+				prowdestbase = dest[n];
+				drawers[n] ();
+			}
+			time[n] = Sys_FloatTime () - start;
+		}
+
+		Con_Printf ("mip %i: %6.1f ns c %6.1f ns avx2 per block, %s\n", mip,
+				time[0] * 1e9 / (count * numblocks),
+				time[1] * 1e9 / (count * numblocks),
+				memcmp (dest[0], dest[1], blocksize * blocksize * numblocks)
+				? "MISMATCH" : "identical");
+	}
+
+	for (n=0 ; n<2 ; n++)
+	{
+		start = Sys_FloatTime ();
+		for (i=0 ; i<count ; i++)
+		{
+			memset (accum[n], 0, sizeof(accum[n]));
+			if (n)
+			{
+				R_AddLightmap_AVX2 (accum[n], lightmap, 264, 18*18);
+				R_BoundLights_AVX2 (accum[n], 18*18);
+			}
+			else
+			{
+				for (j=0 ; j<18*18 ; j++)
+					accum[n][j] += lightmap[j] * 264;
+				for (j=0 ; j<18*18 ; j++)
+				{
+					t = (255*256 - (int)accum[n][j]) >> (8 - VID_CBITS);
+					accum[n][j] = t < (1 << 6) ? (1 << 6) : t;
+				}
+			}
+		}
+		time[n] = Sys_FloatTime () - start;
+	}
+
+	Con_Printf ("lightmap: %6.1f ns c %6.1f ns avx2 per 18x18, %s\n",
+			time[0] * 1e9 / count, time[1] * 1e9 / count,
+			memcmp (accum[0], accum[1], sizeof(accum[0])) ? "MISMATCH" : "identical");
+#endif
+}
+
 //============================================================================
 
 /*
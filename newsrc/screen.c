@@ -953,8 +953,6 @@ void SCR_UpdateScreen (void)
 		vrect.width = vid.width;
 		vrect.height = vid.height;
 		vrect.pnext = 0;
-
-		VID_Update (&vrect);
 	}
 	else if (scr_copytop)
 	{
@@ -963,8 +961,6 @@ void SCR_UpdateScreen (void)
 		vrect.width = vid.width;
 		vrect.height = vid.height - sb_lines;
 		vrect.pnext = 0;
-
-		VID_Update (&vrect);
 	}
 	else
 	{
@@ -973,9 +969,11 @@ void SCR_UpdateScreen (void)
 		vrect.width = scr_vrect.width;
 		vrect.height = scr_vrect.height;
 		vrect.pnext = 0;
-
-		VID_Update (&vrect);
 	}
+
+	Timing_Begin (TIME_VIDUPDATE);
+	VID_Update (&vrect);
+	Timing_End (TIME_VIDUPDATE);
 }
 
 
@@ -24,6 +24,7 @@ typedef struct
 	int			maxclients;
 	int			maxclientslimit;
 	struct client_s	*clients;		// [maxclients]
+	struct entsched_s	*entsched;	// [maxclientslimit][MAX_EDICTS]
 	int			serverflags;		// episode completion information
 	qboolean	changelevel_issued;	// cleared when at SV_SpawnServer
 } server_static_t;
@@ -61,6 +62,8 @@ typedef struct
 									// be used to reference the world ent
 	server_state_t	state;			// some actions are only valid during load
 
+	int			protocol;			// PROTOCOL_VERSION or PROTOCOL_BITPACKED
+
 	sizebuf_t	datagram;
 	byte		datagram_buf[MAX_DATAGRAM];
 
@@ -75,6 +78,18 @@ typedef struct
 #define	NUM_PING_TIMES		16
 #define	NUM_SPAWN_PARMS		16
 
+// per client, per entity update bookkeeping for the datagram scheduler
+typedef struct entsched_s
+{
+	double			lastsent;			// realtime of the last update, 0 = never
+	int				lastupdate;			// client->updates when it was last sent
+	double			waiting;			// realtime it was first left out, 0 = not waiting
+	int				updates;
+	int				starved;			// frames it was visible but didn't fit
+	float			totallatency;		// seconds spent waiting, over all updates
+	float			maxlatency;
+} entsched_t;
+
 typedef struct client_s
 {
 	qboolean		active;				// false = client is free
@@ -106,6 +121,12 @@ typedef struct client_s
 
 // client known data for deltas
 	int				old_frags;
+
+// entity update scheduling, see SV_WriteEntitiesToClient
+	double			last_datagram;		// realtime of the last datagram
+	float			rate_credit;		// bytes sv_rate allows right now
+	int				updates;			// datagrams with entity updates sent
+	entsched_t		*entsched;			// [MAX_EDICTS] in svs.entsched
 } client_t;
 
 
@@ -201,6 +222,8 @@ extern	cvar_t	deathmatch;
 extern	cvar_t	coop;
 extern	cvar_t	fraglimit;
 extern	cvar_t	timelimit;
+extern	cvar_t	sv_rate;
+extern	cvar_t	sv_protocol;
 
 extern	server_static_t	svs;				// persistant server info
 extern	server_t		sv;					// local server
@@ -213,6 +236,18 @@ extern	double		host_time;
 
 extern	edict_t		*sv_player;
 
+// where the last SV_SpawnServer spent its time
+typedef struct
+{
+	double		progs;
+	double		world;				// world and inline models
+	double		entities;			// spawn functions and their precaches
+	double		settle;				// physics frames and baselines
+	double		total;
+} spawntimes_t;
+
+extern	spawntimes_t	sv_spawntimes;
+
 //===========================================================
 
 void SV_Init (void);
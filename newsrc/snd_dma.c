@@ -307,6 +307,24 @@ void S_TouchSound (char *name)
 	Cache_Check (&sfx->cache);
 }
 
+/*
+==================
+S_PrefetchSound
+
+==================
+*/
+void S_PrefetchSound (char *name)
+{
+	sfx_t	*sfx;
+
+	if (!sound_started || nosound.value || !precache.value)
+		return;
+
+	sfx = S_FindName (name);
+	if (!Cache_Check (&sfx->cache))
+		S_StartPrefetch (sfx);
+}
+
 /*
 ==================
 S_PrecacheSound
@@ -1004,4 +1022,5 @@ void S_BeginPrecaching (void)
 
 void S_EndPrecaching (void)
 {
+	S_FlushPrefetch ();
 }
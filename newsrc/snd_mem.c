@@ -25,12 +25,17 @@ int cache_full_cycle;
 
 byte *S_Alloc(int size);
 
+static sfxcache_t *S_InstallPrefetch(sfx_t *s);
+
 /*
 ================
-ResampleSfx
+S_Resample
+
+Converts the samples at data into sc, whose header still describes the
+source.  Only touches sc and shm, so it can run on a worker thread.
 ================
 */
-void ResampleSfx(sfx_t *sfx, int inrate, int inwidth, byte *data) {
+static void S_Resample(sfxcache_t *sc, int inrate, int inwidth, byte *data) {
 	int outcount;
 	int srcsample;
 	float stepscale;
@@ -38,13 +43,6 @@ void ResampleSfx(sfx_t *sfx, int inrate, int inwidth, byte *data) {
 	int sample;
 	int samplefrac;
 	int fracstep;
-	sfxcache_t *sc;
-
-	sc = Cache_Check(&sfx->cache);
-
-	if (!sc) {
-		return;
-	}
 
 	stepscale = (float)inrate / shm->speed;  // this is usually 0.5, 1, or 2
 
@@ -95,6 +93,23 @@ void ResampleSfx(sfx_t *sfx, int inrate, int inwidth, byte *data) {
 	}
 }
 
+/*
+================
+ResampleSfx
+================
+*/
+void ResampleSfx(sfx_t *sfx, int inrate, int inwidth, byte *data) {
+	sfxcache_t *sc;
+
+	sc = Cache_Check(&sfx->cache);
+
+	if (!sc) {
+		return;
+	}
+
+	S_Resample(sc, inrate, inwidth, data);
+}
+
 //=============================================================================
 
 /*
@@ -118,6 +133,13 @@ sfxcache_t *S_LoadSound(sfx_t *s) {
 		return sc;
 	}
 
+	// decoded ahead of time by S_PrefetchSound
+	sc = S_InstallPrefetch(s);
+
+	if (sc) {
+		return sc;
+	}
+
 	// Con_Printf("S_LoadSound: %x\n", (int)stackbuf);
 	// load it in
 	Q_strcpy(namebuffer, "sound/");
@@ -172,179 +194,397 @@ WAV loading
 */
 
 
-byte *data_p;
-byte *iff_end;
-byte *last_chunk;
-byte *iff_data;
-int iff_chunk_len;
+typedef struct {
+	byte *data_p;
+	byte *iff_end;
+	byte *last_chunk;
+	byte *iff_data;
+	int iff_chunk_len;
+} iffstate_t;
 
 
-short GetLittleShort(void) {
+short GetLittleShort(iffstate_t *iff) {
 	short val = 0;
-	val = *data_p;
-	val = val + (*(data_p + 1) << 8);
-	data_p += 2;
+	val = *iff->data_p;
+	val = val + (*(iff->data_p + 1) << 8);
+	iff->data_p += 2;
 	return val;
 }
 
-int GetLittleLong(void) {
+int GetLittleLong(iffstate_t *iff) {
 	int val = 0;
-	val = *data_p;
-	val = val + (*(data_p + 1) << 8);
-	val = val + (*(data_p + 2) << 16);
-	val = val + (*(data_p + 3) << 24);
-	data_p += 4;
+	val = *iff->data_p;
+	val = val + (*(iff->data_p + 1) << 8);
+	val = val + (*(iff->data_p + 2) << 16);
+	val = val + (*(iff->data_p + 3) << 24);
+	iff->data_p += 4;
 	return val;
 }
 
-void FindNextChunk(char *name) {
+void FindNextChunk(iffstate_t *iff, char *name) {
 	while (1) {
-		data_p = last_chunk;
+		iff->data_p = iff->last_chunk;
 
-		if (data_p >= iff_end) {
+		if (iff->data_p >= iff->iff_end) {
 			// didn't find the chunk
-			data_p = NULL;
+			iff->data_p = NULL;
 			return;
 		}
 
-		data_p += 4;
-		iff_chunk_len = GetLittleLong();
+		iff->data_p += 4;
+		iff->iff_chunk_len = GetLittleLong(iff);
 
-		if (iff_chunk_len < 0) {
-			data_p = NULL;
+		if (iff->iff_chunk_len < 0) {
+			iff->data_p = NULL;
 			return;
 		}
 
-		// if (iff_chunk_len > 1024*1024) {
-		// 	Sys_Error("FindNextChunk: %i length is past the 1 meg sanity limit", iff_chunk_len);
+		// if (iff->iff_chunk_len > 1024*1024) {
+		// 	Sys_Error("FindNextChunk: %i length is past the 1 meg sanity limit", iff->iff_chunk_len);
 		// }
 
-		data_p -= 8;
-		last_chunk = data_p + 8 + ( (iff_chunk_len + 1) & ~1 );
+		iff->data_p -= 8;
+		iff->last_chunk = iff->data_p + 8 + ( (iff->iff_chunk_len + 1) & ~1 );
 
-		if (!Q_strncmp((char*)data_p, name, 4)) {
+		if (!Q_strncmp((char*)iff->data_p, name, 4)) {
 			return;
 		}
 	}
 }
 
-void FindChunk(char *name) {
-	last_chunk = iff_data;
-	FindNextChunk(name);
+void FindChunk(iffstate_t *iff, char *name) {
+	iff->last_chunk = iff->iff_data;
+	FindNextChunk(iff, name);
 }
 
 
-void DumpChunks(void) {
+void DumpChunks(iffstate_t *iff) {
 	char str[5];
 
 	str[4] = 0;
-	data_p = iff_data;
+	iff->data_p = iff->iff_data;
 
 	do {
-		memcpy(str, data_p, 4);
-		data_p += 4;
-		iff_chunk_len = GetLittleLong();
-		Con_Printf("0x%x : %s (%d)\n", (int)(data_p - 4), str, iff_chunk_len);
-		data_p += (iff_chunk_len + 1) & ~1;
-	} while (data_p < iff_end);
+		memcpy(str, iff->data_p, 4);
+		iff->data_p += 4;
+		iff->iff_chunk_len = GetLittleLong(iff);
+		Con_Printf("0x%x : %s (%d)\n", (int)(iff->data_p - 4), str, iff->iff_chunk_len);
+		iff->data_p += (iff->iff_chunk_len + 1) & ~1;
+	} while (iff->data_p < iff->iff_end);
 }
 
+static char wav_badloop[] = "bad loop length";
+
 /*
 ============
-GetWavinfo
+ParseWavinfo
+
+Returns an error message, or NULL.  Doesn't print, so it can run on a
+worker thread.
 ============
 */
-wavinfo_t GetWavinfo(char *name, byte *wav, int wavlength) {
-	wavinfo_t info;
+static char *ParseWavinfo(byte *wav, int wavlength, wavinfo_t *info) {
+	iffstate_t iff;
 	int i;
 	int format;
 	int samples;
 
-	memset(&info, 0, sizeof(info));
-
-	if (!wav) {
-		return info;
-	}
-
-	iff_data = wav;
-	iff_end = wav + wavlength;
+	iff.iff_data = wav;
+	iff.iff_end = wav + wavlength;
 
 	// find "RIFF" chunk
-	FindChunk("RIFF");
+	FindChunk(&iff, "RIFF");
 
-	if (!(data_p && !Q_strncmp((char*)data_p + 8, "WAVE", 4))) {
-		Con_Printf("Missing RIFF/WAVE chunks\n");
-		return info;
+	if (!(iff.data_p && !Q_strncmp((char*)iff.data_p + 8, "WAVE", 4))) {
+		return "Missing RIFF/WAVE chunks";
 	}
 
 	// get "fmt " chunk
-	iff_data = data_p + 12;
-	// DumpChunks();
+	iff.iff_data = iff.data_p + 12;
+	// DumpChunks(&iff);
 
-	FindChunk("fmt ");
+	FindChunk(&iff, "fmt ");
 
-	if (!data_p) {
-		Con_Printf("Missing fmt chunk\n");
-		return info;
+	if (!iff.data_p) {
+		return "Missing fmt chunk";
 	}
 
-	data_p += 8;
-	format = GetLittleShort();
+	iff.data_p += 8;
+	format = GetLittleShort(&iff);
 
 	if (format != 1) {
-		Con_Printf("Microsoft PCM format only\n");
-		return info;
+		return "Microsoft PCM format only";
 	}
 
-	info.channels = GetLittleShort();
-	info.rate = GetLittleLong();
-	data_p += 4 + 2;
-	info.width = GetLittleShort() / 8;
+	info->channels = GetLittleShort(&iff);
+	info->rate = GetLittleLong(&iff);
+	iff.data_p += 4 + 2;
+	info->width = GetLittleShort(&iff) / 8;
 
 	// get cue chunk
-	FindChunk("cue ");
+	FindChunk(&iff, "cue ");
 
-	if (data_p) {
-		data_p += 32;
-		info.loopstart = GetLittleLong();
+	if (iff.data_p) {
+		iff.data_p += 32;
+		info->loopstart = GetLittleLong(&iff);
 		// Con_Printf("loopstart=%d\n", sfx->loopstart);
 
 		// if the next chunk is a LIST chunk, look for a cue length marker
-		FindNextChunk ("LIST");
+		FindNextChunk (&iff, "LIST");
 
-		if (data_p) {
-			if (!strncmp((char*)data_p + 28, "mark", 4)) {
+		if (iff.data_p) {
+			if (!strncmp((char*)iff.data_p + 28, "mark", 4)) {
 				// this is not a proper parse, but it works with cooledit...
-				data_p += 24;
-				i = GetLittleLong();	// samples in loop
-				info.samples = info.loopstart + i;
+				iff.data_p += 24;
+				i = GetLittleLong(&iff);	// samples in loop
+				info->samples = info->loopstart + i;
 				// Con_Printf("looped length: %i\n", i);
 			}
 		}
 	} else {
-		info.loopstart = -1;
+		info->loopstart = -1;
 	}
 
 	// find data chunk
-	FindChunk("data");
+	FindChunk(&iff, "data");
 
-	if (!data_p) {
-		Con_Printf("Missing data chunk\n");
-		return info;
+	if (!iff.data_p) {
+		return "Missing data chunk";
 	}
 
-	data_p += 4;
-	samples = GetLittleLong () / info.width;
+	iff.data_p += 4;
+	samples = GetLittleLong (&iff) / info->width;
 
-	if (info.samples){
-		if (samples < info.samples) {
-			Sys_Error ("Sound %s has a bad loop length", name);
+	if (info->samples){
+		if (samples < info->samples) {
+			return wav_badloop;
 		}
 	} else {
-		info.samples = samples;
+		info->samples = samples;
+	}
+
+	info->dataofs = iff.data_p - wav;
+
+	return NULL;
+}
+
+/*
+============
+WavError
+============
+*/
+static void WavError(char *name, char *error) {
+	if (error == wav_badloop) {
+		Sys_Error ("Sound %s has a bad loop length", name);
+	}
+
+	Con_Printf("%s\n", error);
+}
+
+/*
+============
+GetWavinfo
+============
+*/
+wavinfo_t GetWavinfo(char *name, byte *wav, int wavlength) {
+	wavinfo_t info;
+	char *error;
+
+	memset(&info, 0, sizeof(info));
+
+	if (!wav) {
+		return info;
 	}
 
-	info.dataofs = data_p - wav;
+	error = ParseWavinfo(wav, wavlength, &info);
+
+	if (error) {
+		WavError(name, error);
+	}
 
 	return info;
 }
+
+
+/*
+===============================================================================
+
+SOUND PREFETCH
+
+S_PrefetchSound reads, parses and resamples a sound on a worker thread
+into malloced memory.  When S_LoadSound gets to it, all that's left is
+the cache allocation and a copy.
+
+===============================================================================
+*/
+
+typedef struct {
+	sfx_t *sfx;
+	filelocation_t loc;
+	wavinfo_t info;
+	sfxcache_t *decoded;  // malloced, NULL if there was nothing to decode
+	int size;
+	double time;  // spent decoding on the worker
+	qboolean used;
+	job_t job;
+} soundload_t;
+
+static soundload_t s_prefetch[MAX_SOUNDS];
+static int s_numprefetch;
+
+soundstats_t s_prefetchstats;
+
+/*
+================
+S_DecodeJob
+================
+*/
+static void S_DecodeJob(void *data) {
+	soundload_t *sl = data;
+	byte *file;
+	float stepscale;
+	int len;
+	double start;
+
+	start = Sys_FloatTime();
+
+	file = malloc(sl->loc.length);
+
+	if (!file || !COM_ReadLocation(&sl->loc, file)) {
+		free(file);
+		return;
+	}
+
+	if (ParseWavinfo(file, sl->loc.length, &sl->info) || sl->info.channels != 1) {
+		free(file);
+		return;
+	}
+
+	// the same size S_LoadSound allocates
+	stepscale = (float)sl->info.rate / shm->speed;
+	len = sl->info.samples / stepscale;
+	len = len * sl->info.width * sl->info.channels;
+
+	sl->size = len + sizeof(sfxcache_t);
+	sl->decoded = malloc(sl->size);
+
+	if (sl->decoded) {
+		sl->decoded->length = sl->info.samples;
+		sl->decoded->loopstart = sl->info.loopstart;
+		sl->decoded->speed = sl->info.rate;
+		sl->decoded->width = sl->info.width;
+		sl->decoded->stereo = sl->info.channels;
+
+		S_Resample(
+				sl->decoded,
+				sl->decoded->speed,
+				sl->decoded->width,
+				file + sl->info.dataofs);
+	}
+
+	free(file);
+
+	sl->time = Sys_FloatTime() - start;
+}
+
+/*
+================
+S_StartPrefetch
+
+Called by S_PrefetchSound for sounds that aren't in the cache
+================
+*/
+void S_StartPrefetch(sfx_t *s) {
+	char namebuffer[256];
+	soundload_t *sl;
+	int i;
+
+	if (s_numprefetch == MAX_SOUNDS) {
+		return;
+	}
+
+	for (i = 0; i < s_numprefetch; i++) {
+		if (s_prefetch[i].sfx == s) {
+			return;
+		}
+	}
+
+	sl = &s_prefetch[s_numprefetch];
+	memset(sl, 0, sizeof(*sl));
+
+	Q_strcpy(namebuffer, "sound/");
+	Q_strcat(namebuffer, s->name);
+
+	if (!COM_LocateFile(namebuffer, &sl->loc)) {
+		return;  // S_LoadSound will complain
+	}
+
+	sl->sfx = s;
+	s_numprefetch++;
+	s_prefetchstats.sounds++;
+
+	Job_Submit(&sl->job, S_DecodeJob, sl);
+}
+
+/*
+================
+S_InstallPrefetch
+================
+*/
+static sfxcache_t *S_InstallPrefetch(sfx_t *s) {
+	soundload_t *sl;
+	sfxcache_t *sc;
+	double start;
+	int i;
+
+	for (i = 0, sl = s_prefetch; i < s_numprefetch; i++, sl++) {
+		if (sl->sfx == s && !sl->used) {
+			break;
+		}
+	}
+
+	if (i == s_numprefetch) {
+		return NULL;
+	}
+
+	start = Sys_FloatTime();
+	Job_Wait(&sl->job);
+	s_prefetchstats.wait += Sys_FloatTime() - start;
+	s_prefetchstats.decode += sl->time;
+
+	sl->used = true;
+
+	// anything that went wrong is left to the normal load, which reports it
+	if (!sl->decoded) {
+		return NULL;
+	}
+
+	sc = Cache_Alloc(&s->cache, sl->size, s->name);
+
+	if (sc) {
+		memcpy(sc, sl->decoded, sl->size);
+	}
+
+	free(sl->decoded);
+	sl->decoded = NULL;
+
+	return sc;
+}
+
+/*
+================
+S_FlushPrefetch
+================
+*/
+void S_FlushPrefetch(void) {
+	soundload_t *sl;
+	int i;
+
+	for (i = 0, sl = s_prefetch; i < s_numprefetch; i++, sl++) {
+		Job_Wait(&sl->job);
+		COM_ReleaseLocation(&sl->loc);
+		free(sl->decoded);
+	}
+
+	s_numprefetch = 0;
+}
@@ -105,6 +105,19 @@ void S_TouchSound(char *sample);
 void S_ClearPrecache(void);
 void S_BeginPrecaching(void);
 void S_EndPrecaching(void);
+
+// starts loading a sound on a worker thread, S_PrecacheSound picks it up
+void S_PrefetchSound(char *sample);
+void S_StartPrefetch(sfx_t *s);
+void S_FlushPrefetch(void);
+
+typedef struct {
+	int sounds;
+	double decode;  // worker time
+	double wait;  // main thread time spent waiting for workers
+} soundstats_t;
+
+extern soundstats_t s_prefetchstats;
 void S_PaintChannels(int endtime);
 void S_InitPaintChannels(void);
 
@@ -26,6 +26,8 @@ server_static_t	svs;
 
 char	localmodels[MAX_MODELS][5];			// inline model names for precache
 
+void SV_EntStats_f (void);
+
 //============================================================================
 
 /*
@@ -57,6 +59,10 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_idealpitchscale);
 	Cvar_RegisterVariable (&sv_aim);
 	Cvar_RegisterVariable (&sv_nostep);
+	Cvar_RegisterVariable (&sv_rate);
+	Cvar_RegisterVariable (&sv_protocol);
+
+	Cmd_AddCommand ("sv_entstats", SV_EntStats_f);
 
 	for (i=0 ; i<MAX_MODELS ; i++)
 		sprintf (localmodels[i], "*%i", i);
@@ -196,7 +202,7 @@ void SV_SendServerinfo (client_t *client)
 	MSG_WriteString (&client->message,message);
 
 	MSG_WriteByte (&client->message, svc_serverinfo);
-	MSG_WriteLong (&client->message, PROTOCOL_VERSION);
+	MSG_WriteLong (&client->message, sv.protocol);
 	MSG_WriteByte (&client->message, svs.maxclients);
 
 	if (!coop.value && deathmatch.value)
@@ -228,6 +234,9 @@ void SV_SendServerinfo (client_t *client)
 	MSG_WriteByte (&client->message, svc_signonnum);
 	MSG_WriteByte (&client->message, 1);
 
+// entity numbers mean something else on a new level
+	memset (client->entsched, 0, MAX_EDICTS*sizeof(entsched_t));
+
 	client->sendsignon = true;
 	client->spawned = false;		// need prespawn, spawn, etc
 }
@@ -264,6 +273,8 @@ void SV_ConnectClient (int clientnum)
 		memcpy (spawn_parms, client->spawn_parms, sizeof(spawn_parms));
 	memset (client, 0, sizeof(*client));
 	client->netconnection = netconnection;
+	client->entsched = svs.entsched + clientnum*MAX_EDICTS;
+	net_serverstatechanged = true;
 
 	strcpy (client->name, "unconnected");
 	client->active = true;
@@ -304,6 +315,9 @@ void SV_CheckForNewClients (void)
 	struct qsocket_s	*ret;
 	int				i;
 
+// let the query responder see this frame's state
+	NET_PublishServerState ();
+
 //
 // check for new connections
 //
@@ -418,26 +432,327 @@ byte *SV_FatPVS (vec3_t org)
 //=============================================================================
 
 
+/*
+=============================================================================
+
+ENTITY UPDATE SCHEDULING
+
+A client can often see more entities than fit in its datagram.  Rather than
+dropping whatever happens to be late in the edict list, the visible entities
+are scored and written in priority order.  An entity that doesn't fit keeps
+waiting, which raises its score until it gets through.
+
+=============================================================================
+*/
+
+cvar_t	sv_rate = {"sv_rate", "0"};		// bytes per second per client, 0 = no limit
+cvar_t	sv_protocol = {"sv_protocol", "15"};	// takes effect on the next map
+
+typedef struct
+{
+	int		num;
+	float	priority;
+} entpriority_t;
+
+static entpriority_t	sendlist[MAX_EDICTS];
+
+/*
+=============
+SV_EntityPriority
+
+Higher scores are sent first
+=============
+*/
+float SV_EntityPriority (client_t *client, edict_t *ent, int e)
+{
+	entsched_t	*sched;
+	vec3_t		center, delta;
+	float		priority, wait;
+
+	if (ent == client->edict)
+		return 1e30;		// the client's own entity always goes first
+
+	if (e <= svs.maxclients)
+		priority = 4;
+	else if ((int)ent->v.flags & FL_MONSTER)
+		priority = 2;
+	else if ((int)ent->v.flags & FL_ITEM)
+		priority = 0.5;
+	else
+		priority = 1;
+
+// closer is more important.  brush models have their origin at 0 0 0, so
+// use the middle of the bounding box
+	VectorAdd (ent->v.absmin, ent->v.absmax, center);
+	VectorScale (center, 0.5, center);
+	VectorSubtract (center, client->edict->v.origin, delta);
+	priority *= 512 / (512 + Length (delta));
+
+// moving things go stale faster
+	priority *= 1 + Length (ent->v.velocity) / 320;
+
+// anything left out grows more urgent every frame it waits
+	sched = &client->entsched[e];
+	if (sched->waiting)
+		wait = realtime - sched->waiting;
+	else if (sched->lastsent)
+		wait = realtime - sched->lastsent;
+	else
+		wait = 1;
+	if (wait > 1)
+		wait = 1;
+	priority *= 1 + wait * 20;
+
+	return priority;
+}
+
+int SV_ComparePriority (const void *a, const void *b)
+{
+	const entpriority_t	*pa = a;
+	const entpriority_t	*pb = b;
+
+	if (pa->priority > pb->priority)
+		return -1;
+	if (pa->priority < pb->priority)
+		return 1;
+	return pa->num - pb->num;	// keep ties in edict order
+}
+
+/*
+=============
+SV_EntityUpdateBits
+
+=============
+*/
+int SV_EntityUpdateBits (edict_t *ent, int e)
+{
+	int		i;
+	int		bits;
+	float	miss;
+
+	bits = 0;
+
+	for (i=0 ; i<3 ; i++)
+	{
+		miss = ent->v.origin[i] - ent->baseline.origin[i];
+		if ( miss < -0.1 || miss > 0.1 )
+			bits |= U_ORIGIN1<<i;
+	}
+
+	if ( ent->v.angles[0] != ent->baseline.angles[0] )
+		bits |= U_ANGLE1;
+
+	if ( ent->v.angles[1] != ent->baseline.angles[1] )
+		bits |= U_ANGLE2;
+
+	if ( ent->v.angles[2] != ent->baseline.angles[2] )
+		bits |= U_ANGLE3;
+
+	if (ent->v.movetype == MOVETYPE_STEP)
+		bits |= U_NOLERP;	// don't mess up the step animation
+
+	if (ent->baseline.colormap != ent->v.colormap)
+		bits |= U_COLORMAP;
+
+	if (ent->baseline.skin != ent->v.skin)
+		bits |= U_SKIN;
+
+	if (ent->baseline.frame != ent->v.frame)
+		bits |= U_FRAME;
+
+	if (ent->baseline.effects != ent->v.effects)
+		bits |= U_EFFECTS;
+
+	if (ent->baseline.modelindex != ent->v.modelindex)
+		bits |= U_MODEL;
+
+	if (e >= 256)
+		bits |= U_LONGENTITY;
+
+	if (bits >= 256)
+		bits |= U_MOREBITS;
+
+	return bits;
+}
+
+/*
+=============
+SV_EntityUpdateSize
+
+Number of bytes SV_WriteEntityUpdate will write for the given bits
+=============
+*/
+int SV_EntityUpdateSize (edict_t *ent, int bits)
+{
+	int		size;
+	int		fieldbits;
+	int		i;
+
+	size = 2;		// bits and entity number
+	if (bits & U_MOREBITS)
+		size++;
+	if (bits & U_LONGENTITY)
+		size++;
+
+	if (sv.protocol == PROTOCOL_BITPACKED)
+	{
+		fieldbits = 0;
+		if (bits & U_MODEL)
+			fieldbits += 8;
+		if (bits & U_FRAME)
+			fieldbits += 8;
+		if (bits & U_COLORMAP)
+			fieldbits += 8;
+		if (bits & U_SKIN)
+			fieldbits += 8;
+		if (bits & U_EFFECTS)
+			fieldbits += 8;
+		for (i=0 ; i<3 ; i++)
+			if (bits & (U_ORIGIN1<<i))
+				fieldbits += MSG_DeltaCoordBits (ent->v.origin[i], ent->baseline.origin[i]);
+		if (bits & U_ANGLE1)
+			fieldbits += 8;
+		if (bits & U_ANGLE2)
+			fieldbits += 8;
+		if (bits & U_ANGLE3)
+			fieldbits += 8;
+		return size + (fieldbits + 7) / 8;
+	}
+
+	if (bits & U_MODEL)
+		size++;
+	if (bits & U_FRAME)
+		size++;
+	if (bits & U_COLORMAP)
+		size++;
+	if (bits & U_SKIN)
+		size++;
+	if (bits & U_EFFECTS)
+		size++;
+	if (bits & U_ORIGIN1)
+		size += 2;
+	if (bits & U_ORIGIN2)
+		size += 2;
+	if (bits & U_ORIGIN3)
+		size += 2;
+	if (bits & U_ANGLE1)
+		size++;
+	if (bits & U_ANGLE2)
+		size++;
+	if (bits & U_ANGLE3)
+		size++;
+
+	return size;
+}
+
+/*
+=============
+SV_WriteEntityUpdate
+
+=============
+*/
+void SV_WriteEntityUpdate (sizebuf_t *msg, edict_t *ent, int e, int bits)
+{
+	bitwriter_t	bw;
+
+	MSG_WriteByte (msg,bits | U_SIGNAL);
+
+	if (bits & U_MOREBITS)
+		MSG_WriteByte (msg, bits>>8);
+	if (bits & U_LONGENTITY)
+		MSG_WriteShort (msg,e);
+	else
+		MSG_WriteByte (msg,e);
+
+	if (sv.protocol == PROTOCOL_BITPACKED)
+	{
+	// same fields in the same order, packed without byte alignment
+		MSG_BeginWritingBits (&bw, msg);
+		if (bits & U_MODEL)
+			MSG_WriteBits (&bw, ent->v.modelindex, 8);
+		if (bits & U_FRAME)
+			MSG_WriteBits (&bw, ent->v.frame, 8);
+		if (bits & U_COLORMAP)
+			MSG_WriteBits (&bw, ent->v.colormap, 8);
+		if (bits & U_SKIN)
+			MSG_WriteBits (&bw, ent->v.skin, 8);
+		if (bits & U_EFFECTS)
+			MSG_WriteBits (&bw, ent->v.effects, 8);
+		if (bits & U_ORIGIN1)
+			MSG_WriteDeltaCoord (&bw, ent->v.origin[0], ent->baseline.origin[0]);
+		if (bits & U_ANGLE1)
+			MSG_WriteBits (&bw, (int)ent->v.angles[0]*256/360, 8);
+		if (bits & U_ORIGIN2)
+			MSG_WriteDeltaCoord (&bw, ent->v.origin[1], ent->baseline.origin[1]);
+		if (bits & U_ANGLE2)
+			MSG_WriteBits (&bw, (int)ent->v.angles[1]*256/360, 8);
+		if (bits & U_ORIGIN3)
+			MSG_WriteDeltaCoord (&bw, ent->v.origin[2], ent->baseline.origin[2]);
+		if (bits & U_ANGLE3)
+			MSG_WriteBits (&bw, (int)ent->v.angles[2]*256/360, 8);
+		MSG_EndWritingBits (&bw);
+		return;
+	}
+
+	if (bits & U_MODEL)
+		MSG_WriteByte (msg,	ent->v.modelindex);
+	if (bits & U_FRAME)
+		MSG_WriteByte (msg, ent->v.frame);
+	if (bits & U_COLORMAP)
+		MSG_WriteByte (msg, ent->v.colormap);
+	if (bits & U_SKIN)
+		MSG_WriteByte (msg, ent->v.skin);
+	if (bits & U_EFFECTS)
+		MSG_WriteByte (msg, ent->v.effects);
+	if (bits & U_ORIGIN1)
+		MSG_WriteCoord (msg, ent->v.origin[0]);
+	if (bits & U_ANGLE1)
+		MSG_WriteAngle(msg, ent->v.angles[0]);
+	if (bits & U_ORIGIN2)
+		MSG_WriteCoord (msg, ent->v.origin[1]);
+	if (bits & U_ANGLE2)
+		MSG_WriteAngle(msg, ent->v.angles[1]);
+	if (bits & U_ORIGIN3)
+		MSG_WriteCoord (msg, ent->v.origin[2]);
+	if (bits & U_ANGLE3)
+		MSG_WriteAngle(msg, ent->v.angles[2]);
+}
+
 /*
 =============
 SV_WriteEntitiesToClient
 
+Entity updates stop at maxsize bytes of msg, except for the client's own
+entity and the ones it was sent last time, which go up to the size of msg.
+The client hides anything left out of an update, so the budget only holds
+back entities coming into view.
 =============
 */
-void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
+void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, int maxsize)
 {
 	int		e, i;
-	int		bits;
+	int		bits, size;
+	int		numsend;
 	byte	*pvs;
 	vec3_t	org;
-	float	miss;
+	float	latency;
+	edict_t	*clent;
 	edict_t	*ent;
+	entsched_t	*sched;
+	qboolean	shown;
+
+	clent = client->edict;
+	client->updates++;
+
+	if (maxsize > msg->maxsize)
+		maxsize = msg->maxsize;
 
 // find the client's PVS
 	VectorAdd (clent->v.origin, clent->v.view_ofs, org);
 	pvs = SV_FatPVS (org);
 
-// send over all entities (excpet the client) that touch the pvs
+// collect all entities (excpet the client) that touch the pvs
+	numsend = 0;
 	ent = NEXT_EDICT(sv.edicts);
 	for (e=1 ; e<sv.num_edicts ; e++, ent = NEXT_EDICT(ent))
 	{
@@ -462,90 +777,118 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg)
 				continue;		// not visible
 		}
 
-		if (msg->maxsize - msg->cursize < 16)
-		{
-			Con_Printf ("packet overflow\n");
-			return;
-		}
+		sendlist[numsend].num = e;
+		sendlist[numsend].priority = SV_EntityPriority (client, ent, e);
+		numsend++;
+	}
 
-// send an update
-		bits = 0;
+	qsort (sendlist, numsend, sizeof(entpriority_t), SV_ComparePriority);
 
-		for (i=0 ; i<3 ; i++)
-		{
-			miss = ent->v.origin[i] - ent->baseline.origin[i];
-			if ( miss < -0.1 || miss > 0.1 )
-				bits |= U_ORIGIN1<<i;
-		}
+// send updates until the budget runs out.  keep going after something
+// doesn't fit, a smaller update further down may still make it
+	for (i=0 ; i<numsend ; i++)
+	{
+		e = sendlist[i].num;
+		ent = EDICT_NUM(e);
+		sched = &client->entsched[e];
 
-		if ( ent->v.angles[0] != ent->baseline.angles[0] )
-			bits |= U_ANGLE1;
+		bits = SV_EntityUpdateBits (ent, e);
+		size = SV_EntityUpdateSize (ent, bits);
 
-		if ( ent->v.angles[1] != ent->baseline.angles[1] )
-			bits |= U_ANGLE2;
+		shown = sched->lastupdate && sched->lastupdate == client->updates - 1;
 
-		if ( ent->v.angles[2] != ent->baseline.angles[2] )
-			bits |= U_ANGLE3;
+		if (msg->cursize + size > (ent == clent || shown ? msg->maxsize : maxsize))
+		{
+			if (!sched->waiting)
+				sched->waiting = realtime;
+			sched->starved++;
+			continue;
+		}
 
-		if (ent->v.movetype == MOVETYPE_STEP)
-			bits |= U_NOLERP;	// don't mess up the step animation
+		SV_WriteEntityUpdate (msg, ent, e, bits);
 
-		if (ent->baseline.colormap != ent->v.colormap)
-			bits |= U_COLORMAP;
+		if (sched->waiting)
+		{
+			latency = realtime - sched->waiting;
+			sched->totallatency += latency;
+			if (latency > sched->maxlatency)
+				sched->maxlatency = latency;
+			sched->waiting = 0;
+		}
+		sched->lastsent = realtime;
+		sched->lastupdate = client->updates;
+		sched->updates++;
+	}
+}
 
-		if (ent->baseline.skin != ent->v.skin)
-			bits |= U_SKIN;
+/*
+=============
+SV_EntStats_f
 
-		if (ent->baseline.frame != ent->v.frame)
-			bits |= U_FRAME;
+Shows how long entities have been waiting for updates to a client
+=============
+*/
+void SV_EntStats_f (void)
+{
+	client_t	*client;
+	entsched_t	*sched;
+	edict_t		*ent;
+	int			i, e;
+	int			updates, starved;
 
-		if (ent->baseline.effects != ent->v.effects)
-			bits |= U_EFFECTS;
+	if (!sv.active)
+	{
+		Con_Printf ("Not running a server\n");
+		return;
+	}
 
-		if (ent->baseline.modelindex != ent->v.modelindex)
-			bits |= U_MODEL;
+	client = NULL;
+	if (Cmd_Argc () > 1)
+	{
+		i = Q_atoi (Cmd_Argv (1)) - 1;
+		if (i >= 0 && i < svs.maxclients && svs.clients[i].active)
+			client = &svs.clients[i];
+	}
+	else
+	{
+		for (i=0 ; i<svs.maxclients ; i++)
+			if (svs.clients[i].active)
+			{
+				client = &svs.clients[i];
+				break;
+			}
+	}
 
-		if (e >= 256)
-			bits |= U_LONGENTITY;
+	if (!client)
+	{
+		Con_Printf ("usage: sv_entstats [client #]\n");
+		return;
+	}
 
-		if (bits >= 256)
-			bits |= U_MOREBITS;
+	Con_Printf ("entity updates to %s\n", client->name);
+	Con_Printf ("num class            updates starved avg ms max ms\n");
 
-	//
-	// write the message
-	//
-		MSG_WriteByte (msg,bits | U_SIGNAL);
+	updates = starved = 0;
+	for (e=1 ; e<sv.num_edicts ; e++)
+	{
+		sched = &client->entsched[e];
+		if (!sched->updates && !sched->starved)
+			continue;
 
-		if (bits & U_MOREBITS)
-			MSG_WriteByte (msg, bits>>8);
-		if (bits & U_LONGENTITY)
-			MSG_WriteShort (msg,e);
-		else
-			MSG_WriteByte (msg,e);
+		ent = EDICT_NUM(e);
+		Con_Printf ("%3i %-16.16s %7i %7i %6.1f %6.1f\n", e,
+			ent->free ? "(free)" : pr_strings + ent->v.classname,
+			sched->updates, sched->starved,
+			sched->updates ? 1000 * sched->totallatency / sched->updates : 0,
+			1000 * sched->maxlatency);
 
-		if (bits & U_MODEL)
-			MSG_WriteByte (msg,	ent->v.modelindex);
-		if (bits & U_FRAME)
-			MSG_WriteByte (msg, ent->v.frame);
-		if (bits & U_COLORMAP)
-			MSG_WriteByte (msg, ent->v.colormap);
-		if (bits & U_SKIN)
-			MSG_WriteByte (msg, ent->v.skin);
-		if (bits & U_EFFECTS)
-			MSG_WriteByte (msg, ent->v.effects);
-		if (bits & U_ORIGIN1)
-			MSG_WriteCoord (msg, ent->v.origin[0]);
-		if (bits & U_ANGLE1)
-			MSG_WriteAngle(msg, ent->v.angles[0]);
-		if (bits & U_ORIGIN2)
-			MSG_WriteCoord (msg, ent->v.origin[1]);
-		if (bits & U_ANGLE2)
-			MSG_WriteAngle(msg, ent->v.angles[1]);
-		if (bits & U_ORIGIN3)
-			MSG_WriteCoord (msg, ent->v.origin[2]);
-		if (bits & U_ANGLE3)
-			MSG_WriteAngle(msg, ent->v.angles[2]);
+		updates += sched->updates;
+		starved += sched->starved;
 	}
+
+	Con_Printf ("%i updates, %i starved\n", updates, starved);
+	if (sv_rate.value > 0)
+		Con_Printf ("rate %i bytes/sec, %i bytes of credit\n", (int)sv_rate.value, (int)client->rate_credit);
 }
 
 /*
@@ -722,6 +1065,8 @@ qboolean SV_SendClientDatagram (client_t *client)
 	byte		buf[MAX_DATAGRAM];
 	sizebuf_t	msg;
 
+	int			maxsize;
+
 	msg.data = buf;
 	msg.maxsize = sizeof(buf);
 	msg.cursize = 0;
@@ -732,7 +1077,22 @@ qboolean SV_SendClientDatagram (client_t *client)
 // add the client specific data to the datagram
 	SV_WriteClientdataToMessage (client->edict, &msg);
 
-	SV_WriteEntitiesToClient (client->edict, &msg);
+// entity updates are held to the client's byte budget.  the credit can go
+// negative when sounds and particles push a datagram over
+	maxsize = msg.maxsize;
+	if (sv_rate.value > 0)
+	{
+		client->rate_credit += (realtime - client->last_datagram) * sv_rate.value;
+		if (client->rate_credit > MAX_DATAGRAM)
+			client->rate_credit = MAX_DATAGRAM;
+		if (client->rate_credit < maxsize)
+			maxsize = client->rate_credit;
+		if (maxsize < 0)
+			maxsize = 0;
+	}
+	client->last_datagram = realtime;
+
+	SV_WriteEntitiesToClient (client, &msg, maxsize);
 
 // copy the server datagram if there is space
 	if (msg.cursize + sv.datagram.cursize < msg.maxsize)
@@ -745,6 +1105,9 @@ qboolean SV_SendClientDatagram (client_t *client)
 		return false;
 	}
 
+	if (sv_rate.value > 0)
+		client->rate_credit -= msg.cursize;
+
 	return true;
 }
 
@@ -1041,6 +1404,8 @@ This is called at the start of each level
 */
 extern float scr_centertime_off;
 
+spawntimes_t sv_spawntimes;
+
 #ifdef QUAKE2
 void SV_SpawnServer(char* server, char* startspot) {
 #else
@@ -1053,6 +1418,9 @@ void SV_SpawnServer(char* server) {
 
 	scr_centertime_off = 0;
 
+	double start = Sys_FloatTime();
+	memset(&sv_spawntimes, 0, sizeof(sv_spawntimes));
+
 	Con_DPrintf("SpawnServer: %s\n", server);
 	svs.changelevel_issued = false;  // now safe to issue another
 
@@ -1088,6 +1456,7 @@ void SV_SpawnServer(char* server) {
 	Con_DPrintf("SpawnServer: %s\n", "cleared memory");
 
 	strcpy(sv.name, server);
+	Memory_SetMap(sv.name);
 
 #ifdef QUAKE2
 	if (startspot) {
@@ -1096,7 +1465,9 @@ void SV_SpawnServer(char* server) {
 #endif
 
 	// load progs to get entity field count
+	double mark = Sys_FloatTime();
 	PR_LoadProgs();
+	sv_spawntimes.progs = Sys_FloatTime() - mark;
 
 	Con_DPrintf("SpawnServer: %s\n", "loaded progs");
 
@@ -1132,8 +1503,16 @@ void SV_SpawnServer(char* server) {
 
 	sv.time = 1.0;
 
+	if (sv_protocol.value == PROTOCOL_BITPACKED) {
+		sv.protocol = PROTOCOL_BITPACKED;
+	} else {
+		sv.protocol = PROTOCOL_VERSION;
+	}
+
 	strcpy(sv.name, server);  // why twice? mistake?
+	net_serverstatechanged = true;
 	sprintf(sv.modelname, "maps/%s.bsp", server);
+	mark = Sys_FloatTime();
 	sv.worldmodel = Mod_ForName(sv.modelname, false);
 
 	if (!sv.worldmodel) {
@@ -1158,6 +1537,8 @@ void SV_SpawnServer(char* server) {
 		sv.models[i + 1] = Mod_ForName(localmodels[i], false);
 	}
 
+	sv_spawntimes.world = Sys_FloatTime() - mark;
+
 	Con_DPrintf("SpawnServer: %s\n", "set model precache");
 
 	// load the rest of the entities
@@ -1196,7 +1577,10 @@ void SV_SpawnServer(char* server) {
 
 	Con_DPrintf("SpawnServer: %s\n", "about to load entities from file");
 
+	mark = Sys_FloatTime();
 	ED_LoadFromFile(sv.worldmodel->entities);
+	sv_spawntimes.entities = Sys_FloatTime() - mark;
+	mark = Sys_FloatTime();
 
 	Con_DPrintf("SpawnServer: %s\n", "loaded entities from file");
 
@@ -1215,6 +1599,9 @@ void SV_SpawnServer(char* server) {
 	// create a baseline for more efficient communications
 	SV_CreateBaseline();
 
+	sv_spawntimes.settle = Sys_FloatTime() - mark;
+	sv_spawntimes.total = Sys_FloatTime() - start;
+
 	// send serverinfo to all connected clients
 	host_client = svs.clients;
 
@@ -32,6 +32,8 @@ int Sys_FileOpenWrite(char *path);
 void Sys_FileClose(int handle);
 void Sys_FileSeek(int handle, int position);
 int Sys_FileRead(int handle, void *dest, int count);
+// doesn't move the file position, so threads can share a handle
+int Sys_FileReadAt(int handle, void *dest, int count, int position);
 int Sys_FileWrite(int handle, void *data, int count);
 int	Sys_FileTime(char *path);
 void Sys_mkdir(char *path);
@@ -41,6 +43,15 @@ void Sys_mkdir(char *path);
 //
 void Sys_MakeCodeWriteable(unsigned long startaddr, unsigned long length);
 
+// address space that isn't backed by memory until it is committed,
+// NULL if the system can't do that
+void *Sys_ReserveMemory(int size);
+void Sys_CommitMemory(void *ptr, int size);
+
+// maps an open file read only, NULL if the system can't do that
+void *Sys_MapFile(int handle, int size);
+void Sys_UnmapFile(void *ptr, int size);
+
 //
 // system IO
 //
@@ -56,6 +67,12 @@ void Sys_Quit(void);
 
 double Sys_FloatTime(void);
 
+// processors available to run threads on
+int Sys_CPUCount(void);
+
+// true if the code built with AVX2 kernels can run them
+qboolean Sys_CPUHasAVX2(void);
+
 char *Sys_ConsoleInput(void);
 
 // called to yield for a little bit so as
@@ -173,6 +173,10 @@ int Sys_FileRead(int handle, void *dest, int count) {
 	return read(handle, dest, count);
 }
 
+int Sys_FileReadAt(int handle, void *dest, int count, int position) {
+	return pread(handle, dest, count, position);
+}
+
 // unused
 void Sys_DebugLog(char *file, char *fmt, ...) {
 	va_list argptr;
@@ -233,6 +237,24 @@ double Sys_FloatTime(void) {
 	return (tp.tv_sec - secbase) + tp.tv_usec / 1000000.0;
 }
 
+int Sys_CPUCount(void) {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (count < 1) {
+		return 1;
+	}
+
+	return count;
+}
+
+qboolean Sys_CPUHasAVX2(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	return false;
+#endif
+}
+
 // =======================================================================
 // Sleeps for microseconds
 // =======================================================================
@@ -281,6 +303,7 @@ int main(int argc, char** argv) {
 	extern int vcrFile;
 	extern int recording;
 	int mem_parm;
+	size_t memsize;
 
 	signal(SIGFPE, SIG_IGN);
 
@@ -299,10 +322,27 @@ int main(int argc, char** argv) {
 	mem_parm = COM_CheckParm("-mem");
 
 	if (mem_parm) {
-		parms.memsize = (int)(Q_atof(com_argv[mem_parm + 1]) * 1024 * 1024);
+		memsize = (size_t)(Q_atof(com_argv[mem_parm + 1]) * 1024) * 1024;
+		parms.memsize = memsize > MAX_MEMSIZE ? MAX_MEMSIZE : (int)memsize;
+	}
+
+	// reserve room for the hunk to grow into, only what gets used is committed
+	parms.memreserve = DEFAULT_MEMRESERVE;
+	mem_parm = COM_CheckParm("-maxmem");
+
+	if (mem_parm) {
+		memsize = (size_t)(Q_atof(com_argv[mem_parm + 1]) * 1024) * 1024;
+		parms.memreserve = memsize > MAX_MEMSIZE ? MAX_MEMSIZE : (int)memsize;
+	}
+
+	if (parms.memreserve > parms.memsize) {
+		parms.membase = Sys_ReserveMemory(parms.memreserve);
 	}
 
-	parms.membase = malloc(parms.memsize);
+	if (!parms.membase) {
+		parms.memreserve = 0;
+		parms.membase = malloc(parms.memsize);
+	}
 	parms.basedir = basedir;  // unused, see COM_InitFilesystem()
 
 	fcntl(0, F_SETFL, fcntl(0, F_GETFL, 0) | FNDELAY);
@@ -368,3 +408,59 @@ void Sys_MakeCodeWriteable(unsigned long startaddr, unsigned long length) {
 		Sys_Error("Protection change failed\n");
 	}
 }
+
+/*
+================
+Sys_ReserveMemory
+================
+*/
+void *Sys_ReserveMemory(int size) {
+	void *ptr;
+
+	ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (ptr == MAP_FAILED) {
+		return NULL;
+	}
+
+	return ptr;
+}
+
+/*
+================
+Sys_MapFile
+================
+*/
+void *Sys_MapFile(int handle, int size) {
+	void *ptr;
+
+	ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, handle, 0);
+
+	if (ptr == MAP_FAILED) {
+		return NULL;
+	}
+
+	return ptr;
+}
+
+/*
+================
+Sys_UnmapFile
+================
+*/
+void Sys_UnmapFile(void *ptr, int size) {
+	munmap(ptr, size);
+}
+
+/*
+================
+Sys_CommitMemory
+
+The range must be page aligned
+================
+*/
+void Sys_CommitMemory(void *ptr, int size) {
+	if (mprotect(ptr, size, PROT_READ | PROT_WRITE) < 0) {
+		Sys_Error("Sys_CommitMemory: failed on %i bytes\n", size);
+	}
+}
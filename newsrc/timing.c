@@ -0,0 +1,301 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// timing.c -- per frame timing recorder
+
+#include "quakedef.h"
+
+#define TIMING_FRAMES 4096
+
+typedef struct {
+	int frame;  // host_framecount
+	double start;
+	float offset[NUM_TIMESTAGES];  // from the frame start, < 0 if it didn't run
+	float time[NUM_TIMESTAGES];
+} timingframe_t;
+
+static char *timing_names[NUM_TIMESTAGES] = {
+	"frame",
+	"server",
+	"client",
+	"screen",
+	"setupframe",
+	"markleaves",
+	"edges",
+	"entities",
+	"viewmodel",
+	"particles",
+	"warp",
+	"vidupdate",
+	"sound",
+};
+
+static qboolean timing_recording;
+static char timing_file[MAX_OSPATH];
+
+static timingframe_t timing_frames[TIMING_FRAMES];
+static int timing_numframes;  // ever recorded, the last TIMING_FRAMES are kept
+
+static timingframe_t timing_current;
+static double timing_begin[NUM_TIMESTAGES];
+static qboolean timing_inframe;
+
+/*
+============
+Timing_Begin
+============
+*/
+void Timing_Begin(timestage_t stage) {
+	if (!timing_inframe) {
+		return;
+	}
+
+	timing_begin[stage] = Sys_FloatTime();
+
+	if (timing_current.offset[stage] < 0) {
+		timing_current.offset[stage] = timing_begin[stage] - timing_current.start;
+	}
+}
+
+/*
+============
+Timing_End
+============
+*/
+void Timing_End(timestage_t stage) {
+	if (!timing_inframe) {
+		return;
+	}
+
+	timing_current.time[stage] += Sys_FloatTime() - timing_begin[stage];
+}
+
+/*
+============
+Timing_StartFrame
+============
+*/
+void Timing_StartFrame(void) {
+	if (!timing_recording) {
+		return;
+	}
+
+	for (int i = 0; i < NUM_TIMESTAGES; i++) {
+		timing_current.offset[i] = -1;
+		timing_current.time[i] = 0;
+	}
+
+	timing_current.frame = host_framecount;
+	timing_current.start = Sys_FloatTime();
+	timing_inframe = true;
+
+	Timing_Begin(TIME_FRAME);
+}
+
+/*
+============
+Timing_EndFrame
+============
+*/
+void Timing_EndFrame(void) {
+	if (!timing_inframe) {
+		return;
+	}
+
+	Timing_End(TIME_FRAME);
+	timing_inframe = false;
+
+	timing_frames[timing_numframes % TIMING_FRAMES] = timing_current;
+	timing_numframes++;
+}
+
+/*
+============
+Timing_WriteCSV
+
+One row a frame, milliseconds for every stage
+============
+*/
+static void Timing_WriteCSV(FILE *f, int first) {
+	timingframe_t *frame;
+	double start;
+
+	fprintf(f, "frame,time");
+	for (int i = 0; i < NUM_TIMESTAGES; i++) {
+		fprintf(f, ",%s_ms", timing_names[i]);
+	}
+	fprintf(f, "\n");
+
+	start = timing_frames[first % TIMING_FRAMES].start;
+
+	for (int i = first; i < timing_numframes; i++) {
+		frame = &timing_frames[i % TIMING_FRAMES];
+
+		fprintf(f, "%i,%.6f", frame->frame, frame->start - start);
+		for (int j = 0; j < NUM_TIMESTAGES; j++) {
+			fprintf(f, ",%.4f", frame->time[j] * 1000);
+		}
+		fprintf(f, "\n");
+	}
+}
+
+/*
+============
+Timing_WriteTrace
+
+Chrome trace event format, a complete event for every stage that ran.  A
+stage that ran more than once in a frame shows as one event at its first
+start, as long as all of its runs together.
+============
+*/
+static void Timing_WriteTrace(FILE *f, int first) {
+	timingframe_t *frame;
+	double start;
+	double ts;
+	int count;
+
+	fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+	start = timing_frames[first % TIMING_FRAMES].start;
+	count = 0;
+
+	for (int i = first; i < timing_numframes; i++) {
+		frame = &timing_frames[i % TIMING_FRAMES];
+
+		for (int j = 0; j < NUM_TIMESTAGES; j++) {
+			if (frame->offset[j] < 0) {
+				continue;
+			}
+
+			ts = (frame->start - start + frame->offset[j]) * 1e6;
+
+			fprintf(
+					f,
+					"%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, "
+					"\"ts\": %.1f, \"dur\": %.1f, \"args\": {\"frame\": %i}}",
+					count++ ? "," : "",
+					timing_names[j],
+					ts,
+					frame->time[j] * 1e6,
+					frame->frame);
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+}
+
+/*
+============
+Timing_Start
+============
+*/
+void Timing_Start(char *name) {
+	if (timing_recording) {
+		Timing_Stop();
+	}
+
+	// leave room for the extension
+	if (snprintf(timing_file, sizeof(timing_file) - 5, "%s/%s", com_gamedir, name) >= sizeof(timing_file) - 5) {
+		Con_Printf("File name is too long\n");
+		return;
+	}
+
+	COM_DefaultExtension(timing_file, ".json");
+
+	timing_numframes = 0;
+	timing_inframe = false;
+	timing_recording = true;
+
+	Con_Printf("recording frame times for %s\n", timing_file);
+}
+
+/*
+============
+Timing_Stop
+
+Writes out what has been recorded
+============
+*/
+void Timing_Stop(void) {
+	FILE *f;
+	int first;
+	int len;
+
+	if (!timing_recording) {
+		return;
+	}
+
+	timing_recording = false;
+	timing_inframe = false;
+
+	if (!timing_numframes) {
+		Con_Printf("no frames recorded\n");
+		return;
+	}
+
+	f = fopen(timing_file, "w");
+
+	if (!f) {
+		Con_Printf("Couldn't write %s.\n", timing_file);
+		return;
+	}
+
+	first = timing_numframes > TIMING_FRAMES ? timing_numframes - TIMING_FRAMES : 0;
+	len = strlen(timing_file);
+
+	if (len > 4 && !Q_strcasecmp(timing_file + len - 4, ".csv")) {
+		Timing_WriteCSV(f, first);
+	} else {
+		Timing_WriteTrace(f, first);
+	}
+
+	fclose(f);
+
+	Con_Printf("Wrote %i frames to %s.\n", timing_numframes - first, timing_file);
+}
+
+/*
+============
+Timing_Record_f
+
+timerecord <file>
+Starts recording frame times, "timerecord" again stops and writes the file
+============
+*/
+static void Timing_Record_f(void) {
+	if (Cmd_Argc() < 2) {
+		if (timing_recording) {
+			Timing_Stop();
+		} else {
+			Con_Printf("timerecord <file[.csv|.json]> : record frame stage times\n");
+		}
+		return;
+	}
+
+	Timing_Start(Cmd_Argv(1));
+}
+
+/*
+============
+Timing_Init
+============
+*/
+void Timing_Init(void) {
+	Cmd_AddCommand("timerecord", Timing_Record_f);
+}
@@ -0,0 +1,59 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// timing.h -- per frame timing recorder
+
+/*
+Timing_Begin and Timing_End bracket the stages of a frame.  While a
+recording is running ("timerecord <file>", or "timedemo <demo> <file>")
+every frame's stage times go into a ring, and stopping the recording
+writes the ring out as CSV or as a Chrome trace (chrome://tracing,
+Perfetto).  When nothing is recording the calls return at once.
+*/
+
+typedef enum {
+	TIME_FRAME,
+	TIME_SERVER,  // Host_ServerFrame
+	TIME_CLIENT,  // CL_ReadFromServer
+	TIME_SCREEN,  // SCR_UpdateScreen, holds the render stages and vidupdate
+	TIME_SETUPFRAME,
+	TIME_MARKLEAVES,
+	TIME_EDGES,
+	TIME_ENTITIES,
+	TIME_VIEWMODEL,
+	TIME_PARTICLES,
+	TIME_WARP,
+	TIME_VIDUPDATE,
+	TIME_SOUND,
+	NUM_TIMESTAGES
+} timestage_t;
+
+void Timing_Init(void);
+
+// a stage that runs more than once in a frame adds up
+void Timing_Begin(timestage_t stage);
+void Timing_End(timestage_t stage);
+
+// around everything _Host_Frame does
+void Timing_StartFrame(void);
+void Timing_EndFrame(void);
+
+// name is in the game directory, ".csv" writes CSV, anything else JSON
+void Timing_Start(char *name);
+void Timing_Stop(void);
@@ -0,0 +1,359 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// qpak.c -- packs a directory into a pak file
+
+/*
+qpak [-order <accesslog>] <dir> <pakfile>
+
+Files named in the access log (see the engine's "accesslog" command) go
+first, in the order the engine asked for them, so loading a map reads
+the pak front to back.  The rest follow sorted by name.
+
+Files with identical contents are stored once, every directory entry
+for them points at the same data.
+
+The data is streamed out one file at a time, then the directory, then
+the header is filled in.  <pakfile>.manifest is written alongside with
+the directory crc and a crc for every file; the engine checks it when
+the pak is added.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+typedef unsigned char byte;
+
+#include "../crc.h"
+
+#define MAX_FILES_IN_PACK 2048
+#define MAX_PACKNAME 56
+#define MANIFEST_VERSION 1  // QPAK_MANIFEST_VERSION in common.c
+
+// on disk, always little endian
+typedef struct {
+	char name[MAX_PACKNAME];
+	byte filepos[4];
+	byte filelen[4];
+} dpackfile_t;
+
+typedef struct {
+	char id[4];
+	byte dirofs[4];
+	byte dirlen[4];
+} dpackheader_t;
+
+typedef struct {
+	char name[MAX_PACKNAME];
+	int order;  // position in the access log, or past the end of it
+	int filepos;
+	int filelen;
+	unsigned short crc;
+} packentry_t;
+
+packentry_t entries[MAX_FILES_IN_PACK];
+int numentries;
+
+char* order[MAX_FILES_IN_PACK * 2];
+int numorder;
+
+void Error(char* fmt, char* arg) {
+	fprintf(stderr, "qpak: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+void PutLong(byte* out, int l) {
+	out[0] = l & 255;
+	out[1] = (l >> 8) & 255;
+	out[2] = (l >> 16) & 255;
+	out[3] = (l >> 24) & 255;
+}
+
+/*
+============
+LoadOrder
+============
+*/
+void LoadOrder(char* filename) {
+	char line[1024];
+	FILE* f = fopen(filename, "r");
+
+	if (!f) {
+		Error("couldn't open %s", filename);
+	}
+
+	while (numorder < MAX_FILES_IN_PACK * 2 && fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\r\n")] = 0;
+
+		if (line[0]) {
+			order[numorder++] = strdup(line);
+		}
+	}
+
+	fclose(f);
+}
+
+int OrderOf(char* name) {
+	for (int i = 0; i < numorder; i++) {
+		if (!strcmp(order[i], name)) {
+			return i;
+		}
+	}
+
+	return numorder;
+}
+
+/*
+============
+AddDirectory
+
+path is the directory on disk, name the same directory inside the pak
+============
+*/
+void AddDirectory(char* path, char* name) {
+	DIR* dir = opendir(path);
+
+	if (!dir) {
+		Error("couldn't open directory %s", path);
+	}
+
+	struct dirent* ent;
+
+	while ((ent = readdir(dir))) {
+		char filepath[4096];
+		char filename[4096];
+		struct stat st;
+
+		if (ent->d_name[0] == '.') {
+			continue;
+		}
+
+		snprintf(filepath, sizeof(filepath), "%s/%s", path, ent->d_name);
+		snprintf(filename, sizeof(filename), "%s%s%s", name, name[0] ? "/" : "", ent->d_name);
+
+		if (stat(filepath, &st)) {
+			continue;
+		}
+
+		if (S_ISDIR(st.st_mode)) {
+			AddDirectory(filepath, filename);
+			continue;
+		}
+
+		if (strlen(filename) >= MAX_PACKNAME) {
+			Error("%s: name is too long for a pak", filename);
+		}
+
+		if (numentries == MAX_FILES_IN_PACK) {
+			Error("more than %s files", "2048");
+		}
+
+		packentry_t* e = &entries[numentries++];
+		strcpy(e->name, filename);
+		e->order = OrderOf(filename);
+	}
+
+	closedir(dir);
+}
+
+int EntryCompare(const void* a, const void* b) {
+	const packentry_t* ea = a;
+	const packentry_t* eb = b;
+
+	if (ea->order != eb->order) {
+		return ea->order - eb->order;
+	}
+
+	return strcmp(ea->name, eb->name);
+}
+
+byte* LoadFile(char* path, int* length) {
+	FILE* f = fopen(path, "rb");
+
+	if (!f) {
+		Error("couldn't open %s", path);
+	}
+
+	fseek(f, 0, SEEK_END);
+	*length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	byte* data = malloc(*length + 1);
+
+	if (!data || fread(data, 1, *length, f) != *length) {
+		Error("couldn't read %s", path);
+	}
+
+	fclose(f);
+	return data;
+}
+
+/*
+============
+FindDuplicate
+
+An earlier entry with the same contents, read back from the pak
+============
+*/
+packentry_t* FindDuplicate(FILE* pak, packentry_t* e, byte* data) {
+	for (packentry_t* other = entries; other < e; other++) {
+		if (other->crc != e->crc || other->filelen != e->filelen) {
+			continue;
+		}
+
+		byte* stored = malloc(e->filelen + 1);
+		long end = ftell(pak);
+
+		fseek(pak, other->filepos, SEEK_SET);
+		int same = fread(stored, 1, e->filelen, pak) == e->filelen &&
+				!memcmp(stored, data, e->filelen);
+		fseek(pak, end, SEEK_SET);
+		free(stored);
+
+		if (same) {
+			return other;
+		}
+	}
+
+	return NULL;
+}
+
+int main(int argc, char** argv) {
+	int arg = 1;
+
+	if (arg + 1 < argc && !strcmp(argv[arg], "-order")) {
+		LoadOrder(argv[arg + 1]);
+		arg += 2;
+	}
+
+	if (argc - arg != 2) {
+		fprintf(stderr, "usage: qpak [-order <accesslog>] <dir> <pakfile>\n");
+		return 1;
+	}
+
+	char* dirname = argv[arg];
+	char* pakname = argv[arg + 1];
+
+	AddDirectory(dirname, "");
+	qsort(entries, numentries, sizeof(entries[0]), EntryCompare);
+
+	FILE* pak = fopen(pakname, "w+b");
+
+	if (!pak) {
+		Error("couldn't create %s", pakname);
+	}
+
+	// the header is written last, when the directory is known
+	dpackheader_t header;
+	memset(&header, 0, sizeof(header));
+	fwrite(&header, sizeof(header), 1, pak);
+
+	int ordered = 0;
+	int duplicates = 0;
+	int saved = 0;
+
+	for (int i = 0; i < numentries; i++) {
+		packentry_t* e = &entries[i];
+		char path[4096];
+
+		snprintf(path, sizeof(path), "%s/%s", dirname, e->name);
+
+		byte* data = LoadFile(path, &e->filelen);
+		e->crc = CRC_Block(data, e->filelen);
+
+		packentry_t* dup = FindDuplicate(pak, e, data);
+
+		if (dup) {
+			e->filepos = dup->filepos;
+			duplicates++;
+			saved += e->filelen;
+		} else {
+			e->filepos = ftell(pak);
+			fwrite(data, 1, e->filelen, pak);
+		}
+
+		if (e->order < numorder) {
+			ordered++;
+		}
+
+		free(data);
+	}
+
+	// the directory
+	static dpackfile_t dir[MAX_FILES_IN_PACK];
+	memset(dir, 0, sizeof(dir));
+
+	for (int i = 0; i < numentries; i++) {
+		strcpy(dir[i].name, entries[i].name);
+		PutLong(dir[i].filepos, entries[i].filepos);
+		PutLong(dir[i].filelen, entries[i].filelen);
+	}
+
+	int dirofs = ftell(pak);
+	int dirlen = numentries * sizeof(dpackfile_t);
+	fwrite(dir, 1, dirlen, pak);
+
+	int paksize = ftell(pak);
+
+	memcpy(header.id, "PACK", 4);
+	PutLong(header.dirofs, dirofs);
+	PutLong(header.dirlen, dirlen);
+	fseek(pak, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, pak);
+
+	if (ferror(pak) || fclose(pak)) {
+		Error("error writing %s", pakname);
+	}
+
+	// the manifest
+	char manifestname[4096];
+	snprintf(manifestname, sizeof(manifestname), "%s.manifest", pakname);
+
+	FILE* manifest = fopen(manifestname, "w");
+
+	if (!manifest) {
+		Error("couldn't create %s", manifestname);
+	}
+
+	fprintf(manifest, "QPAK %i\n", MANIFEST_VERSION);
+	fprintf(manifest, "%i %i %i\n", numentries, CRC_Block((byte*)dir, dirlen), paksize);
+
+	for (int i = 0; i < numentries; i++) {
+		fprintf(
+				manifest,
+				"%i %i %i %s\n",
+				entries[i].crc,
+				entries[i].filepos,
+				entries[i].filelen,
+				entries[i].name);
+	}
+
+	fclose(manifest);
+
+	printf("%s: %i files, %i in access order\n", pakname, numentries, ordered);
+	printf("%i duplicates stored once, %i bytes saved\n", duplicates, saved);
+	printf("%i bytes\n", paksize);
+
+	return 0;
+}
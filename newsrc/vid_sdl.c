@@ -32,12 +32,24 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include <SDL2/SDL.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define VID_AVX2
+#include <immintrin.h>
+#endif
+
 #include "quakedef.h"
+#include "r_local.h"
 #include "d_local.h"
 
 
 cvar_t m_filter = {"m_filter", "0", true};  // mouse smoothing?
 
+// the size the game is drawn at, and how many times bigger the window is;
+// SDL stretches the picture to the window on present
+cvar_t vid_width = {"vid_width", "960", true};
+cvar_t vid_height = {"vid_height", "720", true};
+cvar_t vid_scale = {"vid_scale", "1", true};
+
 qboolean mouse_avail;  // checks if mouse has been inited
 
 int mouse_buttons = 3;  // assume 3 mouse buttons
@@ -70,6 +82,8 @@ SDL_Event event;
 
 static qboolean oktodraw = false;
 
+static int vid_curscale = 1;
+
 static long SDL_highhunkmark;
 static long SDL_buffersize;
 
@@ -81,12 +95,11 @@ void (*vid_menukeyfn)(int key);
 
 typedef uint32_t PIXEL24;
 
-#define RES_X 960 // 640
-#define RES_Y 720 // 480
-#define PIXEL_BUFFER_SIZE RES_X * RES_Y * sizeof(PIXEL24)
+// the renderer draws 8 bit pixels into pixel_buffer, VID_Update converts
+// them straight into the locked streaming texture
 
 typedef struct {
-	unsigned char data[PIXEL_BUFFER_SIZE];
+	unsigned char *data;  // on the high hunk with the z buffer
 	int bytes_per_line;
 } pixeldata;
 
@@ -158,39 +171,83 @@ PIXEL24 xlib_rgb24(int r, int g, int b) {
 	return p;
 }
 
-void st3_fixup(int x, int y, int width, int height) {
-	int yi;
-	unsigned char *src;
-	PIXEL24 *dest;
-	register int count;
-	register int n;
+/*
+================
+VID_Convert
 
-	if ((x < 0) || (y < 0)) {
-		return;
+Palette lookup for a block of rows.  This is the generic version, the
+compiler does a better job with a plain unrolled loop than with Duff's
+device.
+================
+*/
+static void VID_Convert(
+		byte *src,
+		int srcrowbytes,
+		byte *dest,
+		int destpitch,
+		int width,
+		int height) {
+	for (int y = 0; y < height; y++) {
+		byte *s = src + y * srcrowbytes;
+		PIXEL24 *d = (PIXEL24 *)(dest + y * destpitch);
+		int x = 0;
+
+		for (; x + 4 <= width; x += 4) {
+			d[x] = st2d_8to24table[s[x]];
+			d[x + 1] = st2d_8to24table[s[x + 1]];
+			d[x + 2] = st2d_8to24table[s[x + 2]];
+			d[x + 3] = st2d_8to24table[s[x + 3]];
+		}
+
+		for (; x < width; x++) {
+			d[x] = st2d_8to24table[s[x]];
+		}
 	}
+}
+
+#ifdef VID_AVX2
+/*
+================
+VID_ConvertAVX2
+
+16 pixels at a time: widen the indexes to 32 bits and gather from the
+palette.  Only called when the cpu reports avx2 and r_simd is set.
+================
+*/
+__attribute__((target("avx2")))
+static void VID_ConvertAVX2(
+		byte *src,
+		int srcrowbytes,
+		byte *dest,
+		int destpitch,
+		int width,
+		int height) {
+	for (int y = 0; y < height; y++) {
+		byte *s = src + y * srcrowbytes;
+		PIXEL24 *d = (PIXEL24 *)(dest + y * destpitch);
+		int x = 0;
+
+		for (; x + 16 <= width; x += 16) {
+			__m128i index = _mm_loadu_si128((__m128i *)(s + x));
+			__m256i lo = _mm256_cvtepu8_epi32(index);
+			__m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(index, 8));
+
+			_mm256_storeu_si256(
+					(__m256i *)(d + x),
+					_mm256_i32gather_epi32((int *)st2d_8to24table, lo, 4));
+			_mm256_storeu_si256(
+					(__m256i *)(d + x + 8),
+					_mm256_i32gather_epi32((int *)st2d_8to24table, hi, 4));
+		}
 
-	for (yi = y; yi < (y + height); yi++) {
-		src = &pixel_buffer.data[yi * pixel_buffer.bytes_per_line];
-
-		// Duff's Device
-		count = width;
-		n = (count + 7) / 8;
-		dest = ((PIXEL24 *)src) + x + width - 1;
-		src += x + width - 1;
-
-		switch (count % 8) {
-		case 0:	do {	*dest-- = st2d_8to24table[*src--];
-		case 7:			*dest-- = st2d_8to24table[*src--];
-		case 6:			*dest-- = st2d_8to24table[*src--];
-		case 5:			*dest-- = st2d_8to24table[*src--];
-		case 4:			*dest-- = st2d_8to24table[*src--];
-		case 3:			*dest-- = st2d_8to24table[*src--];
-		case 2:			*dest-- = st2d_8to24table[*src--];
-		case 1:			*dest-- = st2d_8to24table[*src--];
-				} while (--n > 0);
+		for (; x < width; x++) {
+			d[x] = st2d_8to24table[s[x]];
 		}
 	}
 }
+#endif
+
+static qboolean vid_haveavx2;
 
 // ========================================================================
 // SDL Video Logic
@@ -205,12 +262,14 @@ void ResetFrameBuffer(void) {
 
 	SDL_highhunkmark = Hunk_HighMark();
 
-	// alloc an extra line in case we want to wrap, and allocate the z-buffer
+	// the z-buffer, the surface cache and the 8 bit frame all come from one
+	// high hunk block, freed and reallocated on every mode change
 	SDL_buffersize = vid.width * vid.height * sizeof (*d_pzbuffer);
 
 	vid_surfcachesize = D_SurfaceCacheForRes(vid.width, vid.height);
 
 	SDL_buffersize += vid_surfcachesize;
+	SDL_buffersize += vid.width * vid.height;
 
 	d_pzbuffer = Hunk_HighAllocName(SDL_buffersize, "video");
 
@@ -222,16 +281,97 @@ void ResetFrameBuffer(void) {
 			(byte *)d_pzbuffer + vid.width * vid.height * sizeof (*d_pzbuffer);
 
 	D_InitCaches(vid_surfcache, vid_surfcachesize);
+
+	pixel_buffer.data = (byte *)vid_surfcache + vid_surfcachesize;
+	pixel_buffer.bytes_per_line = vid.width;
+
+	vid.rowbytes = pixel_buffer.bytes_per_line;
+	vid.buffer = (pixel_t *)pixel_buffer.data;
+	vid.conbuffer = vid.buffer;
+	vid.conrowbytes = vid.rowbytes;
+	vid.conwidth = vid.width;
+	vid.conheight = vid.height;
+	vid.aspect = ((float)vid.height / (float)vid.width) * (320.0 / 240.0);
+}
+
+/*
+================
+VID_ModeSize
+
+The mode the cvars ask for, clamped to what the renderer can draw
+================
+*/
+static void VID_ModeSize(int *width, int *height, int *scale) {
+	*width = (int)vid_width.value & ~7;
+	*height = (int)vid_height.value;
+	*scale = (int)vid_scale.value;
+
+	if (*width < 320) {
+		*width = 320;
+	} else if (*width > MAXWIDTH) {
+		*width = MAXWIDTH;
+	}
+
+	if (*height < 200) {
+		*height = 200;
+	} else if (*height > MAXHEIGHT) {
+		*height = MAXHEIGHT;
+	}
+
+	if (*scale < 1) {
+		*scale = 1;
+	} else if (*scale > 4) {
+		*scale = 4;
+	}
+}
+
+/*
+================
+VID_SetSize
+
+Reallocates the frame and resizes the texture and the window
+================
+*/
+static void VID_SetSize(int width, int height, int scale) {
+	vid.width = width;
+	vid.height = height;
+	vid_curscale = scale;
+
+	ResetFrameBuffer();
+
+	if (textureSDL) {
+		SDL_DestroyTexture(textureSDL);
+	}
+
+	textureSDL = SDL_CreateTexture(
+			renderer,
+			SDL_PIXELFORMAT_ARGB8888,
+			SDL_TEXTUREACCESS_STREAMING,
+			vid.width,
+			vid.height);
+
+	if (!textureSDL) {
+		Sys_Error("Couldn't create a %ix%i texture: %s", width, height, SDL_GetError());
+	}
+
+	SDL_SetWindowSize(window, vid.width * scale, vid.height * scale);
 }
 
 // Called at startup to set up translation tables, takes 256 8 bit RGB values
 // the palette data will go away after the call, so it must be copied off if
 // the video driver will need it again
 void VID_Init(unsigned char *palette) {
-	pixel_buffer.bytes_per_line = RES_X * sizeof(PIXEL24);
+	int width, height, scale;
 
-	vid.width = RES_X;
-	vid.height = RES_Y;
+	Cvar_RegisterVariable(&vid_width);
+	Cvar_RegisterVariable(&vid_height);
+	Cvar_RegisterVariable(&vid_scale);
+	VID_ModeSize(&width, &height, &scale);
+
+	vid_haveavx2 = Sys_CPUHasAVX2();
+
+	vid.width = width;
+	vid.height = height;
 	vid.maxwarpwidth = WARP_WIDTH;
 	vid.maxwarpheight = WARP_HEIGHT;
 	vid.numpages = 2;
@@ -249,16 +389,10 @@ void VID_Init(unsigned char *palette) {
 			"quake",
 			SDL_WINDOWPOS_UNDEFINED,
 			SDL_WINDOWPOS_UNDEFINED,
-			vid.width,
-			vid.height,
+			vid.width * scale,
+			vid.height * scale,
 			SDL_WINDOW_SHOWN);
 	renderer = SDL_CreateRenderer(window, -1, 0);
-	textureSDL = SDL_CreateTexture(
-			renderer,
-			SDL_PIXELFORMAT_ARGB8888,
-			SDL_TEXTUREACCESS_STREAMING,
-			vid.width,
-			vid.height);
 
 	// capture mouse
 	SDL_SetRelativeMouseMode(SDL_TRUE);
@@ -276,16 +410,8 @@ void VID_Init(unsigned char *palette) {
 		} while (!oktodraw);
 	}
 
-	ResetFrameBuffer();
-
-	vid.rowbytes = pixel_buffer.bytes_per_line;
-	vid.buffer = (pixel_t *)pixel_buffer.data;
+	VID_SetSize(width, height, scale);
 	vid.direct = 0;  // address of the framebuffer
-	vid.conbuffer = (pixel_t *)pixel_buffer.data;
-	vid.conrowbytes = vid.rowbytes;
-	vid.conwidth = vid.width;
-	vid.conheight = vid.height;
-	vid.aspect = ((float)vid.height / (float)vid.width) * (320.0 / 240.0);
 }
 
 void VID_ShiftPalette(unsigned char *p) {
@@ -305,21 +431,24 @@ void VID_SetPalette(unsigned char *palette) {
 
 // flushes the given rectangles from the view buffer to the screen
 void VID_Update(vrect_t *rects) {
+	int width, height, scale;
+
+	// vid_width, vid_height or vid_scale changed
+	VID_ModeSize(&width, &height, &scale);
+
+	if (width != vid.width || height != vid.height || scale != vid_curscale) {
+		config_notify = 1;
+		config_notify_width = width;
+		config_notify_height = height;
+	}
+
 	// if the window changes dimension, skip this frame
 	if (config_notify) {
-		fprintf(stderr, "config notify\n");
 		config_notify = 0;
-		vid.width = config_notify_width & ~7;
-		vid.height = config_notify_height;
+		VID_SetSize(config_notify_width & ~7, config_notify_height, scale);
+		Con_Printf("Video mode %ix%i, window %ix%i\n",
+				vid.width, vid.height, vid.width * scale, vid.height * scale);
 
-		ResetFrameBuffer();
-
-		vid.rowbytes = pixel_buffer.bytes_per_line;
-		vid.buffer = (pixel_t *)pixel_buffer.data;
-		vid.conbuffer = vid.buffer;
-		vid.conwidth = vid.width;
-		vid.conheight = vid.height;
-		vid.conrowbytes = vid.rowbytes;
 		vid.recalc_refdef = 1;  // force a surface cache flush
 		Con_CheckResize();
 		Con_Clear_f();
@@ -330,23 +459,94 @@ void VID_Update(vrect_t *rects) {
 	extern int scr_fullupdate;
 	scr_fullupdate = 0;
 
-	while (rects) {
-		st3_fixup(
-				rects->x,
-				rects->y,
-				rects->width,
-				rects->height);
-
-		SDL_UpdateTexture(
-				textureSDL,
-				NULL,
-				pixel_buffer.data,
-				RES_X * sizeof(PIXEL24));
-
-		SDL_RenderClear(renderer);
-		SDL_RenderCopy(renderer, textureSDL, NULL, NULL);
-		SDL_RenderPresent(renderer);
-		rects = rects->pnext;
+	if (!rects) {
+		return;
+	}
+
+	// everything dirty this frame goes up in one upload
+	int x0 = rects->x;
+	int y0 = rects->y;
+	int x1 = rects->x + rects->width;
+	int y1 = rects->y + rects->height;
+
+	for (vrect_t *r = rects->pnext; r; r = r->pnext) {
+		if (r->x < x0) {
+			x0 = r->x;
+		}
+
+		if (r->y < y0) {
+			y0 = r->y;
+		}
+
+		if (r->x + r->width > x1) {
+			x1 = r->x + r->width;
+		}
+
+		if (r->y + r->height > y1) {
+			y1 = r->y + r->height;
+		}
+	}
+
+	if (x0 < 0) {
+		x0 = 0;
+	}
+
+	if (y0 < 0) {
+		y0 = 0;
+	}
+
+	if (x1 > vid.width) {
+		x1 = vid.width;
+	}
+
+	if (y1 > vid.height) {
+		y1 = vid.height;
+	}
+
+	if (x1 <= x0 || y1 <= y0) {
+		return;
+	}
+
+	// the locked pixels are write only, so every one of them gets converted
+	SDL_Rect area = {x0, y0, x1 - x0, y1 - y0};
+	void *pixels;
+	int pitch;
+
+	if (SDL_LockTexture(textureSDL, &area, &pixels, &pitch)) {
+		return;
+	}
+
+	void (*convert)(byte *, int, byte *, int, int, int) = VID_Convert;
+
+#ifdef VID_AVX2
+	if (vid_haveavx2 && r_simd.value) {
+		convert = VID_ConvertAVX2;
+	}
+#endif
+
+	convert(
+			pixel_buffer.data + y0 * pixel_buffer.bytes_per_line + x0,
+			pixel_buffer.bytes_per_line,
+			pixels,
+			pitch,
+			area.w,
+			area.h);
+
+	SDL_UnlockTexture(textureSDL);
+
+	SDL_RenderCopy(renderer, textureSDL, NULL, NULL);
+	SDL_RenderPresent(renderer);
+
+	// the renderer asked for a bigger surface cache, the frame is out
+	// so the buffers can be reallocated now
+	if (d_surfcachewanted > vid_surfcachesize) {
+		ResetFrameBuffer();
+		d_surfcachewanted = 0;  // taken, don't grow again until asked
+
+		// the z-buffer moved, so the span tables have to be rebuilt
+		// before the next frame
+		vid.recalc_refdef = 1;
+		Con_DPrintf("Surface cache now %ik\n", vid_surfcachesize / 1024);
 	}
 }
 
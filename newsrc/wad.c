@@ -66,7 +66,18 @@ W_LoadWadFile
 ====================
 */
 void W_LoadWadFile(char* filename) {
-	wad_base = COM_LoadHunkFile(filename);
+	// lumps are used in place, straight out of the pak if it is mapped,
+	// unless the pics need byte swapping
+	qboolean mapped = false;
+
+	if (!bigendian) {
+		wad_base = COM_MapFile(filename);
+		mapped = wad_base != NULL;
+	}
+
+	if (!mapped) {
+		wad_base = COM_LoadHunkFile(filename);
+	}
 
 	if (!wad_base) {
 		Sys_Error ("W_LoadWadFile: couldn't load %s", filename);
@@ -85,6 +96,13 @@ void W_LoadWadFile(char* filename) {
 	int infotableofs = LittleLong(header->infotableofs);
 	wad_lumps = (lumpinfo_t *)(wad_base + infotableofs);
 
+	if (mapped) {
+		// the directory gets cleaned up, so it needs to be writable
+		lumpinfo_t* lumps = Hunk_AllocName(wad_numlumps * sizeof(lumpinfo_t), "wadinfo");
+		memcpy(lumps, wad_lumps, wad_numlumps * sizeof(lumpinfo_t));
+		wad_lumps = lumps;
+	}
+
 	lumpinfo_t* lump_p = wad_lumps;
 
 	for (unsigned i = 0; i < wad_numlumps; i++, lump_p++) {
@@ -92,7 +110,7 @@ void W_LoadWadFile(char* filename) {
 		lump_p->size = LittleLong(lump_p->size);
 		W_CleanupName (lump_p->name, lump_p->name);
 
-		if (lump_p->type == TYP_QPIC) {
+		if (lump_p->type == TYP_QPIC && !mapped) {
 			SwapPicByteEndianness((qpic_t*)(wad_base + lump_p->filepos));
 		}
 	}
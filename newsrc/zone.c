@@ -26,7 +26,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define DYNAMIC_SIZE 0xc000
 
 void Cache_FreeLow(int new_low_hunk);
-void Cache_FreeHigh(int new_high_hunk);
+void Cache_FreeHigh(void);
 
 
 /*
@@ -34,10 +34,19 @@ void Cache_FreeHigh(int new_high_hunk);
 
 						ZONE MEMORY ALLOCATION
 
-There is never any space between memblocks, and there will never be two
-contiguous free memblocks.
+The zone is made of one or more regions.  The first one is allocated at the
+very bottom of the hunk, and more are malloced as needed when none of the
+existing ones has room, so the zone never runs out.
 
-The rover can be left pointing at a non-empty block
+Inside a region there is never any space between memblocks, and there will
+never be two contiguous free memblocks.
+
+Free blocks are kept on segregated free lists, binned by size.  Blocks
+under ZONE_SMALLMAX bytes get a bin for every 16 bytes of size, so any block
+in the first non empty bin at or above the one for a request is big enough
+and small allocations never search.  Bigger blocks are binned by powers of
+two.  A bitmask of the non empty bins makes finding one a couple of word
+tests.
 
 The zone calls are pretty much only used for small strings and structures,
 all big things are allocated on the hunk.
@@ -47,6 +56,12 @@ all big things are allocated on the hunk.
 #define ZONEID 0x1d4a11
 #define MINFRAGMENT	64
 
+#define ZONE_SMALLMAX	1024
+#define ZONE_SMALLBINS	(ZONE_SMALLMAX / 16)
+#define ZONE_LARGEBINS	22		// powers of two from ZONE_SMALLMAX up
+#define ZONE_BINS		(ZONE_SMALLBINS + ZONE_LARGEBINS)
+#define ZONE_BINWORDS	((ZONE_BINS + 31) / 32)
+
 typedef struct memblock_s {
 	int size;  // including the header and possibly tiny fragments
 	int tag;  // a tag of 0 is a free block
@@ -56,21 +71,130 @@ typedef struct memblock_s {
 	int pad;  // pad to 64 bit boundary
 } memblock_t;
 
-// only used for the main zone
+// free blocks keep their free list links where the data would go,
+// MINFRAGMENT guarantees there is room for them
 typedef struct {
+	memblock_t *next;
+	memblock_t *prev;
+} freelink_t;
+
+#define FREELINK(b)	((freelink_t *)((byte *)(b) + sizeof(memblock_t)))
+
+// one for each region of the zone
+typedef struct memzone_s {
 	int size;  // total bytes malloced, including header
 	memblock_t blocklist;  // start / end cap for linked list
-	memblock_t *rover;
+	struct memzone_s *next;  // next region
 } memzone_t;
 
 memzone_t *mainzone;
 
+memblock_t *zone_bins[ZONE_BINS];
+unsigned zone_binmask[ZONE_BINWORDS];
+
+struct {
+	int regions;
+	int size;  // all regions, including headers
+	int used;  // bytes in allocated blocks, including headers
+	int peak;
+	int blocks;
+	int allocs;
+	int frees;
+} zone_stats;
+
+/*
+========================
+Z_BinForSize
+
+The bin a free block of the given size goes in
+========================
+*/
+int Z_BinForSize(int size) {
+	int bin;
+
+	if (size < ZONE_SMALLMAX) {
+		return size >> 4;
+	}
+
+	bin = ZONE_SMALLBINS;
+	for (size /= ZONE_SMALLMAX; size > 1 && bin < ZONE_BINS - 1; size >>= 1) {
+		bin++;
+	}
+
+	return bin;
+}
+
+/*
+========================
+Z_FindBin
+
+Returns the first non empty bin at or above bin, or -1
+========================
+*/
+int Z_FindBin(int bin) {
+	int word;
+	unsigned bits;
+
+	word = bin >> 5;
+	bits = zone_binmask[word] & (~0u << (bin & 31));
+
+	while (!bits) {
+		if (++word == ZONE_BINWORDS) {
+			return -1;
+		}
+		bits = zone_binmask[word];
+	}
+
+	for (bin = word << 5; !(bits & 1); bits >>= 1) {
+		bin++;
+	}
+
+	return bin;
+}
+
+void Z_LinkFree(memblock_t *block) {
+	int bin;
+
+	bin = Z_BinForSize(block->size);
+
+	FREELINK(block)->prev = NULL;
+	FREELINK(block)->next = zone_bins[bin];
+	if (zone_bins[bin]) {
+		FREELINK(zone_bins[bin])->prev = block;
+	}
+	zone_bins[bin] = block;
+
+	zone_binmask[bin >> 5] |= 1u << (bin & 31);
+}
+
+void Z_UnlinkFree(memblock_t *block) {
+	int bin;
+	freelink_t *link;
+
+	link = FREELINK(block);
+
+	if (link->prev) {
+		FREELINK(link->prev)->next = link->next;
+	} else {
+		bin = Z_BinForSize(block->size);
+		zone_bins[bin] = link->next;
+		if (!link->next) {
+			zone_binmask[bin >> 5] &= ~(1u << (bin & 31));
+		}
+	}
+
+	if (link->next) {
+		FREELINK(link->next)->prev = link->prev;
+	}
+}
+
 /*
 ========================
 Z_ClearZone
 
 Creates a memblock and sets up a doubly linked list, where the block points to
-the memzone's blocklist, which points to the block
+the memzone's blocklist, which points to the block.  The new region is added
+to the zone, and its space to the free lists.
 ========================
 */
 void Z_ClearZone(memzone_t *zone, int size) {
@@ -79,19 +203,54 @@ void Z_ClearZone(memzone_t *zone, int size) {
 	// sets the position of the block pointer to just after the memzone object
 	block = (memblock_t *)((byte *)zone + sizeof(memzone_t));
 
-	// set the entire zone to one free block
+	// set the entire region to one free block
+	zone->size = size;
 	zone->blocklist.next = block;
 	zone->blocklist.prev = block;
 	zone->blocklist.tag = 1;	// mark as in use block
 	zone->blocklist.id = 0;
 	zone->blocklist.size = 0;
-	zone->rover = block;
 
 	block->prev = &zone->blocklist;
 	block->next = &zone->blocklist;
 	block->tag = 0;			// free block
 	block->id = ZONEID;
-	block->size = size - sizeof(memzone_t);
+	block->size = (size - sizeof(memzone_t)) & ~7;
+
+	Z_LinkFree(block);
+
+	zone->next = mainzone;
+	mainzone = zone;
+
+	zone_stats.regions++;
+	zone_stats.size += size;
+}
+
+/*
+========================
+Z_Grow
+
+Adds a malloced region big enough for a block of the given size
+========================
+*/
+qboolean Z_Grow(int block_size) {
+	memzone_t *zone;
+	int size;
+
+	size = DYNAMIC_SIZE;
+	if (size < block_size + (int)sizeof(memzone_t)) {
+		size = block_size + sizeof(memzone_t);
+	}
+
+	zone = malloc(size);
+	if (!zone) {
+		return false;
+	}
+
+	Con_DPrintf("Z_Grow: added %i bytes to the zone\n", size);
+	Z_ClearZone(zone, size);
+
+	return true;
 }
 
 
@@ -123,18 +282,19 @@ void Z_Free(void *ptr) {
 
 	current->tag = 0;  // mark as free
 
+	zone_stats.used -= current->size;
+	zone_stats.blocks--;
+	zone_stats.frees++;
+
 	previous = current->prev;
 
 	if (!previous->tag) {
 		// merge with previous free block
+		Z_UnlinkFree(previous);
 		previous->size += current->size;
 		previous->next = current->next;
 		previous->next->prev = previous;
 
-		if (current == mainzone->rover) {
-			mainzone->rover = previous;
-		}
-
 		current = previous;
 	}
 
@@ -142,14 +302,13 @@ void Z_Free(void *ptr) {
 
 	if (!next->tag) {
 		// merge the next free block onto the end
+		Z_UnlinkFree(next);
 		current->size += next->size;
 		current->next = next->next;
 		current->next->prev = current;
-
-		if (next == mainzone->rover) {
-			mainzone->rover = current;
-		}
 	}
+
+	Z_LinkFree(current);
 }
 
 
@@ -161,7 +320,9 @@ Z_Malloc
 void *Z_Malloc(int size) {
 	void *buf;
 
-	Z_CheckHeap();  // DEBUG
+#ifdef PARANOID
+	Z_CheckHeap();
+#endif
 	buf = Z_TagMalloc(size, 1);
 
 	if (!buf) {
@@ -175,9 +336,8 @@ void *Z_Malloc(int size) {
 
 void *Z_TagMalloc(int block_size, int tag) {
 	int remaining_space;
+	int bin;
 	memblock_t *base;
-	memblock_t *start;
-	memblock_t *rover;
 	memblock_t *new_block;
 
 	if (!tag) {
@@ -188,27 +348,49 @@ void *Z_TagMalloc(int block_size, int tag) {
 	block_size += 4;  // space for memory trash tester
 	block_size = (block_size + 7) & ~7;  // align to 8-byte boundary
 
-	// scan through the block list looking for the first free block
-	// of sufficient size
-	base = rover = mainzone->rover;
-	start = base->prev;
+	if (block_size < (int)(sizeof(memblock_t) + sizeof(freelink_t))) {
+		block_size = sizeof(memblock_t) + sizeof(freelink_t);  // room to free it
+	}
 
-	do {
-		if (rover == start) {
-			// scanned all the way around the list
-			return NULL;
-		}
+	while (1) {
+		base = NULL;
 
-		if (rover->tag) {
-			base = rover = rover->next;
+		if (block_size < ZONE_SMALLMAX) {
+			// everything in the bin rounded up from the size fits
+			bin = Z_FindBin((block_size + 15) >> 4);
 		} else {
-			rover = rover->next;
+			// the bin the size falls in might have a block that fits,
+			// anything in the ones above it does
+			bin = Z_BinForSize(block_size);
+			for (base = zone_bins[bin]; base; base = FREELINK(base)->next) {
+				if (base->size >= block_size) {
+					break;
+				}
+			}
+
+			if (!base && bin < ZONE_BINS - 1) {
+				bin = Z_FindBin(bin + 1);
+			} else if (!base) {
+				bin = -1;
+			}
 		}
-	} while (base->tag || base->size < block_size);
+
+		if (!base && bin != -1) {
+			base = zone_bins[bin];
+		}
+
+		if (base) {
+			break;
+		}
+
+		if (!Z_Grow(block_size)) {
+			return NULL;
+		}
+	}
+
+	Z_UnlinkFree(base);
 
 	// found a block big enough
-	// by default, the size of the last memblock on the list is the remaining
-	// amount of the zone
 	remaining_space = base->size - block_size;
 
 	if (remaining_space > MINFRAGMENT) {
@@ -223,14 +405,21 @@ void *Z_TagMalloc(int block_size, int tag) {
 
 		base->next = new_block;
 		base->size = block_size;
+
+		Z_LinkFree(new_block);
 	}
 
 	base->tag = tag;  // no longer a free block
 
-	mainzone->rover = base->next; // next allocation will start looking here
-
 	base->id = ZONEID;
 
+	zone_stats.used += base->size;
+	if (zone_stats.used > zone_stats.peak) {
+		zone_stats.peak = zone_stats.used;
+	}
+	zone_stats.blocks++;
+	zone_stats.allocs++;
+
 	// marker for memory trash testing
 	*(int *)((byte *)base + base->size - 4) = ZONEID;
 
@@ -243,36 +432,92 @@ void *Z_TagMalloc(int block_size, int tag) {
 ========================
 Z_Print
 
-unused
+Prints usage and fragmentation of the zone.  With "all", every block is
+listed as well.
 ========================
 */
-void Z_Print(memzone_t *zone) {
+void Z_Print(void) {
+	memzone_t *zone;
 	memblock_t *block;
+	qboolean all;
+	int i;
+	int count;
+	int freebytes;
+	int freeblocks;
+	int largest;
+	int totalfree;
+	int totalfreeblocks;
+	int totallargest;
+
+	all = Cmd_Argc() > 1 && !Q_strcmp(Cmd_Argv(1), "all");
+
+	totalfree = 0;
+	totalfreeblocks = 0;
+	totallargest = 0;
+
+	for (zone = mainzone; zone; zone = zone->next) {
+		freebytes = 0;
+		freeblocks = 0;
+		largest = 0;
+
+		for (block = zone->blocklist.next; block != &zone->blocklist; block = block->next) {
+			if (all) {
+				Con_Printf("block: %p    size: %7i    tag: %3i\n", block, block->size, block->tag);
+			}
 
-	Con_Printf("zone size: %i  location: %p\n",mainzone->size,mainzone);
+			if (!block->tag) {
+				freebytes += block->size;
+				freeblocks++;
+				if (block->size > largest) {
+					largest = block->size;
+				}
+			}
+		}
 
-	for (block = zone->blocklist.next; ; block = block->next){
 		Con_Printf(
-				"block: %p    size: %7i    tag: %3i\n",
-				block, block->size, block->tag);
+				"region %p: %7i bytes, %7i free in %4i blocks, largest %7i\n",
+				zone, zone->size, freebytes, freeblocks, largest);
 
-		if (block->next == &zone->blocklist) {
-			// all blocks have been hit
-			break;
+		totalfree += freebytes;
+		totalfreeblocks += freeblocks;
+		if (largest > totallargest) {
+			totallargest = largest;
+		}
+	}
+
+	Con_Printf("-------------------------\n");
+	Con_Printf("%8i bytes in %i regions\n", zone_stats.size, zone_stats.regions);
+	Con_Printf("%8i bytes used in %i blocks (peak %i)\n", zone_stats.used, zone_stats.blocks, zone_stats.peak);
+	Con_Printf("%8i bytes free in %i blocks\n", totalfree, totalfreeblocks);
+	if (totalfree) {
+		// how much of the free space can't be had in one piece
+		Con_Printf(
+				"%8.1f%% fragmentation, largest free block %i\n",
+				100.0 * (totalfree - totallargest) / totalfree, totallargest);
+	}
+	Con_Printf("%8i allocs, %i frees\n", zone_stats.allocs, zone_stats.frees);
+
+	Con_Printf("free blocks by size:");
+	for (i = 0, count = 0; i < ZONE_BINS; i++) {
+		for (freeblocks = 0, block = zone_bins[i]; block; block = FREELINK(block)->next) {
+			freeblocks++;
 		}
 
-		if ( (byte *)block + block->size != (byte *)block->next) {
-			Con_Printf("ERROR: block size does not touch the next block\n");
+		if (!freeblocks) {
+			continue;
 		}
 
-		if ( block->next->prev != block) {
-			Con_Printf("ERROR: next block doesn't have proper back link\n");
+		if (!(count++ & 3)) {
+			Con_Printf("\n");
 		}
 
-		if (!block->tag && !block->next->tag) {
-			Con_Printf("ERROR: two consecutive free blocks\n");
+		if (i < ZONE_SMALLBINS) {
+			Con_Printf("  %6i: %-4i", i << 4, freeblocks);
+		} else {
+			Con_Printf(" %6i+: %-4i", ZONE_SMALLMAX << (i - ZONE_SMALLBINS), freeblocks);
 		}
 	}
+	Con_Printf("\n");
 }
 
 
@@ -282,25 +527,49 @@ Z_CheckHeap
 ========================
 */
 void Z_CheckHeap(void) {
+	memzone_t *zone;
 	memblock_t *block;
+	int i;
+	int freeblocks;
 
-	for (block = mainzone->blocklist.next; ; block = block->next) {
-		if (block->next == &mainzone->blocklist) {
-			break;  // all blocks have been hit
-		}
+	freeblocks = 0;
 
-		if ( (byte *)block + block->size != (byte *)block->next) {
-			Sys_Error("Z_CheckHeap: block size does not touch the next block\n");
-		}
+	for (zone = mainzone; zone; zone = zone->next) {
+		for (block = zone->blocklist.next; ; block = block->next) {
+			if (!block->tag) {
+				freeblocks++;
+			}
+
+			if (block->next == &zone->blocklist) {
+				break;  // all blocks have been hit
+			}
 
-		if ( block->next->prev != block) {
-			Sys_Error("Z_CheckHeap: next block doesn't have proper back link\n");
+			if ( (byte *)block + block->size != (byte *)block->next) {
+				Sys_Error("Z_CheckHeap: block size does not touch the next block\n");
+			}
+
+			if ( block->next->prev != block) {
+				Sys_Error("Z_CheckHeap: next block doesn't have proper back link\n");
+			}
+
+			if (!block->tag && !block->next->tag) {
+				Sys_Error("Z_CheckHeap: two consecutive free blocks\n");
+			}
 		}
+	}
 
-		if (!block->tag && !block->next->tag) {
-			Sys_Error("Z_CheckHeap: two consecutive free blocks\n");
+	for (i = 0; i < ZONE_BINS; i++) {
+		for (block = zone_bins[i]; block; block = FREELINK(block)->next) {
+			if (block->tag || Z_BinForSize(block->size) != i) {
+				Sys_Error("Z_CheckHeap: bad block on free list\n");
+			}
+			freeblocks--;
 		}
 	}
+
+	if (freeblocks) {
+		Sys_Error("Z_CheckHeap: free lists don't match the blocks\n");
+	}
 }
 
 
@@ -315,6 +584,9 @@ void Z_CheckHeap(void) {
 
 #define HUNK_SENTINEL 0x1df001ed
 
+#define HUNK_COMMITCHUNK 0x100000  // commit in 1MB steps
+#define HUNK_MINCACHE 0x200000  // the cache gets at least this much once past budget
+
 typedef struct {
 	int sentinel;
 	int size;  // including sizeof(hunk_t), -1 = not allocated
@@ -322,19 +594,114 @@ typedef struct {
 } hunk_t;
 
 byte *hunk_base;
-int hunk_size;
+int hunk_size;  // all of the address space, committed or not
 int hunk_low_used;
 int hunk_high_used;
 
+// When the system can reserve address space, the hunk is a big reserved
+// range with the low hunk committed from the bottom and the high hunk from
+// the top as they grow, so nothing ever moves.  hunk_budget is what -mem
+// asked for, and the cache uses whatever of it the hunk doesn't.
+int hunk_budget;
+int hunk_low_committed;
+int hunk_high_committed;
+
 qboolean hunk_tempactive;
 int hunk_tempmark;
 
 
-void Hunk_Init(void *buf, int size) {
-  hunk_base = buf;
-	hunk_size = size;
+void Hunk_Init(void *buf, int size, int reserve) {
+	hunk_base = buf;
 	hunk_low_used = 0;
 	hunk_high_used = 0;
+	hunk_budget = size;
+
+	if (reserve > size) {
+		hunk_size = reserve & ~(HUNK_COMMITCHUNK - 1);
+		hunk_low_committed = 0;
+		hunk_high_committed = 0;
+	} else {
+		hunk_size = size;
+		hunk_low_committed = size;  // all of it is real memory
+		hunk_high_committed = 0;
+	}
+}
+
+/*
+==============
+Hunk_CommitLow
+
+Make sure the memory from the bottom of the hunk up to offset is committed
+==============
+*/
+void Hunk_CommitLow(int offset) {
+	int commit;
+
+	commit = (offset + HUNK_COMMITCHUNK - 1) & ~(HUNK_COMMITCHUNK - 1);
+	if (commit > hunk_size - hunk_high_committed) {
+		commit = hunk_size - hunk_high_committed;
+	}
+
+	if (commit <= hunk_low_committed) {
+		return;
+	}
+
+	Sys_CommitMemory(hunk_base + hunk_low_committed, commit - hunk_low_committed);
+	hunk_low_committed = commit;
+}
+
+/*
+==============
+Hunk_CommitHigh
+
+Make sure the memory from the top of the hunk down to offset from it is committed
+==============
+*/
+void Hunk_CommitHigh(int offset) {
+	int commit;
+
+	commit = (offset + HUNK_COMMITCHUNK - 1) & ~(HUNK_COMMITCHUNK - 1);
+	if (commit > hunk_size - hunk_low_committed) {
+		commit = hunk_size - hunk_low_committed;
+	}
+
+	if (commit <= hunk_high_committed) {
+		return;
+	}
+
+	Sys_CommitMemory(hunk_base + hunk_size - commit, commit - hunk_high_committed);
+	hunk_high_committed = commit;
+}
+
+/*
+==============
+Hunk_CacheLimit
+
+The cache lives between the low hunk and here.  It gets whatever is left of
+the budget, which is the whole gap when the hunk isn't growable.
+==============
+*/
+int Hunk_CacheLimit(void) {
+	int top;
+
+	top = hunk_budget - hunk_high_used;
+	if (top < hunk_low_used + HUNK_MINCACHE) {
+		top = hunk_low_used + HUNK_MINCACHE;
+	}
+	if (top > hunk_size - hunk_high_used) {
+		top = hunk_size - hunk_high_used;
+	}
+
+	return top;
+}
+
+byte *Hunk_CacheTop(void) {
+	int top;
+
+	top = Hunk_CacheLimit();
+	Hunk_CommitLow(top);
+
+	return hunk_base + top;
 }
 
 /*
@@ -391,6 +758,9 @@ void Hunk_Print(qboolean all) {
 	endhigh = (hunk_t *)(hunk_base + hunk_size);
 
 	Con_Printf("          :%8i total hunk size\n", hunk_size);
+	Con_Printf("          :%8i committed (%i low, %i high)\n",
+			hunk_low_committed + hunk_high_committed, hunk_low_committed, hunk_high_committed);
+	Con_Printf("          :%8i budget\n", hunk_budget);
 	Con_Printf("-------------------------\n");
 
 	while (1) {
@@ -472,6 +842,7 @@ void *Hunk_AllocName(int size, char *name) {
 	hunk_low_used += size;
 
 	Cache_FreeLow(hunk_low_used);
+	Hunk_CommitLow(hunk_low_used);
 
 	memset(h, 0, size);
 
@@ -495,6 +866,11 @@ int	Hunk_LowMark(void) {
 	return hunk_low_used;
 }
 
+// where a low mark is in memory
+byte *Hunk_MarkPointer(int mark) {
+	return hunk_base + mark;
+}
+
 void Hunk_FreeToLowMark(int mark) {
 	if (mark < 0 || mark > hunk_low_used) {
 		Sys_Error("Hunk_FreeToLowMark: bad mark %i", mark);
@@ -559,7 +935,8 @@ void *Hunk_HighAllocName(int size, char *name) {
 	}
 
 	hunk_high_used += size;
-	Cache_FreeHigh(hunk_high_used);
+	Cache_FreeHigh();
+	Hunk_CommitHigh(hunk_high_used);
 
 	h = (hunk_t *)(hunk_base + hunk_size - hunk_high_used);
 
@@ -606,6 +983,16 @@ void *Hunk_TempAlloc(int size) {
 
 CACHE MEMORY
 
+Which block to throw out is decided by greedy dual size: each block has
+a priority of what it costs to load again per byte, plus the priority of
+the last block thrown out, and the lowest goes first.  Big blocks that
+load quickly go before small ones that took a while, and anything that
+doesn't get used sinks below newer blocks over time.
+
+Holes left between blocks are closed up by sliding blocks down, a little
+every frame and all at once when an allocation would otherwise have to
+throw things out with enough free space about.
+
 ===============================================================================
 */
 
@@ -617,12 +1004,43 @@ typedef struct cache_system_s {
 	struct cache_system_s *next;
 	struct cache_system_s *lru_prev;  // for LRU flushing
 	struct cache_system_s *lru_next;  // for LRU flushing
+	double priority;  // lowest is thrown out first
+	float cost;  // seconds it took to load
 } cache_system_t;
 
 cache_system_t *Cache_TryAlloc(int size, qboolean nobottom);
+void Cache_Evict(cache_system_t *cs);
+
+#define CACHE_MAXLOADTIME 5.0  // longer than this since the miss, it wasn't one load
+#define CACHE_LOADRATE (20.0 * 1024 * 1024)  // bytes per second, for loads that weren't timed
+
+cvar_t cache_compact = {"cache_compact", "65536"};  // most bytes slid down per frame
+
+double cache_inflation;  // priority of the last block thrown out
+qboolean cache_holes;  // there may be space between blocks
+
+struct {
+	int evictions;
+	int evictedbytes;
+	int reloads;
+	int reloadbytes;
+	double reloadtime;
+	int compactions;
+	int compactbytes;
+
+	// over the last second
+	double sampletime;
+	int lastreloadbytes;
+	int lastevictions;
+	float reloadrate;
+	float evictrate;
+} cache_stats;
 
 cache_system_t cache_head;
 
+int cache_used;  // bytes in cache blocks, including headers
+int cache_count;
+
 /*
 ===========
 Cache_Move
@@ -639,11 +1057,13 @@ void Cache_Move(cache_system_t *c) {
 		Q_memcpy(new + 1, c + 1, c->size - sizeof(cache_system_t));
 		new->user = c->user;
 		Q_memcpy(new->name, c->name, sizeof(new->name));
+		new->priority = c->priority;
+		new->cost = c->cost;
 		Cache_Free(c->user);
 		new->user->data = (void *)(new + 1);
 	} else {
 		// Con_Printf("cache_move failed\n");
-		Cache_Free(c->user);  // tough luck...
+		Cache_Evict(c);  // tough luck...
 	}
 }
 
@@ -676,10 +1096,12 @@ void Cache_FreeLow(int new_low_hunk) {
 ============
 Cache_FreeHigh
 
-Throw things out until the hunk can be expanded to the given point
+Throw things out until the cache is back under Hunk_CacheLimit, which comes
+down with the budget as the high hunk grows, not just where the high hunk
+now starts
 ============
 */
-void Cache_FreeHigh(int new_high_hunk) {
+void Cache_FreeHigh(void) {
 	cache_system_t *c;
 	cache_system_t *prev;
 
@@ -691,12 +1113,12 @@ void Cache_FreeHigh(int new_high_hunk) {
 			return;  // nothing in cache at all
 		}
 
-		if ((byte *)c + c->size <= hunk_base + hunk_size - new_high_hunk) {
-			return;  // there is space to grow the hunk
+		if ((byte *)c + c->size <= hunk_base + Hunk_CacheLimit()) {
+			return;  // everything is inside the limit
 		}
 
 		if (c == prev) {
-			Cache_Free(c->user);	// didn't move out of the way
+			Cache_Evict(c);	// didn't move out of the way
 		} else {
 			Cache_Move(c);	// try to move it
 			prev = c;
@@ -740,7 +1162,7 @@ cache_system_t *Cache_TryAlloc(int size, qboolean nobottom) {
 
 	// is the cache completely empty?
 	if (!nobottom && cache_head.prev == &cache_head) {
-		if (hunk_size - hunk_high_used - hunk_low_used < size) {
+		if (Hunk_CacheTop() - (hunk_base + hunk_low_used) < size) {
 			Sys_Error("Cache_TryAlloc: %i is greater then free hunk", size);
 		}
 
@@ -751,6 +1173,8 @@ cache_system_t *Cache_TryAlloc(int size, qboolean nobottom) {
 		cache_head.prev = cache_head.next = new;
 		new->prev = new->next = &cache_head;
 
+		cache_used += size;
+		cache_count++;
 		Cache_MakeLRU(new);
 		return new;
 	}
@@ -771,6 +1195,8 @@ cache_system_t *Cache_TryAlloc(int size, qboolean nobottom) {
 				cs->prev->next = new;
 				cs->prev = new;
 
+				cache_used += size;
+				cache_count++;
 				Cache_MakeLRU(new);
 
 				return new;
@@ -784,7 +1210,7 @@ cache_system_t *Cache_TryAlloc(int size, qboolean nobottom) {
 	} while (cs != &cache_head);
 
 	// try to allocate one at the very end
-	if (hunk_base + hunk_size - hunk_high_used - (byte *)new >= size) {
+	if (Hunk_CacheTop() - (byte *)new >= size) {
 		memset(new, 0, sizeof(*new));
 		new->size = size;
 
@@ -793,6 +1219,8 @@ cache_system_t *Cache_TryAlloc(int size, qboolean nobottom) {
 		cache_head.prev->next = new;
 		cache_head.prev = new;
 
+		cache_used += size;
+		cache_count++;
 		Cache_MakeLRU(new);
 
 		return new;
@@ -830,6 +1258,23 @@ void Cache_Print(void) {
 	}
 }
 
+/*
+============
+Cache_Stats_f
+
+============
+*/
+void Cache_Stats_f(void) {
+	Con_Printf("%8i bytes in %i blocks, %i free\n",
+			cache_used, cache_count, Hunk_CacheLimit() - hunk_low_used - cache_used);
+	Con_Printf("%8i evictions, %i bytes\n", cache_stats.evictions, cache_stats.evictedbytes);
+	Con_Printf("%8i reloads, %i bytes, %.1f ms loading\n",
+			cache_stats.reloads, cache_stats.reloadbytes, cache_stats.reloadtime * 1000);
+	Con_Printf("%8i blocks slid down, %i bytes\n", cache_stats.compactions, cache_stats.compactbytes);
+	Con_Printf("last second: %.0f evictions/s, %.0f bytes reloaded/s\n",
+			cache_stats.evictrate, cache_stats.reloadrate);
+}
+
 /*
 ============
 Cache_Report
@@ -839,16 +1284,77 @@ Cache_Report
 void Cache_Report(void) {
 	Con_DPrintf(
 			"%4.1f megabyte data cache\n",
-			(hunk_size - hunk_high_used - hunk_low_used) / (float)(1024*1024));
+			(Hunk_CacheTop() - (hunk_base + hunk_low_used)) / (float)(1024*1024));
 }
 
 /*
 ============
 Cache_Compact
 
+Slides blocks down over the holes between them, stopping once maxbytes
+have been moved.  Returns the number of bytes moved.
+============
+*/
+int Cache_Compact(int maxbytes) {
+	cache_system_t *cs;
+	cache_system_t *new;
+	byte *dest;
+	int moved;
+
+	if (!cache_holes) {
+		return 0;
+	}
+
+	moved = 0;
+	dest = hunk_base + hunk_low_used;
+
+	for (cs = cache_head.next; cs != &cache_head; cs = cs->next) {
+		if ((byte *)cs > dest) {
+			if (moved >= maxbytes) {
+				return moved;  // more next time
+			}
+
+			// the blocks are in address order, so sliding down keeps them that way
+			new = (cache_system_t *)dest;
+			memmove(new, cs, cs->size);
+			new->prev->next = new;
+			new->next->prev = new;
+			new->lru_prev->lru_next = new;
+			new->lru_next->lru_prev = new;
+			new->user->data = (void *)(new + 1);
+			cs = new;
+
+			moved += cs->size;
+			cache_stats.compactions++;
+			cache_stats.compactbytes += cs->size;
+		}
+
+		dest = (byte *)cs + cs->size;
+	}
+
+	cache_holes = false;
+
+	return moved;
+}
+
+/*
+============
+Cache_Frame
+
 ============
 */
-void Cache_Compact(void) {
+void Cache_Frame(void) {
+	if (cache_compact.value > 0) {
+		Cache_Compact((int)cache_compact.value);
+	}
+
+	if (realtime - cache_stats.sampletime >= 1) {
+		cache_stats.reloadrate = (cache_stats.reloadbytes - cache_stats.lastreloadbytes) / (realtime - cache_stats.sampletime);
+		cache_stats.evictrate = (cache_stats.evictions - cache_stats.lastevictions) / (realtime - cache_stats.sampletime);
+		cache_stats.lastreloadbytes = cache_stats.reloadbytes;
+		cache_stats.lastevictions = cache_stats.evictions;
+		cache_stats.sampletime = realtime;
+	}
 }
 
 /*
@@ -862,6 +1368,7 @@ void Cache_Init(void) {
 	cache_head.lru_next = cache_head.lru_prev = &cache_head;
 
 	Cmd_AddCommand("flush", Cache_Flush);
+	Cmd_AddCommand("cachestats", Cache_Stats_f);
 }
 
 /*
@@ -886,6 +1393,13 @@ void Cache_Free(cache_user_t *c) {
 
 	c->data = NULL;
 
+	cache_used -= cs->size;
+	cache_count--;
+
+	if (cs->next != &cache_head) {
+		cache_holes = true;
+	}
+
 	Cache_UnlinkLRU(cs);
 }
 
@@ -900,6 +1414,7 @@ void* Cache_Check(cache_user_t* c) {
 	cache_system_t* cs;
 
 	if (!c->data) {
+		c->misstime = Sys_FloatTime();  // it's about to be loaded
 		return NULL;
 	}
 
@@ -909,9 +1424,51 @@ void* Cache_Check(cache_user_t* c) {
 	Cache_UnlinkLRU(cs);
 	Cache_MakeLRU(cs);
 
+	cs->priority = cache_inflation + cs->cost / cs->size;
+
 	return c->data;
 }
 
+/*
+==============
+Cache_Evict
+
+Throws a block out to make room
+==============
+*/
+void Cache_Evict(cache_system_t *cs) {
+	cache_stats.evictions++;
+	cache_stats.evictedbytes += cs->size;
+
+	if (cs->priority > cache_inflation) {
+		cache_inflation = cs->priority;
+	}
+
+	Cache_Free(cs->user);
+}
+
+/*
+==============
+Cache_Victim
+
+The block that is cheapest to lose
+==============
+*/
+cache_system_t *Cache_Victim(void) {
+	cache_system_t *cs;
+	cache_system_t *best;
+
+	best = cache_head.lru_prev;
+
+	for (cs = best->lru_prev; cs != &cache_head; cs = cs->lru_prev) {
+		if (cs->priority < best->priority) {
+			best = cs;
+		}
+	}
+
+	return best;
+}
+
 
 /*
 ==============
@@ -920,6 +1477,7 @@ Cache_Alloc
 */
 void *Cache_Alloc(cache_user_t *c, int size, char *name) {
 	cache_system_t *cs;
+	double now;
 
 	if (c->data) {
 		Sys_Error("Cache_Alloc: allready allocated");
@@ -941,13 +1499,32 @@ void *Cache_Alloc(cache_user_t *c, int size, char *name) {
 			break;
 		}
 
-		// free the least recently used cahedat
 		if (cache_head.lru_prev == &cache_head) {
 			Sys_Error("Cache_Alloc: out of memory");
 		}
 
-		// not enough memory at all
-		Cache_Free(cache_head.lru_prev->user);
+		// if there's enough room, just not in one piece, close up the holes
+		if (Hunk_CacheLimit() - hunk_low_used - cache_used >= size && Cache_Compact(hunk_size)) {
+			continue;
+		}
+
+		// throw out whatever is cheapest to get back
+		Cache_Evict(Cache_Victim());
+	}
+
+	// what loading it cost, if it was timed, otherwise a guess from the size
+	now = Sys_FloatTime();
+	if (c->misstime && now - c->misstime < CACHE_MAXLOADTIME) {
+		cs->cost = now - c->misstime;
+	} else {
+		cs->cost = size / CACHE_LOADRATE;
+	}
+	c->misstime = 0;
+
+	if (c->loads++) {
+		cache_stats.reloads++;
+		cache_stats.reloadbytes += size;
+		cache_stats.reloadtime += cs->cost;
 	}
 
 	return Cache_Check(c);
@@ -955,6 +1532,334 @@ void *Cache_Alloc(cache_user_t *c, int size, char *name) {
 
 
 
+/*
+===============================================================================
+
+MEMORY STATISTICS
+
+One place to get at how the hunk, zone and cache are being used.  The
+totals are cheap enough to look at every frame, so the high water marks
+of each map are kept as it runs, and every mem_sampleframes frames they
+are added to a ring of samples.  "memstats" dumps all of it as JSON.
+
+===============================================================================
+*/
+
+#define MEM_MAPS 64
+#define MEM_SAMPLES 256
+#define MEM_STATS 512
+
+typedef struct {
+	char name[32];
+	int frames;
+	memtotals_t peak;
+} memmap_t;
+
+typedef struct {
+	double time;
+	int frame;
+	memtotals_t totals;
+} memsample_t;
+
+cvar_t mem_sampleframes = {"mem_sampleframes", "72"};
+
+memmap_t mem_maps[MEM_MAPS];
+int mem_nummaps;  // ever loaded, the last MEM_MAPS are kept
+
+memsample_t mem_samples[MEM_SAMPLES];
+int mem_numsamples;  // ever taken, the last MEM_SAMPLES are kept
+
+memstat_t mem_stats[MEM_STATS];
+
+FILE *mem_file;
+
+/*
+============
+Memory_GetTotals
+============
+*/
+void Memory_GetTotals(memtotals_t *totals) {
+	totals->hunk_low = hunk_low_used;
+	totals->hunk_high = hunk_high_used;
+	totals->hunk_committed = hunk_low_committed + hunk_high_committed;
+	totals->hunk_reserved = hunk_size;
+	totals->zone_size = zone_stats.size;
+	totals->zone_used = zone_stats.used;
+	totals->cache_size = Hunk_CacheLimit() - hunk_low_used;
+	totals->cache_used = cache_used;
+}
+
+/*
+============
+Memory_AddStat
+
+Totals up one allocation under its kind and name
+============
+*/
+int Memory_AddStat(memstat_t *stats, int numstats, int maxstats, int kind, char *name, int bytes) {
+	int i;
+
+	for (i = 0; i < numstats; i++) {
+		if (stats[i].kind == kind && !strncmp(stats[i].name, name, sizeof(stats[i].name) - 1)) {
+			break;
+		}
+	}
+
+	if (i == numstats) {
+		if (numstats == maxstats) {
+			return numstats;  // out of room, drop it
+		}
+
+		stats[i].kind = kind;
+		Q_strncpy(stats[i].name, name, sizeof(stats[i].name) - 1);
+		stats[i].name[sizeof(stats[i].name) - 1] = 0;
+		stats[i].bytes = 0;
+		stats[i].count = 0;
+		numstats++;
+	}
+
+	stats[i].bytes += bytes;
+	stats[i].count++;
+
+	return numstats;
+}
+
+/*
+============
+Memory_GetStats
+
+Fills in bytes and counts for every hunk name, zone tag and cache name,
+and returns how many there are
+============
+*/
+int Memory_GetStats(memstat_t *stats, int maxstats) {
+	hunk_t *h;
+	memzone_t *zone;
+	memblock_t *block;
+	cache_system_t *cs;
+	char name[16];
+	int numstats;
+
+	numstats = 0;
+
+	for (h = (hunk_t *)hunk_base; (byte *)h < hunk_base + hunk_low_used; h = (hunk_t *)((byte *)h + h->size)) {
+		memcpy(name, h->name, 8);
+		name[8] = 0;
+		numstats = Memory_AddStat(stats, numstats, maxstats, MEMSTAT_HUNK, name, h->size);
+	}
+
+	for (h = (hunk_t *)(hunk_base + hunk_size - hunk_high_used); (byte *)h < hunk_base + hunk_size; h = (hunk_t *)((byte *)h + h->size)) {
+		memcpy(name, h->name, 8);
+		name[8] = 0;
+		numstats = Memory_AddStat(stats, numstats, maxstats, MEMSTAT_HUNK, name, h->size);
+	}
+
+	for (zone = mainzone; zone; zone = zone->next) {
+		for (block = zone->blocklist.next; block != &zone->blocklist; block = block->next) {
+			if (block->tag) {
+				snprintf(name, sizeof(name), "%i", block->tag);
+				numstats = Memory_AddStat(stats, numstats, maxstats, MEMSTAT_ZONE, name, block->size);
+			}
+		}
+	}
+
+	for (cs = cache_head.next; cs != &cache_head; cs = cs->next) {
+		numstats = Memory_AddStat(stats, numstats, maxstats, MEMSTAT_CACHE, cs->name, cs->size);
+	}
+
+	return numstats;
+}
+
+/*
+============
+Memory_SetMap
+
+Starts keeping high water marks for a newly loaded map
+============
+*/
+void Memory_SetMap(char *name) {
+	memmap_t *map;
+
+	if (mem_nummaps) {
+		map = &mem_maps[(mem_nummaps - 1) % MEM_MAPS];
+		if (!strcmp(map->name, name)) {
+			return;  // the client catching up with the server
+		}
+	}
+
+	map = &mem_maps[mem_nummaps % MEM_MAPS];
+	mem_nummaps++;
+
+	memset(map, 0, sizeof(*map));
+	Q_strncpy(map->name, name, sizeof(map->name) - 1);
+	Memory_GetTotals(&map->peak);
+}
+
+/*
+============
+Memory_Frame
+============
+*/
+void Memory_Frame(void) {
+	memtotals_t totals;
+	memmap_t *map;
+	memsample_t *sample;
+	int *peak;
+	int *current;
+	int i;
+
+	Memory_GetTotals(&totals);
+
+	if (mem_nummaps) {
+		map = &mem_maps[(mem_nummaps - 1) % MEM_MAPS];
+		map->frames++;
+
+		// every field is a byte count that only the peak matters for
+		peak = (int *)&map->peak;
+		current = (int *)&totals;
+		for (i = 0; i < sizeof(totals) / sizeof(int); i++) {
+			if (current[i] > peak[i]) {
+				peak[i] = current[i];
+			}
+		}
+	}
+
+	if (mem_sampleframes.value >= 1 && !(host_framecount % (int)mem_sampleframes.value)) {
+		sample = &mem_samples[mem_numsamples % MEM_SAMPLES];
+		mem_numsamples++;
+
+		sample->time = realtime;
+		sample->frame = host_framecount;
+		sample->totals = totals;
+	}
+}
+
+void Memory_FilePrintf(char *fmt, ...) {
+	va_list argptr;
+
+	va_start(argptr, fmt);
+	vfprintf(mem_file, fmt, argptr);
+	va_end(argptr);
+}
+
+void Memory_PrintString(void (*print)(char *fmt, ...), char *s) {
+	print("\"");
+	for ( ; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			print("\\%c", *s);
+		} else if ((unsigned char)*s < ' ' || (unsigned char)*s > '~') {
+			print("\\u%04x", (unsigned char)*s);
+		} else {
+			print("%c", *s);
+		}
+	}
+	print("\"");
+}
+
+void Memory_PrintTotals(void (*print)(char *fmt, ...), memtotals_t *totals) {
+	print(
+			"{\"hunk_low\": %i, \"hunk_high\": %i, \"hunk_committed\": %i, \"hunk_reserved\": %i, "
+			"\"zone_size\": %i, \"zone_used\": %i, \"cache_size\": %i, \"cache_used\": %i}",
+			totals->hunk_low, totals->hunk_high, totals->hunk_committed, totals->hunk_reserved,
+			totals->zone_size, totals->zone_used, totals->cache_size, totals->cache_used);
+}
+
+/*
+============
+Memory_PrintJSON
+============
+*/
+void Memory_PrintJSON(void (*print)(char *fmt, ...)) {
+	static char *kindnames[] = {"hunk", "zone", "cache"};
+	memtotals_t totals;
+	memmap_t *map;
+	memsample_t *sample;
+	int numstats;
+	int kind;
+	int count;
+	int i;
+
+	Memory_GetTotals(&totals);
+	numstats = Memory_GetStats(mem_stats, MEM_STATS);
+
+	print("{\n\"time\": %.3f,\n\"frame\": %i,\n\"totals\": ", realtime, host_framecount);
+	Memory_PrintTotals(print, &totals);
+	print(",\n");
+
+	for (kind = MEMSTAT_HUNK; kind <= MEMSTAT_CACHE; kind++) {
+		print("\"%s\": [", kindnames[kind]);
+		for (i = 0, count = 0; i < numstats; i++) {
+			if (mem_stats[i].kind != kind) {
+				continue;
+			}
+			print(count++ ? ",\n  {\"name\": " : "\n  {\"name\": ");
+			Memory_PrintString(print, mem_stats[i].name);
+			print(", \"bytes\": %i, \"count\": %i}", mem_stats[i].bytes, mem_stats[i].count);
+		}
+		print("\n],\n");
+	}
+
+	print("\"maps\": [");
+	i = mem_nummaps > MEM_MAPS ? mem_nummaps - MEM_MAPS : 0;
+	for ( ; i < mem_nummaps; i++) {
+		map = &mem_maps[i % MEM_MAPS];
+		print("\n  {\"name\": ");
+		Memory_PrintString(print, map->name);
+		print(", \"frames\": %i, \"peak\": ", map->frames);
+		Memory_PrintTotals(print, &map->peak);
+		print(i < mem_nummaps - 1 ? "}," : "}");
+	}
+	print("\n],\n");
+
+	print("\"samples\": [");
+	i = mem_numsamples > MEM_SAMPLES ? mem_numsamples - MEM_SAMPLES : 0;
+	for ( ; i < mem_numsamples; i++) {
+		sample = &mem_samples[i % MEM_SAMPLES];
+		print("\n  {\"time\": %.3f, \"frame\": %i, \"totals\": ", sample->time, sample->frame);
+		Memory_PrintTotals(print, &sample->totals);
+		print(i < mem_numsamples - 1 ? "}," : "}");
+	}
+	print("\n]\n}\n");
+}
+
+/*
+============
+Memory_Stats_f
+
+memstats [file]
+Dumps the memory statistics as JSON, to the console or a file in the game directory
+============
+*/
+void Memory_Stats_f(void) {
+	char name[MAX_OSPATH];
+
+	if (Cmd_Argc() < 2) {
+		Memory_PrintJSON(Con_Printf);
+		return;
+	}
+
+	// leave room for the extension
+	if (snprintf(name, sizeof(name) - 5, "%s/%s", com_gamedir, Cmd_Argv(1)) >= sizeof(name) - 5) {
+		Con_Printf("File name is too long\n");
+		return;
+	}
+	COM_DefaultExtension(name, ".json");
+
+	mem_file = fopen(name, "w");
+	if (!mem_file) {
+		Con_Printf("Couldn't write %s.\n", name);
+		return;
+	}
+
+	Memory_PrintJSON(Memory_FilePrintf);
+	fclose(mem_file);
+	mem_file = NULL;
+
+	Con_Printf("Wrote %s.\n", name);
+}
+
+
+
 //============================================================================
 
 
@@ -974,8 +1879,9 @@ void Zone_Init() {
 		}
 	}
 
-	mainzone = Hunk_AllocName(zonesize, "zone" );
-	Z_ClearZone(mainzone, zonesize);
+	Z_ClearZone(Hunk_AllocName(zonesize, "zone"), zonesize);
+
+	Cmd_AddCommand("zone", Z_Print);
 }
 
 
@@ -985,8 +1891,12 @@ void Zone_Init() {
 Memory_Init
 ========================
 */
-void Memory_Init(void *buf, int size) {
-	Hunk_Init(buf, size);
+void Memory_Init(void *buf, int size, int reserve) {
+	Hunk_Init(buf, size, reserve);
 	Cache_Init();
 	Zone_Init();
+
+	Cvar_RegisterVariable(&mem_sampleframes);
+	Cvar_RegisterVariable(&cache_compact);
+	Cmd_AddCommand("memstats", Memory_Stats_f);
 }
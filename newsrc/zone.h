@@ -36,8 +36,8 @@ server allocations when changing to a higher video mode.
 
 
 Z_??? Zone memory functions used for small, dynamic allocations like text
-strings from command input.  There is only about 48K for it, allocated at
-the very bottom of the hunk.
+strings from command input.  It starts out as about 48K at the very bottom
+of the hunk, and grows with malloced regions when that fills up.
 
 Cache_??? Cache memory is for objects that can be dynamically loaded and
 can usefully stay persistent between levels.  The size of the cache
@@ -83,7 +83,7 @@ Zone block
 
 */
 
-void Memory_Init(void *buf, int size);
+void Memory_Init(void *buf, int size, int reserve);
 
 
 
@@ -115,6 +115,8 @@ void *Hunk_AllocName(int size, char *name);
 void *Hunk_HighAllocName(int size, char *name);
 
 int	Hunk_LowMark(void);
+int Hunk_CacheLimit(void);  // top of the space the cache can use
+byte *Hunk_MarkPointer(int mark);
 void Hunk_FreeToLowMark(int mark);
 
 int	Hunk_HighMark(void);
@@ -132,6 +134,8 @@ void Hunk_Check(void);
 
 typedef struct cache_user_s {
 	void *data;
+	double misstime;  // when Cache_Check last came up empty, to time the load
+	int loads;  // more than one means it was thrown out and loaded again
 } cache_user_t;
 
 void Cache_Flush(void);
@@ -147,3 +151,46 @@ void Cache_Free(cache_user_t *c);
 void *Cache_Alloc(cache_user_t *c, int size, char *name);
 
 void Cache_Report(void);
+
+// slides cache blocks down over holes a bit at a time, call once a frame
+void Cache_Frame(void);
+
+
+
+// ============================================================================
+// MEMORY STATISTICS
+// ============================================================================
+
+#define MEMSTAT_HUNK 0
+#define MEMSTAT_ZONE 1
+#define MEMSTAT_CACHE 2
+
+typedef struct {
+	int kind;  // MEMSTAT_*
+	char name[16];  // hunk name, zone tag or cache name
+	int bytes;  // including headers
+	int count;
+} memstat_t;
+
+typedef struct {
+	int hunk_low;
+	int hunk_high;
+	int hunk_committed;
+	int hunk_reserved;
+	int zone_size;
+	int zone_used;
+	int cache_size;  // what the cache has to work with
+	int cache_used;
+} memtotals_t;
+
+void Memory_GetTotals(memtotals_t *totals);
+
+// fills in bytes and counts per hunk name, zone tag and cache name,
+// returns how many were filled in
+int Memory_GetStats(memstat_t *stats, int maxstats);
+
+// starts keeping high water marks for a new map
+void Memory_SetMap(char *name);
+
+// keeps the high water marks and samples, call once a frame
+void Memory_Frame(void);